@@ -0,0 +1,539 @@
+#include "CMUX.h"
+
+#define CMUX_FLAG 0xF9 ///< opens and closes every basic mode frame
+#define CMUX_EA 0x01   ///< extension bit, set in the last byte of a field
+#define CMUX_CR 0x02   ///< command/response bit
+#define CMUX_PF 0x10   ///< poll/final bit of the control field
+
+#define CMUX_SABM 0x2F ///< set asynchronous balanced mode, opens a DLCI
+#define CMUX_UA 0x63   ///< unnumbered acknowledgement
+#define CMUX_DM 0x0F   ///< disconnected mode, DLCI refused
+#define CMUX_DISC 0x43 ///< disconnect
+#define CMUX_UIH 0xEF  ///< unnumbered information, FCS over the header only
+#define CMUX_UI 0x03   ///< unnumbered information, FCS over the whole frame
+
+#define CMUX_CLD 0xC1 ///< multiplexer close down control message
+#define CMUX_MSC 0xE1 ///< modem status control message
+
+#define CMUX_FCS_GOOD 0xCF ///< FCS register after a frame and its FCS were fed in
+
+static const char CMUX_START[] PROGMEM = "AT+CMUX=0\r"; ///< Basic mode with the default parameters
+
+/// CRC-8 of 27.010 (x^8 + x^2 + x + 1, reflected) for every byte value
+static const uint8_t crcTable[256] PROGMEM = {
+    0x00, 0x91, 0xE3, 0x72, 0x07, 0x96, 0xE4, 0x75, 0x0E, 0x9F, 0xED, 0x7C, 0x09, 0x98, 0xEA, 0x7B,
+    0x1C, 0x8D, 0xFF, 0x6E, 0x1B, 0x8A, 0xF8, 0x69, 0x12, 0x83, 0xF1, 0x60, 0x15, 0x84, 0xF6, 0x67,
+    0x38, 0xA9, 0xDB, 0x4A, 0x3F, 0xAE, 0xDC, 0x4D, 0x36, 0xA7, 0xD5, 0x44, 0x31, 0xA0, 0xD2, 0x43,
+    0x24, 0xB5, 0xC7, 0x56, 0x23, 0xB2, 0xC0, 0x51, 0x2A, 0xBB, 0xC9, 0x58, 0x2D, 0xBC, 0xCE, 0x5F,
+    0x70, 0xE1, 0x93, 0x02, 0x77, 0xE6, 0x94, 0x05, 0x7E, 0xEF, 0x9D, 0x0C, 0x79, 0xE8, 0x9A, 0x0B,
+    0x6C, 0xFD, 0x8F, 0x1E, 0x6B, 0xFA, 0x88, 0x19, 0x62, 0xF3, 0x81, 0x10, 0x65, 0xF4, 0x86, 0x17,
+    0x48, 0xD9, 0xAB, 0x3A, 0x4F, 0xDE, 0xAC, 0x3D, 0x46, 0xD7, 0xA5, 0x34, 0x41, 0xD0, 0xA2, 0x33,
+    0x54, 0xC5, 0xB7, 0x26, 0x53, 0xC2, 0xB0, 0x21, 0x5A, 0xCB, 0xB9, 0x28, 0x5D, 0xCC, 0xBE, 0x2F,
+    0xE0, 0x71, 0x03, 0x92, 0xE7, 0x76, 0x04, 0x95, 0xEE, 0x7F, 0x0D, 0x9C, 0xE9, 0x78, 0x0A, 0x9B,
+    0xFC, 0x6D, 0x1F, 0x8E, 0xFB, 0x6A, 0x18, 0x89, 0xF2, 0x63, 0x11, 0x80, 0xF5, 0x64, 0x16, 0x87,
+    0xD8, 0x49, 0x3B, 0xAA, 0xDF, 0x4E, 0x3C, 0xAD, 0xD6, 0x47, 0x35, 0xA4, 0xD1, 0x40, 0x32, 0xA3,
+    0xC4, 0x55, 0x27, 0xB6, 0xC3, 0x52, 0x20, 0xB1, 0xCA, 0x5B, 0x29, 0xB8, 0xCD, 0x5C, 0x2E, 0xBF,
+    0x90, 0x01, 0x73, 0xE2, 0x97, 0x06, 0x74, 0xE5, 0x9E, 0x0F, 0x7D, 0xEC, 0x99, 0x08, 0x7A, 0xEB,
+    0x8C, 0x1D, 0x6F, 0xFE, 0x8B, 0x1A, 0x68, 0xF9, 0x82, 0x13, 0x61, 0xF0, 0x85, 0x14, 0x66, 0xF7,
+    0xA8, 0x39, 0x4B, 0xDA, 0xAF, 0x3E, 0x4C, 0xDD, 0xA6, 0x37, 0x45, 0xD4, 0xA1, 0x30, 0x42, 0xD3,
+    0xB4, 0x25, 0x57, 0xC6, 0xB3, 0x22, 0x50, 0xC1, 0xBA, 0x2B, 0x59, 0xC8, 0xBD, 0x2C, 0x5E, 0xCF};
+
+/**************************************************************************/
+/*!
+    @brief Feed one byte to the frame check sequence
+    @param fcs Running FCS, start with 0xFF
+    @param c Byte to add
+    @returns Updated FCS
+*/
+/**************************************************************************/
+static inline uint8_t fcsStep(uint8_t fcs, uint8_t c)
+{
+    return pgm_read_byte(&crcTable[fcs ^ c]);
+}
+
+/**************************************************************************/
+/*!
+    @brief Send the collected bytes and feed the multiplexer, then get the
+   number of bytes available for reading
+    @returns Bytes available
+*/
+/**************************************************************************/
+int CMUX_Channel::available(void)
+{
+    flush();
+    if (mux)
+        mux->update();
+    return (rx_index_t)(rxHead - rxTail);
+}
+
+/**************************************************************************/
+/*!
+    @brief Read one byte
+    @returns The byte, or -1 if nothing was available
+*/
+/**************************************************************************/
+int CMUX_Channel::read(void)
+{
+    if (rxHead == rxTail && available() == 0)
+        return -1;
+    return rxBuffer[rxTail++ & (CMUX_RX_SIZE - 1)];
+}
+
+/**************************************************************************/
+/*!
+    @brief Look at the next byte without reading it
+    @returns The byte, or -1 if nothing was available
+*/
+/**************************************************************************/
+int CMUX_Channel::peek(void)
+{
+    if (rxHead == rxTail && available() == 0)
+        return -1;
+    return rxBuffer[rxTail & (CMUX_RX_SIZE - 1)];
+}
+
+/**************************************************************************/
+/*!
+    @brief Add one byte to the next frame, sending it if it is full
+    @param c Byte to send
+    @returns 1 on success, 0 if the channel is not open
+*/
+/**************************************************************************/
+size_t CMUX_Channel::write(uint8_t c)
+{
+    if (!open)
+        return 0;
+
+    txBuffer[txLength++] = c;
+    if (txLength == sizeof(txBuffer))
+        flush();
+    return 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief Add bytes to the frames, sending each one that fills up
+    @param buffer Bytes to send
+    @param size Number of bytes
+    @returns Number of bytes accepted
+*/
+/**************************************************************************/
+size_t CMUX_Channel::write(const uint8_t *buffer, size_t size)
+{
+    size_t written = 0;
+
+    while (written < size && write(buffer[written]))
+        written++;
+    return written;
+}
+
+/**************************************************************************/
+/*!
+    @brief Send the collected bytes as one UIH frame
+*/
+/**************************************************************************/
+void CMUX_Channel::flush(void)
+{
+    if (txLength == 0 || !mux)
+        return;
+
+    mux->sendFrame(dlci, CMUX_UIH, txBuffer, txLength);
+    txLength = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief Check if the modem accepted this channel
+    @returns True if the channel is open
+*/
+/**************************************************************************/
+bool CMUX_Channel::isOpen(void) { return open; }
+
+/**************************************************************************/
+/*!
+    @brief Get how many received bytes did not fit in the channel buffer
+    @returns Bytes dropped
+*/
+/**************************************************************************/
+uint32_t CMUX_Channel::getOverflowBytes(void) { return overflowBytes; }
+
+/**************************************************************************/
+/*!
+    @brief Store the information field of a received frame
+    @param data Information field
+    @param length Bytes in data
+*/
+/**************************************************************************/
+void CMUX_Channel::receive(const uint8_t *data, uint8_t length)
+{
+    for (uint8_t i = 0; i < length; i++)
+    {
+        if ((rx_index_t)(rxHead - rxTail) >= CMUX_RX_SIZE)
+        {
+            overflowBytes += length - i;
+            return;
+        }
+        rxBuffer[rxHead++ & (CMUX_RX_SIZE - 1)] = data[i];
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Constructor when using SoftwareSerial
+    @param ser Pointer to SoftwareSerial device
+*/
+/**************************************************************************/
+#if (defined(__AVR__) || defined(ESP8266)) && defined(USE_SW_SERIAL)
+CMUX_Multiplexer::CMUX_Multiplexer(SoftwareSerial *ser) : Serial_Command_Handler(ser) { cmux_init(); }
+#endif
+
+/**************************************************************************/
+/*!
+    @brief Constructor when using HardwareSerial
+    @param ser Pointer to a HardwareSerial object
+*/
+/**************************************************************************/
+CMUX_Multiplexer::CMUX_Multiplexer(HardwareSerial *ser) : Serial_Command_Handler(ser) { cmux_init(); }
+
+/**************************************************************************/
+/*!
+    @brief Constructor for any other Stream
+    @param ser Pointer to a Stream object
+*/
+/**************************************************************************/
+CMUX_Multiplexer::CMUX_Multiplexer(Stream *ser) : Serial_Command_Handler(ser) { cmux_init(); }
+
+CMUX_Multiplexer::~CMUX_Multiplexer() = default;
+
+/**************************************************************************/
+/*!
+    @brief Attach the channels to this multiplexer
+*/
+/**************************************************************************/
+void CMUX_Multiplexer::cmux_init(void)
+{
+    for (uint8_t i = 0; i < CMUX_CHANNELS; i++)
+    {
+        channels[i].mux = this;
+        channels[i].dlci = i + 1;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Switch the modem to CMUX basic mode with AT+CMUX=0, open the
+   control channel, then open every virtual channel
+    @param timeout How long to wait for each channel in milliseconds (optional)
+    @returns True if every channel is open, False otherwise
+*/
+/**************************************************************************/
+bool CMUX_Multiplexer::start(unsigned long timeout)
+{
+    if (started)
+        return true;
+
+    if (sendCommand_P(CMUX_START) != RESULT_OK)
+        return false;
+
+    state = CMUX_WAIT_FLAG;
+    openMask = refusedMask = 0;
+
+    if (!openChannel(0, timeout))
+        return false;
+    started = true;
+
+    bool all = true;
+    for (uint8_t i = 0; i < CMUX_CHANNELS; i++)
+    {
+        CMUX_Channel &channel = channels[i];
+
+        channel.open = openChannel(channel.dlci, timeout);
+        if (!channel.open)
+        {
+            all = false;
+            continue;
+        }
+
+        uint8_t msc[4] = {CMUX_MSC | CMUX_CR | CMUX_EA, (2 << 1) | CMUX_EA, (uint8_t)((channel.dlci << 2) | CMUX_CR | CMUX_EA),
+                          0x0D}; ///< RTC and RTR on, the modem may send
+        sendFrame(0, CMUX_UIH, msc, sizeof(msc));
+    }
+
+    return all;
+}
+
+/**************************************************************************/
+/*!
+    @brief Close down the multiplexer, the modem returns to AT command mode
+    @param timeout How long to wait for the modem to confirm in milliseconds
+   (optional)
+*/
+/**************************************************************************/
+void CMUX_Multiplexer::stop(unsigned long timeout)
+{
+    if (!started)
+        return;
+
+    for (uint8_t i = 0; i < CMUX_CHANNELS; i++)
+        channels[i].flush();
+
+    uint8_t cld[2] = {CMUX_CLD | CMUX_CR | CMUX_EA, CMUX_EA};
+    sendFrame(0, CMUX_UIH, cld, sizeof(cld));
+
+    unsigned long startTime = millis();
+    while (started && millis() - startTime < timeout)
+        update();
+
+    started = false;
+    openMask = 0;
+    for (uint8_t i = 0; i < CMUX_CHANNELS; i++)
+    {
+        channels[i].open = false;
+        channels[i].txLength = 0;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Decode the received frames and hand their data to the channels.
+   Reading any channel calls this, call it from loop() when only writing.
+*/
+/**************************************************************************/
+void CMUX_Multiplexer::update(void)
+{
+    while (Serial_Command_Handler::available())
+        decode(readByte());
+}
+
+/**************************************************************************/
+/*!
+    @brief Get a virtual channel
+    @param dlci Channel number, 1 to CMUX_CHANNELS
+    @returns Channel, NULL if dlci is out of range
+*/
+/**************************************************************************/
+CMUX_Channel *CMUX_Multiplexer::getChannel(uint8_t dlci)
+{
+    if (dlci < 1 || dlci > CMUX_CHANNELS)
+        return NULL;
+    return &channels[dlci - 1];
+}
+
+/**************************************************************************/
+/*!
+    @brief Check if the multiplexer is running
+    @returns True after a successful start() until stop()
+*/
+/**************************************************************************/
+bool CMUX_Multiplexer::isStarted(void) { return started; }
+
+/**************************************************************************/
+/*!
+    @brief Get how many frames were dropped for a bad FCS or a missing flag
+    @returns Frames dropped
+*/
+/**************************************************************************/
+uint16_t CMUX_Multiplexer::getFrameErrors(void) { return frameErrors; }
+
+/**************************************************************************/
+/*!
+    @brief Get how many frames were dropped for being longer than
+   CMUX_FRAME_SIZE
+    @returns Frames dropped
+*/
+/**************************************************************************/
+uint16_t CMUX_Multiplexer::getDroppedFrames(void) { return droppedFrames; }
+
+/**************************************************************************/
+/*!
+    @brief Send SABM on a DLCI and wait for the answer
+    @param dlci Channel to open, 0 for the control channel
+    @param timeout How long to wait in milliseconds
+    @returns True if the modem answered UA, False on DM or timeout
+*/
+/**************************************************************************/
+bool CMUX_Multiplexer::openChannel(uint8_t dlci, unsigned long timeout)
+{
+    uint8_t bit = 1 << dlci;
+
+    sendFrame(dlci, CMUX_SABM | CMUX_PF, NULL, 0);
+
+    unsigned long startTime = millis();
+    while (millis() - startTime < timeout)
+    {
+        update();
+        if (openMask & bit)
+            return true;
+        if (refusedMask & bit)
+            return false;
+    }
+    return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief Send one basic mode frame
+    @param dlci Channel
+    @param control Control field
+    @param data Information field, may be NULL if length is 0
+    @param length Bytes in data, at most CMUX_FRAME_SIZE
+    @param response Set to true when answering a command from the modem
+   (optional, default = false)
+*/
+/**************************************************************************/
+void CMUX_Multiplexer::sendFrame(uint8_t dlci, uint8_t control, const uint8_t *data, uint8_t length, bool response)
+{
+    uint8_t address = (dlci << 2) | (response ? 0 : CMUX_CR) | CMUX_EA; ///< This side started the multiplexer
+    uint8_t header[4] = {CMUX_FLAG, address, control, (uint8_t)((length << 1) | CMUX_EA)};
+    uint8_t fcs = 0xFF;
+
+    for (uint8_t i = 1; i < sizeof(header); i++)
+        fcs = fcsStep(fcs, header[i]);
+    if ((control & ~CMUX_PF) == CMUX_UI)
+        for (uint8_t i = 0; i < length; i++)
+            fcs = fcsStep(fcs, data[i]);
+
+    Print::write(header, sizeof(header));
+    if (length)
+        Print::write(data, length);
+    Serial_Command_Handler::write((uint8_t)(0xFF - fcs));
+    Serial_Command_Handler::write((uint8_t)CMUX_FLAG);
+}
+
+/**************************************************************************/
+/*!
+    @brief Feed one received byte to the frame decoder. The FCS is computed as
+   the bytes arrive, and the frame is only handed on once it and the closing
+   flag have been checked.
+    @param c Received byte
+*/
+/**************************************************************************/
+void CMUX_Multiplexer::decode(uint8_t c)
+{
+    switch (state)
+    {
+    case CMUX_WAIT_FLAG:
+        if (c == CMUX_FLAG)
+            state = CMUX_ADDRESS;
+        break;
+    case CMUX_ADDRESS:
+        if (c == CMUX_FLAG) ///< Flags may be repeated between frames
+            break;
+        if (!(c & CMUX_EA))
+        {
+            frameErrors++;
+            state = CMUX_WAIT_FLAG;
+            break;
+        }
+        frameAddress = c;
+        frameFcs = fcsStep(0xFF, c);
+        state = CMUX_CONTROL;
+        break;
+    case CMUX_CONTROL:
+        frameControl = c;
+        frameFcs = fcsStep(frameFcs, c);
+        state = CMUX_LENGTH;
+        break;
+    case CMUX_LENGTH:
+        frameFcs = fcsStep(frameFcs, c);
+        frameLength = c >> 1;
+        frameIdx = 0;
+        if (!(c & CMUX_EA))
+            state = CMUX_LENGTH_HIGH;
+        else
+            state = frameLength ? CMUX_DATA : CMUX_FCS;
+        break;
+    case CMUX_LENGTH_HIGH:
+        frameFcs = fcsStep(frameFcs, c);
+        frameLength |= (uint16_t)c << 7;
+        state = frameLength ? CMUX_DATA : CMUX_FCS;
+        break;
+    case CMUX_DATA:
+        if ((frameControl & ~CMUX_PF) == CMUX_UI)
+            frameFcs = fcsStep(frameFcs, c);
+        if (frameIdx < sizeof(frame))
+            frame[frameIdx] = c;
+        if (++frameIdx == frameLength)
+            state = CMUX_FCS;
+        break;
+    case CMUX_FCS:
+        frameFcs = fcsStep(frameFcs, c);
+        state = CMUX_CLOSE;
+        break;
+    case CMUX_CLOSE:
+        if (c != CMUX_FLAG || frameFcs != CMUX_FCS_GOOD)
+        {
+            frameErrors++;
+            state = CMUX_WAIT_FLAG;
+            break;
+        }
+        state = CMUX_ADDRESS; ///< The closing flag may open the next frame
+        if (frameLength > sizeof(frame))
+            droppedFrames++;
+        else
+            handleFrame();
+        break;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Act on a checked frame
+*/
+/**************************************************************************/
+void CMUX_Multiplexer::handleFrame(void)
+{
+    uint8_t dlci = frameAddress >> 2;
+    uint8_t bit = dlci < 8 ? 1 << dlci : 0;
+
+    switch (frameControl & ~CMUX_PF)
+    {
+    case CMUX_UA:
+        openMask |= bit;
+        break;
+    case CMUX_DM:
+        refusedMask |= bit;
+        openMask &= ~bit;
+        if (dlci >= 1 && dlci <= CMUX_CHANNELS)
+            channels[dlci - 1].open = false;
+        break;
+    case CMUX_DISC:
+        sendFrame(dlci, CMUX_UA | CMUX_PF, NULL, 0, true);
+        openMask &= ~bit;
+        if (dlci == 0)
+            started = false;
+        else if (dlci <= CMUX_CHANNELS)
+            channels[dlci - 1].open = false;
+        break;
+    case CMUX_UIH:
+    case CMUX_UI:
+        if (dlci == 0)
+            handleControl();
+        else if (dlci <= CMUX_CHANNELS)
+            channels[dlci - 1].receive(frame, frameLength);
+        break;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Act on a control channel message. Commands from the modem are
+   acknowledged by sending them back as responses.
+*/
+/**************************************************************************/
+void CMUX_Multiplexer::handleControl(void)
+{
+    if (frameLength < 2)
+        return;
+
+    uint8_t type = frame[0] & ~CMUX_CR;
+
+    if (frame[0] & CMUX_CR)
+    {
+        frame[0] = type;
+        sendFrame(0, CMUX_UIH, frame, frameLength);
+    }
+
+    if (type == (CMUX_CLD | CMUX_EA))
+        started = false;
+}
@@ -0,0 +1,155 @@
+#ifndef __CMUX_H__
+#define __CMUX_H__
+
+#include "Serial_Command_Handler.h"
+
+#ifndef CMUX_CHANNELS
+#define CMUX_CHANNELS 4 ///< virtual channels opened by start(), DLCI 1 to CMUX_CHANNELS
+#endif
+
+#if CMUX_CHANNELS < 1 || CMUX_CHANNELS > 7
+#error "CMUX_CHANNELS must be between 1 and 7"
+#endif
+
+#ifndef CMUX_FRAME_SIZE
+#define CMUX_FRAME_SIZE 127 ///< longest information field, must not exceed N1 of AT+CMUX (127 by default)
+#endif
+
+#if CMUX_FRAME_SIZE < 1 || CMUX_FRAME_SIZE > 127
+#error "CMUX_FRAME_SIZE must be between 1 and 127"
+#endif
+
+#ifndef CMUX_TX_SIZE
+#ifdef __AVR__
+#define CMUX_TX_SIZE 32 ///< bytes a channel collects before sending a frame
+#else
+#define CMUX_TX_SIZE CMUX_FRAME_SIZE ///< bytes a channel collects before sending a frame
+#endif
+#endif
+
+#if CMUX_TX_SIZE > CMUX_FRAME_SIZE
+#error "CMUX_TX_SIZE must not exceed CMUX_FRAME_SIZE"
+#endif
+
+#ifndef CMUX_RX_SIZE
+#ifdef __AVR__
+#define CMUX_RX_SIZE 64 ///< size of each channel's receive ring buffer, must be a power of two
+#else
+#define CMUX_RX_SIZE 256 ///< size of each channel's receive ring buffer, must be a power of two
+#endif
+#endif
+
+#if CMUX_RX_SIZE < 2 || CMUX_RX_SIZE > 32768 || (CMUX_RX_SIZE & (CMUX_RX_SIZE - 1)) != 0
+#error "CMUX_RX_SIZE must be a power of two between 2 and 32768"
+#endif
+
+class CMUX_Multiplexer;
+
+/**************************************************************************/
+/*!
+    @brief  One virtual channel of a CMUX_Multiplexer. It is a Stream, so it
+   can be given to the Stream constructor of MC60, MC60_GNSS or
+   Serial_Command_Handler, or used directly as a transparent data link.
+   Written bytes are sent as one frame when CMUX_TX_SIZE bytes are collected,
+   on flush(), or as soon as the channel is read.
+*/
+/**************************************************************************/
+class CMUX_Channel : public Stream
+{
+public:
+    int available(void);
+    int read(void);
+    int peek(void);
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    void flush(void);
+
+    bool isOpen(void);
+    uint32_t getOverflowBytes(void);
+
+private:
+    friend class CMUX_Multiplexer;
+
+    typedef uint16_t rx_index_t; ///< Free running RX ring buffer index, masked on access
+
+    void receive(const uint8_t *data, uint8_t length);
+
+    CMUX_Multiplexer *mux = NULL;   ///< Multiplexer carrying this channel
+    uint8_t dlci = 0;               ///< Data link connection identifier
+    bool open = false;              ///< SABM was acknowledged
+    uint8_t txBuffer[CMUX_TX_SIZE]; ///< Bytes for the next frame
+    uint8_t txLength = 0;           ///< Bytes in txBuffer
+    uint8_t rxBuffer[CMUX_RX_SIZE]; ///< Received bytes not read yet
+    rx_index_t rxHead = 0;          ///< Where the next received byte goes
+    rx_index_t rxTail = 0;          ///< Where the next read byte comes from
+    uint32_t overflowBytes = 0;     ///< Bytes dropped because rxBuffer was full
+};
+
+/**************************************************************************/
+/*!
+    @brief  GSM 07.10 / 3GPP 27.010 basic mode multiplexer. Switches the
+   serial port into CMUX mode with AT+CMUX and splits it into virtual
+   channels, so AT commands, GNSS polling and data can be interleaved on one
+   UART.
+*/
+/**************************************************************************/
+class CMUX_Multiplexer : public Serial_Command_Handler
+{
+public:
+#ifdef USE_SW_SERIAL
+    CMUX_Multiplexer(SoftwareSerial *ser);
+#endif
+    CMUX_Multiplexer(HardwareSerial *ser);
+    CMUX_Multiplexer(Stream *ser);
+    ~CMUX_Multiplexer();
+
+    bool start(unsigned long timeout = DEFAULT_TIMEOUT);
+    void stop(unsigned long timeout = DEFAULT_TIMEOUT);
+    void update(void);
+
+    CMUX_Channel *getChannel(uint8_t dlci);
+    bool isStarted(void);
+
+    uint16_t getFrameErrors(void);
+    uint16_t getDroppedFrames(void);
+
+private:
+    friend class CMUX_Channel;
+
+    typedef enum
+    {
+        CMUX_WAIT_FLAG,   ///< Looking for the opening flag
+        CMUX_ADDRESS,     ///< Waiting for the address field
+        CMUX_CONTROL,     ///< Waiting for the control field
+        CMUX_LENGTH,      ///< Waiting for the first length byte
+        CMUX_LENGTH_HIGH, ///< Waiting for the second length byte
+        CMUX_DATA,        ///< Receiving the information field
+        CMUX_FCS,         ///< Waiting for the frame check sequence
+        CMUX_CLOSE        ///< Waiting for the closing flag
+    } cmux_state;
+
+    void cmux_init(void);
+    bool openChannel(uint8_t dlci, unsigned long timeout);
+    void sendFrame(uint8_t dlci, uint8_t control, const uint8_t *data, uint8_t length, bool response = false);
+    void decode(uint8_t c);
+    void handleFrame(void);
+    void handleControl(void);
+
+    CMUX_Channel channels[CMUX_CHANNELS]; ///< Virtual channels, DLCI 1 and up
+    bool started = false;                 ///< The control channel is open
+    uint8_t openMask = 0;                 ///< Bit per DLCI acknowledged with UA
+    uint8_t refusedMask = 0;              ///< Bit per DLCI refused with DM
+
+    cmux_state state = CMUX_WAIT_FLAG;    ///< Where decode() is in the frame
+    uint8_t frameAddress = 0;             ///< Address field of the frame being received
+    uint8_t frameControl = 0;             ///< Control field of the frame being received
+    uint16_t frameLength = 0;             ///< Length of the information field
+    uint16_t frameIdx = 0;                ///< Information bytes received
+    uint8_t frameFcs = 0;                 ///< Running frame check sequence
+    uint8_t frame[CMUX_FRAME_SIZE];       ///< Information field being received
+    uint16_t frameErrors = 0;             ///< Frames with a bad FCS or missing flag
+    uint16_t droppedFrames = 0;           ///< Frames longer than CMUX_FRAME_SIZE
+};
+
+#endif
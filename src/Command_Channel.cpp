@@ -0,0 +1,480 @@
+#include "Command_Channel.h"
+
+#ifdef USE_COMMAND_CHANNEL
+
+#ifdef COMMAND_CHANNEL_PTHREAD
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/**************************************************************************/
+/*!
+    @brief Create a channel. Nothing is sent until a reader runs, see start()
+   and run().
+    @param handler Handler of the shared modem, must stay valid. Only the
+   reader may use it from now on.
+*/
+/**************************************************************************/
+Command_Channel::Command_Channel(Serial_Command_Handler *handler) : handler(handler)
+{
+#ifdef COMMAND_CHANNEL_FREERTOS
+    mutex = xSemaphoreCreateMutex();
+#else
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&work, NULL);
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief Stop the reader and free the locks
+*/
+/**************************************************************************/
+Command_Channel::~Command_Channel()
+{
+    stop();
+#ifdef COMMAND_CHANNEL_FREERTOS
+    vSemaphoreDelete(mutex);
+#else
+    pthread_cond_destroy(&work);
+    pthread_mutex_destroy(&mutex);
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief Create the reader task, or thread on POSIX, running run()
+    @param priority FreeRTOS priority of the task, ignored on POSIX
+   (optional, default = 1)
+    @returns True if the reader was created, False if it could not be or one
+   is already running
+*/
+/**************************************************************************/
+bool Command_Channel::start(uint8_t priority)
+{
+    lock();
+    bool busy = hasReader || started;
+    if (!busy)
+        started = true;
+    unlock();
+
+    if (busy)
+        return false;
+
+#ifdef COMMAND_CHANNEL_FREERTOS
+    if (xTaskCreate(taskEntry, "Command_Channel", COMMAND_CHANNEL_STACK_SIZE, this, priority, NULL) == pdPASS)
+        return true;
+#else
+    (void)priority;
+    if (pthread_create(&thread, NULL, threadEntry, this) == 0)
+        return true;
+#endif
+
+    lock();
+    started = false;
+    unlock();
+    return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief Make the reader return and wait until it did. Commands still
+   waiting stay queued and run once a reader runs again. Must not be called
+   from the reader.
+*/
+/**************************************************************************/
+void Command_Channel::stop(void)
+{
+    if (isReader())
+        return;
+
+    lock();
+    bool active = hasReader || started;
+    stopping = active;
+    unlock();
+
+    if (!active)
+        return;
+
+    wake();
+
+#ifdef COMMAND_CHANNEL_PTHREAD
+    lock();
+    bool joinable = started;
+    unlock();
+
+    if (joinable)
+    {
+        pthread_join(thread, NULL);
+        lock();
+        started = false;
+        unlock();
+    }
+#endif
+
+    for (;;) ///< A task running run() itself, or the FreeRTOS task finishing
+    {
+        lock();
+        active = hasReader || started;
+        unlock();
+
+        if (!active)
+            break;
+#ifdef COMMAND_CHANNEL_FREERTOS
+        vTaskDelay(1);
+#else
+        usleep(1000);
+#endif
+    }
+
+    lock();
+    stopping = false;
+    unlock();
+}
+
+/**************************************************************************/
+/*!
+    @brief The reader loop, returns after stop(). Use it as the body of your
+   own task instead of start() if you need control over its stack or core.
+   Sleeps between reads of the port, so lower priority tasks get to run, and
+   wakes as soon as a command is submitted.
+*/
+/**************************************************************************/
+void Command_Channel::run(void)
+{
+    lock();
+    if (hasReader)
+    {
+        unlock();
+        return;
+    }
+    hasReader = true;
+#ifdef COMMAND_CHANNEL_FREERTOS
+    reader = xTaskGetCurrentTaskHandle();
+#else
+    reader = pthread_self();
+#endif
+    unlock();
+
+    while (!stopping)
+        sleep(service() ? COMMAND_CHANNEL_POLL_INTERVAL : COMMAND_CHANNEL_IDLE_WAIT);
+
+    lock();
+    hasReader = false;
+#ifdef COMMAND_CHANNEL_FREERTOS
+    reader = NULL;
+#endif
+    unlock();
+}
+
+/**************************************************************************/
+/*!
+    @brief One pass of the reader: hand waiting commands to the handler while
+   its queue has room, then process what arrived on the port. Unsolicited
+   result codes are dispatched from here, so their handlers run in the
+   reader. Call it only from the task that owns the handler.
+    @returns True if commands are waiting or running
+*/
+/**************************************************************************/
+bool Command_Channel::service(void)
+{
+    lock();
+    while (head)
+    {
+        if (!handler->queueCommand(head->command, head->response, onCommand, head, head->timeout, head->capture,
+                                   head->captureLength))
+            break;
+
+        head = head->next;
+        if (!head)
+            tail = NULL;
+        waiting--;
+        inFlight++;
+    }
+    uint8_t left = waiting;
+    unlock();
+
+    uint8_t before;
+    do
+    {
+        before = inFlight;
+        handler->poll(); ///< Poll again after a completion so the next command goes out now
+    } while (inFlight && inFlight < before);
+
+    return inFlight || left;
+}
+
+/**************************************************************************/
+/*!
+    @brief Send a command from any task and sleep until it completes. The
+   handler's blocking and queued commands must not be used directly while a
+   channel drives it. Calling this from the reader, e.g. from an unsolicited
+   result code handler, would wait for itself and fails instead.
+    @param cmd Command including the "\r", must stay valid until it completes
+    @param response Expected response, NULL or empty for "OK" (optional)
+    @param timeout Timeout in milliseconds (optional, default =
+   DEFAULT_TIMEOUT)
+    @param capture Buffer for the rest of the response line (optional)
+    @param captureLength Size of capture (optional)
+    @param errorCode Receives the +CME/+CMS ERROR code, -1 if none (optional)
+    @returns Result of the command, RESULT_ERROR when called from the reader
+*/
+/**************************************************************************/
+command_result Command_Channel::execute(const char *cmd, const char *response, unsigned long timeout, char *capture,
+                                        uint8_t captureLength, int16_t *errorCode)
+{
+    if (isReader())
+        return RESULT_ERROR;
+
+    channel_request request;
+    request.command = cmd;
+    request.response = response;
+    request.timeout = timeout;
+    request.capture = capture;
+    request.captureLength = captureLength;
+    request.result = RESULT_PENDING;
+    request.errorCode = -1;
+    request.channel = this;
+    request.next = NULL;
+#ifdef COMMAND_CHANNEL_FREERTOS
+    request.waiter = xTaskGetCurrentTaskHandle();
+#else
+    pthread_cond_init(&request.ready, NULL);
+#endif
+
+    lock();
+    if (tail)
+        tail->next = &request;
+    else
+        head = &request;
+    tail = &request;
+    if (++waiting > maxWaiting)
+        maxWaiting = waiting;
+
+#ifdef COMMAND_CHANNEL_FREERTOS
+    unlock();
+    wake();
+
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        lock();
+        bool pending = request.result == RESULT_PENDING;
+        unlock();
+
+        if (!pending)
+            break;
+    }
+#else
+    pthread_cond_signal(&work);
+
+    while (request.result == RESULT_PENDING)
+        pthread_cond_wait(&request.ready, &mutex);
+    unlock();
+
+    pthread_cond_destroy(&request.ready);
+#endif
+
+    if (errorCode)
+        *errorCode = request.errorCode;
+    return request.result;
+}
+
+/**************************************************************************/
+/*!
+    @brief Number of commands completed since the channel was created
+    @returns Completed commands
+*/
+/**************************************************************************/
+uint32_t Command_Channel::getCompleted(void)
+{
+    lock();
+    uint32_t value = completed;
+    unlock();
+    return value;
+}
+
+/**************************************************************************/
+/*!
+    @brief The most commands that ever waited for the handler at once, to
+   size COMMAND_QUEUE_SIZE and to see how contended the modem is
+    @returns Highest number of waiting commands
+*/
+/**************************************************************************/
+uint8_t Command_Channel::getMaxWaiting(void)
+{
+    lock();
+    uint8_t value = maxWaiting;
+    unlock();
+    return value;
+}
+
+/**************************************************************************/
+/*!
+    @brief Take the mutex protecting the request list
+*/
+/**************************************************************************/
+void Command_Channel::lock(void)
+{
+#ifdef COMMAND_CHANNEL_FREERTOS
+    xSemaphoreTake(mutex, portMAX_DELAY);
+#else
+    pthread_mutex_lock(&mutex);
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief Give back the mutex protecting the request list
+*/
+/**************************************************************************/
+void Command_Channel::unlock(void)
+{
+#ifdef COMMAND_CHANNEL_FREERTOS
+    xSemaphoreGive(mutex);
+#else
+    pthread_mutex_unlock(&mutex);
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief Check if the caller is the task running run()
+    @returns True if called from the reader
+*/
+/**************************************************************************/
+bool Command_Channel::isReader(void)
+{
+    lock();
+#ifdef COMMAND_CHANNEL_FREERTOS
+    bool self = hasReader && reader == xTaskGetCurrentTaskHandle();
+#else
+    bool self = hasReader && pthread_equal(reader, pthread_self());
+#endif
+    unlock();
+    return self;
+}
+
+/**************************************************************************/
+/*!
+    @brief Wake the reader from sleep()
+*/
+/**************************************************************************/
+void Command_Channel::wake(void)
+{
+    lock();
+#ifdef COMMAND_CHANNEL_FREERTOS
+    if (reader)
+        xTaskNotifyGive(reader);
+#else
+    pthread_cond_signal(&work);
+#endif
+    unlock();
+}
+
+/**************************************************************************/
+/*!
+    @brief Sleep until wake() is called or the time is up
+    @param ms Longest time to sleep in milliseconds, rounded up to one tick on
+   FreeRTOS
+*/
+/**************************************************************************/
+void Command_Channel::sleep(uint32_t ms)
+{
+#ifdef COMMAND_CHANNEL_FREERTOS
+    TickType_t ticks = pdMS_TO_TICKS(ms);
+    ulTaskNotifyTake(pdTRUE, ticks ? ticks : 1);
+#else
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += ms / 1000;
+    until.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (until.tv_nsec >= 1000000000L)
+    {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+
+    lock();
+    if (!head && !stopping)
+        pthread_cond_timedwait(&work, &mutex, &until);
+    unlock();
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief Hand the result to the task waiting in execute(). The request
+   lives on that task's stack, so it is not touched once the result is set.
+    @param request Completed request
+    @param result Its result
+*/
+/**************************************************************************/
+void Command_Channel::complete(channel_request *request, command_result result)
+{
+    int16_t code = handler->getLastErrorCode();
+    inFlight--;
+
+    lock();
+    completed++;
+#ifdef COMMAND_CHANNEL_FREERTOS
+    TaskHandle_t waiter = request->waiter;
+#endif
+    request->errorCode = code;
+    request->result = result;
+#ifdef COMMAND_CHANNEL_FREERTOS
+    unlock();
+    xTaskNotifyGive(waiter);
+#else
+    pthread_cond_signal(&request->ready); ///< The waiter cannot return before we unlock
+    unlock();
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief Completion callback of the commands queued by service()
+    @param result Result of the command
+    @param context The channel_request
+*/
+/**************************************************************************/
+void Command_Channel::onCommand(command_result result, void *context)
+{
+    channel_request *request = (channel_request *)context;
+    request->channel->complete(request, result);
+}
+
+#ifdef COMMAND_CHANNEL_FREERTOS
+/**************************************************************************/
+/*!
+    @brief Body of the task created by start()
+    @param channel The Command_Channel
+*/
+/**************************************************************************/
+void Command_Channel::taskEntry(void *channel)
+{
+    Command_Channel *self = (Command_Channel *)channel;
+    self->run();
+
+    self->lock();
+    self->started = false;
+    self->unlock();
+    vTaskDelete(NULL);
+}
+#else
+/**************************************************************************/
+/*!
+    @brief Body of the thread created by start()
+    @param channel The Command_Channel
+    @returns NULL
+*/
+/**************************************************************************/
+void *Command_Channel::threadEntry(void *channel)
+{
+    ((Command_Channel *)channel)->run();
+    return NULL;
+}
+#endif
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef __COMMAND_CHANNEL_H__
+#define __COMMAND_CHANNEL_H__
+
+#include "Serial_Command_Handler.h"
+
+#if defined(ESP_PLATFORM) || defined(ARDUINO_ARCH_ESP32)
+#define COMMAND_CHANNEL_FREERTOS
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define COMMAND_CHANNEL_PTHREAD
+#include <pthread.h>
+#endif
+
+#if defined(COMMAND_CHANNEL_FREERTOS) || defined(COMMAND_CHANNEL_PTHREAD)
+#define USE_COMMAND_CHANNEL
+
+#ifndef COMMAND_CHANNEL_IDLE_WAIT
+#define COMMAND_CHANNEL_IDLE_WAIT 10 ///< milliseconds the reader sleeps when idle before checking for URCs again
+#endif
+
+#ifndef COMMAND_CHANNEL_POLL_INTERVAL
+#define COMMAND_CHANNEL_POLL_INTERVAL 1 ///< milliseconds between reads of the port while commands are running
+#endif
+
+#ifndef COMMAND_CHANNEL_STACK_SIZE
+#define COMMAND_CHANNEL_STACK_SIZE 4096 ///< stack of the FreeRTOS reader task, in bytes
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Lets several tasks or threads share one modem. A reader task owns
+   the handler and is the only one that touches its buffers and the port.
+   Other tasks hand their commands to execute(), which puts them on a mutex
+   protected queue and sleeps until the reader reports the result. The
+   reader keeps the handler's command queue full, so the next command goes
+   out as soon as the previous one completes. Uses FreeRTOS on ESP32 and
+   pthreads on POSIX hosts.
+*/
+/**************************************************************************/
+class Command_Channel
+{
+public:
+    Command_Channel(Serial_Command_Handler *handler);
+    ~Command_Channel();
+
+    bool start(uint8_t priority = 1);
+    void stop(void);
+    void run(void);
+    bool service(void);
+
+    command_result execute(const char *cmd, const char *response = NULL, unsigned long timeout = DEFAULT_TIMEOUT,
+                           char *capture = NULL, uint8_t captureLength = 0, int16_t *errorCode = NULL);
+
+    uint32_t getCompleted(void);
+    uint8_t getMaxWaiting(void);
+
+private:
+    /// One execute() call, lives on the caller's stack until it completes
+    typedef struct request
+    {
+        const char *command;         ///< Command to send
+        const char *response;        ///< Expected response, NULL for "OK"
+        unsigned long timeout;       ///< Timeout of the command in milliseconds
+        char *capture;               ///< Rest of the response line, may be NULL
+        uint8_t captureLength;       ///< Size of capture
+        command_result result;       ///< Result, RESULT_PENDING until done
+        int16_t errorCode;           ///< +CME/+CMS ERROR code, -1 if none
+        Command_Channel *channel;    ///< Channel it was submitted to
+        struct request *next;        ///< Next request waiting in the channel
+#ifdef COMMAND_CHANNEL_FREERTOS
+        TaskHandle_t waiter;         ///< Task sleeping in execute()
+#else
+        pthread_cond_t ready;        ///< Signalled when result is set
+#endif
+    } channel_request;
+
+    void lock(void);
+    void unlock(void);
+    bool isReader(void);
+    void wake(void);
+    void sleep(uint32_t ms);
+    void complete(channel_request *request, command_result result);
+    static void onCommand(command_result result, void *context);
+#ifdef COMMAND_CHANNEL_FREERTOS
+    static void taskEntry(void *channel);
+#else
+    static void *threadEntry(void *channel);
+#endif
+
+    Serial_Command_Handler *handler;        ///< Handler owned by the reader
+    channel_request *head = NULL;           ///< Oldest request not handed to the handler yet
+    channel_request *tail = NULL;           ///< Newest request not handed to the handler yet
+    uint8_t waiting = 0;                    ///< Requests in the list
+    uint8_t maxWaiting = 0;                 ///< Most requests ever in the list
+    uint8_t inFlight = 0;                   ///< Requests queued on the handler
+    uint32_t completed = 0;                 ///< Requests completed
+    volatile bool stopping = false;         ///< stop() asked run() to return
+    bool hasReader = false;                 ///< run() is running in reader
+    bool started = false;                   ///< start() created the reader
+
+#ifdef COMMAND_CHANNEL_FREERTOS
+    SemaphoreHandle_t mutex = NULL;         ///< Protects the request list
+    TaskHandle_t reader = NULL;             ///< Task running run()
+#else
+    pthread_mutex_t mutex;                  ///< Protects the request list and the results
+    pthread_cond_t work;                    ///< Signalled when a request is submitted
+    pthread_t reader;                       ///< Thread running run()
+    pthread_t thread;                       ///< Thread created by start()
+#endif
+};
+
+#endif
+
+#endif
@@ -1,5 +1,96 @@
 #include "MC60.h"
 
+/**************************************************************************/
+/*!
+    @brief Read the <stat> after the first ',' of +CREG or +CGREG
+    @param handler The MC60 that sent the command
+    @param result registation_codes to set, INVALID_CODE if it is not readable
+    @returns True if the status was read
+*/
+/**************************************************************************/
+static bool parseRegistration(Serial_Command_Handler *handler, void *result)
+{
+    char *rb = handler->readbetween(',', '\r');
+    (void)handler->waitForOK();
+    *(registation_codes *)result = (rb != NULL && abs(rb[0] - 48) <= 5 ? (registation_codes)(rb[0] - 48) : registation_codes::INVALID_CODE);
+    return rb != NULL;
+}
+
+/**************************************************************************/
+/*!
+    @brief Read a 0/1 setting, e.g. the power state of +QGNSSC
+    @param handler The MC60 that sent the command
+    @param result bool to set, true if the setting is 1
+    @returns True if the setting was read
+*/
+/**************************************************************************/
+static bool parseFlag(Serial_Command_Handler *handler, void *result)
+{
+    char state[4];
+    bool read = handler->readline(state, sizeof(state)) > 0;
+    (void)handler->waitForOK();
+    *(bool *)result = read && state[0] == '1';
+    return read;
+}
+
+/**************************************************************************/
+/*!
+    @brief Write a number in decimal, for the arguments of the commands below
+    @param dest Buffer, 11 characters hold any value
+    @param value Number to write
+    @returns Pointer to the terminator after the digits
+*/
+/**************************************************************************/
+static char *formatNumber(char *dest, uint32_t value)
+{
+    char digits[10];
+    uint8_t count = 0;
+
+    do
+    {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    while (count)
+        *dest++ = digits[--count];
+    *dest = '\0';
+    return dest;
+}
+
+AT_COMMAND(AT_BAUD, "AT+IPR=", "", DEFAULT_TIMEOUT, NULL);
+AT_COMMAND(AT_AUTO_BAUD, "AT+IPR=0", "", DEFAULT_TIMEOUT, NULL);
+AT_COMMAND(AT_ECHO_ON, "ATE1", "", DEFAULT_TIMEOUT, NULL);
+AT_COMMAND(AT_FLOW_CONTROL, "AT+IFC=2,2", "", DEFAULT_TIMEOUT, NULL);
+AT_COMMAND(AT_REGISTRATION_URC, "AT+CREG=1", "", DEFAULT_TIMEOUT, NULL);
+AT_COMMAND(AT_POWER_DOWN_URGENT, "AT+QPOWD=0", "", 300, NULL);
+AT_COMMAND(AT_POWER_DOWN, "AT+QPOWD=1", "NORMAL POWER DOWN", 300, NULL);
+AT_COMMAND(AT_ATI, "ATI", "ATI\r\r\n", 300, NULL);
+AT_COMMAND(AT_IMSI, "AT+CIMI", "AT+CIMI\r\r\n", 300, NULL);
+AT_COMMAND(AT_ICCID, "AT+QCCID", "AT+QCCID\r\r\n", 300, NULL);
+AT_COMMAND(AT_CREG, "AT+CREG?", "+CREG: ", 300, parseRegistration);
+AT_COMMAND(AT_CGREG, "AT+CGREG?", "+CGREG: ", 300, parseRegistration);
+AT_COMMAND(AT_COPS, "AT+COPS?", "+COPS: ", 300, NULL);
+AT_COMMAND(AT_SIM_READY, "AT+CPIN?", "+CPIN: READY\r\n\r\nOK", DEFAULT_TIMEOUT, NULL);
+AT_COMMAND(AT_SMS_TEXT_MODE, "AT+CMGF=1", "", DEFAULT_TIMEOUT, NULL);
+AT_COMMAND(AT_SMS_PDU_MODE, "AT+CMGF=0", "", DEFAULT_TIMEOUT, NULL);
+AT_COMMAND(AT_SMS_CHARSET, "AT+CSCS=\"GSM\"", "", DEFAULT_TIMEOUT, NULL);
+AT_COMMAND(AT_SMS_KEEP_LINK, "AT+CMMS=2", "", DEFAULT_TIMEOUT, NULL);
+AT_COMMAND(AT_SMS_RELEASE_LINK, "AT+CMMS=0", "", DEFAULT_TIMEOUT, NULL);
+AT_COMMAND(AT_SMS_SUBMIT, "AT+CMGS=", "> ", 300, NULL);
+AT_COMMAND(AT_SMS_READ, "AT+CMGR=", "+CMGR: ", DEFAULT_TIMEOUT, NULL);
+AT_COMMAND(AT_SMS_LIST, "AT+CMGL=", "+CMGL: ", DEFAULT_TIMEOUT, NULL);
+AT_COMMAND(AT_SMS_DELETE, "AT+CMGD=", "", DEFAULT_TIMEOUT, NULL);
+AT_COMMAND(AT_SMS_DELETE_ALL, "AT+CMGD=", "", 5000, NULL);
+AT_COMMAND(AT_GNSS_STATE, "AT+QGNSSC?", "+QGNSSC: ", DEFAULT_TIMEOUT, parseFlag);
+AT_COMMAND(AT_GNSS_ON, "AT+QGNSSC=1", "", DEFAULT_TIMEOUT, NULL);
+AT_COMMAND(AT_GNSS_GGA, "AT+QGNSSRD=\"NMEA/GGA\"", "+QGNSSRD: ", 300, NULL);
+AT_COMMAND(AT_GNSS_EPOCH, "AT+QGNSSRD?", "+QGNSSRD: ", 300, NULL);
+
+static const char ATI_REVISION[] PROGMEM = "Revision: "; ///< Starts the version line of ATI
+static const char SMS_SUBMITTED[] PROGMEM = "+CMGS: ";   ///< Reports the reference of a submitted SMS
+static const char SMS_ESCAPE[] PROGMEM = "\x1B";         ///< Ends SMS text entry without sending
+
 /**************************************************************************/
 /*!
     @brief Start the HW or SW serial port, power up and initialize MC60
@@ -37,7 +128,8 @@ uint8_t MC60::begin(uint32_t baud, uint8_t pin)
 
 /**************************************************************************/
 /*!
-    @brief Initialize MC60
+    @brief Initialize MC60. Also enables the +CREG URC with AT+CREG=1, which
+   drops the cached operator name whenever the registration changes
     @param mcbaud Baud rate for serial communication
     @param autoBaud Set baud rate to auto (optional, default = false)
     @returns False on failure, true on success
@@ -49,18 +141,19 @@ bool MC60::initialize(uint32_t mc60Baud, bool autoBaud)
 
     if (!autoBaud)
     {
-        char cmd[20];
-        sprintf(cmd, "AT+IPR=%lu\r", mc60Baud);
+        char baud[11];
+        (void)formatNumber(baud, mc60Baud);
 
-        initialization += sendCommandWaitOK(cmd); ///< Set baud rate
+        initialization += sendCommand(&AT_BAUD, baud) == RESULT_OK; ///< Set baud rate
     }
     else
-        initialization += sendCommandWaitOK("AT+IPR=0\r"); ///< Set baud rate to auto
+        initialization += sendCommand(&AT_AUTO_BAUD) == RESULT_OK; ///< Set baud rate to auto
 
-    initialization += sendCommandWaitOK("ATE1\r");       ///< Turn on echo
-    initialization += sendCommandWaitOK("AT+IFC=2,2\r"); ///< Set flow control to hardware
+    initialization += sendCommand(&AT_ECHO_ON) == RESULT_OK;      ///< Turn on echo
+    initialization += sendCommand(&AT_FLOW_CONTROL) == RESULT_OK; ///< Set flow control to hardware
+    initialization += sendCommand(&AT_REGISTRATION_URC) == RESULT_OK; ///< Report registration changes with +CREG URCs
 
-    return initialization == 3; ///< If all commands were successful, return true
+    return initialization == 4; ///< If all commands were successful, return true
 }
 
 /**************************************************************************/
@@ -75,9 +168,9 @@ bool MC60::initializeSMS()
         return true;
 
     initialization = 0;
-    initialization += sendCommandWait("AT+CPIN?\r", "+CPIN: READY\r\n\r\nOK"); ///< Check SIM card
-    initialization += sendCommandWaitOK("AT+CMGF=1\r");                        ///< Set SMS to text mode
-    initialization += sendCommandWaitOK("AT+CSCS=\"GSM\"\r");                  ///< Set SMS to GSM mode
+    initialization += sendCommand(&AT_SIM_READY) == RESULT_OK;     ///< Check SIM card
+    initialization += sendCommand(&AT_SMS_TEXT_MODE) == RESULT_OK; ///< Set SMS to text mode
+    initialization += sendCommand(&AT_SMS_CHARSET) == RESULT_OK;   ///< Set SMS to GSM mode
 
     return smsInitialized = initialization == 3; ///< If all commands were successful, return true
 }
@@ -93,10 +186,14 @@ bool MC60::initializeGPS()
     if (gpsInitialized)
         return true;
 
-    if (sendCommandWait("AT+QGNSSC?\r", "+QGNSSC: 0\r\n\r\nOK"))    ///< Check if GNSS is disabled
-        return gpsInitialized = sendCommandWaitOK("AT+QGNSSC=1\r"); ///< Enable GNSS
-    else
-        return gpsInitialized = sendCommandWait("AT+QGNSSC?\r", "+QGNSSC: 1\r\n\r\nOK"); ///< Check if GNSS is enabled
+    bool enabled;
+    if (sendCommand(&AT_GNSS_STATE, NULL, &enabled) != RESULT_OK) ///< Query GNSS power state
+        return false;
+
+    if (enabled) ///< Already enabled
+        return gpsInitialized = true;
+
+    return gpsInitialized = sendCommand(&AT_GNSS_ON) == RESULT_OK; ///< Enable GNSS
 }
 
 /**************************************************************************/
@@ -108,6 +205,7 @@ bool MC60::initializeGPS()
 #if (defined(__AVR__) || defined(ESP8266)) && defined(USE_SW_SERIAL)
 MC60::MC60(SoftwareSerial *ser) : Serial_Command_Handler(ser)
 {
+    mc60_init();
 }
 #endif
 
@@ -117,14 +215,22 @@ MC60::MC60(SoftwareSerial *ser) : Serial_Command_Handler(ser)
     @param ser Pointer to a HardwareSerial object
 */
 /**************************************************************************/
-MC60::MC60(HardwareSerial *ser) : Serial_Command_Handler(ser) {}
+MC60::MC60(HardwareSerial *ser) : Serial_Command_Handler(ser) { mc60_init(); }
+
+/**************************************************************************/
+/*!
+    @brief Constructor for any other Stream, e.g. MC60_Simulator
+    @param ser Pointer to a Stream object
+*/
+/**************************************************************************/
+MC60::MC60(Stream *ser) : Serial_Command_Handler(ser) { mc60_init(); }
 
 /**************************************************************************/
 /*!
     @brief Constructor when there are no communications attached
 */
 /**************************************************************************/
-MC60::MC60() : Serial_Command_Handler() {}
+MC60::MC60() : Serial_Command_Handler() { mc60_init(); }
 
 MC60::~MC60() = default;
 
@@ -170,7 +276,7 @@ bool MC60::powerDown(bool urgent, uint8_t pin)
         digitalWrite(pin, HIGH);
         delay(1200);
         digitalWrite(pin, LOW);
-        if (waitForResponse("NORMAL POWER DOWN"))
+        if (waitForResponse_P(AT_POWER_DOWN_RESPONSE))
         {
             connected = false;
             return true;
@@ -178,20 +284,152 @@ bool MC60::powerDown(bool urgent, uint8_t pin)
     }
 
     if (urgent)
-        if (sendCommandWaitOK("AT+QPOWD=0\r", 300))
+    {
+        if (sendCommand(&AT_POWER_DOWN_URGENT) == RESULT_OK)
         {
             connected = false;
             return true;
         }
-        else if (sendCommandWait("AT+QPOWD=1\r", "NORMAL POWER DOWN", 300))
+        else if (sendCommand(&AT_POWER_DOWN) == RESULT_OK)
         {
             connected = false;
             return true;
         }
+    }
 
     return false;
 }
 
+/**************************************************************************/
+/*!
+    @brief Initialization code used by all constructor types
+*/
+/**************************************************************************/
+void MC60::mc60_init(void)
+{
+    memset(&identity, 0, sizeof(identity));
+    (void)onUnsolicited("+CREG:", onRegistrationChange, this);
+    (void)onUnsolicited("+CMTI:", onNewSMS, this);
+}
+
+/**************************************************************************/
+/*!
+    @brief Read the whole identity with one ATI, one AT+CIMI and one AT+QCCID
+   and cache it, replacing whatever was cached before
+    @returns True if every field was read, False otherwise
+*/
+/**************************************************************************/
+bool MC60::refreshIdentity(void)
+{
+    invalidateIdentity(IDENTITY_ATI | IDENTITY_IMSI | IDENTITY_ICCID);
+    return (getIdentity().valid & (IDENTITY_ATI | IDENTITY_IMSI | IDENTITY_ICCID)) ==
+           (IDENTITY_ATI | IDENTITY_IMSI | IDENTITY_ICCID);
+}
+
+/**************************************************************************/
+/*!
+    @brief Get the cached identity, reading only the fields not cached yet.
+   The operator name is not read here, see getOperatorName().
+    @returns Cached identity, check valid for the fields that could be read
+*/
+/**************************************************************************/
+const mc60_identity &MC60::getIdentity(void)
+{
+    if (!(identity.valid & IDENTITY_ATI))
+        (void)readATI();
+    if (!(identity.valid & IDENTITY_IMSI))
+        (void)readIdentityLine(&AT_IMSI, identity.IMSI, sizeof(identity.IMSI), IDENTITY_IMSI);
+    if (!(identity.valid & IDENTITY_ICCID))
+        (void)readIdentityLine(&AT_ICCID, identity.ICCID, sizeof(identity.ICCID), IDENTITY_ICCID);
+
+    return identity;
+}
+
+/**************************************************************************/
+/*!
+    @brief Drop cached identity fields so the next getter reads them again,
+   e.g. after a SIM swap or after selecting an operator with AT+COPS=
+    @param fields IDENTITY_* flags of the fields to drop (optional, default = all)
+*/
+/**************************************************************************/
+void MC60::invalidateIdentity(uint8_t fields) { identity.valid &= ~fields; }
+
+/**************************************************************************/
+/*!
+    @brief Read manufacturer ID, module and version with a single ATI. The
+   fields are left empty unless all three are read.
+    @returns True on success, False on failure
+*/
+/**************************************************************************/
+bool MC60::readATI(void)
+{
+    identity.valid &= ~IDENTITY_ATI;
+    identity.manufacturer_ID[0] = '\0';
+    identity.module[0] = '\0';
+    identity.version[0] = '\0';
+
+    if (sendCommand(&AT_ATI) != RESULT_OK)
+        return false;
+
+    (void)readline(identity.manufacturer_ID, sizeof(identity.manufacturer_ID));
+    (void)readline(identity.module, sizeof(identity.module));
+    if (waitForResponse_P(ATI_REVISION))
+        (void)readline(identity.version, sizeof(identity.version));
+
+    if (waitForOK() && identity.manufacturer_ID[0] != '\0' && identity.module[0] != '\0' &&
+        identity.version[0] != '\0')
+        identity.valid |= IDENTITY_ATI;
+    else
+    {
+        identity.manufacturer_ID[0] = '\0';
+        identity.module[0] = '\0';
+        identity.version[0] = '\0';
+    }
+
+    return identity.valid & IDENTITY_ATI;
+}
+
+/**************************************************************************/
+/*!
+    @brief Read a single line response into an identity field, left empty
+   when the read fails
+    @param cmd Command to send, its response is the echo before the line
+    @param dest Identity field
+    @param length Size of dest
+    @param field IDENTITY_* flag of the field
+    @returns True on success, False on failure
+*/
+/**************************************************************************/
+bool MC60::readIdentityLine(const at_command *cmd, char *dest, uint8_t length, uint8_t field)
+{
+    identity.valid &= ~field;
+    dest[0] = '\0';
+
+    if (sendCommand(cmd) != RESULT_OK)
+        return false;
+
+    (void)readline(dest, length);
+    if (waitForOK() && dest[0] != '\0')
+        identity.valid |= field;
+    else
+        dest[0] = '\0';
+
+    return identity.valid & field;
+}
+
+/**************************************************************************/
+/*!
+    @brief Drop the cached operator when a +CREG URC reports a change
+    @param line Unsolicited line
+    @param context The MC60 that registered the handler
+*/
+/**************************************************************************/
+void MC60::onRegistrationChange(const char *line, void *context)
+{
+    (void)line;
+    static_cast<MC60 *>(context)->invalidateIdentity(IDENTITY_OPERATOR);
+}
+
 /**************************************************************************/
 /*!
     @brief Get manufacturer ID
@@ -200,13 +438,9 @@ bool MC60::powerDown(bool urgent, uint8_t pin)
 /**************************************************************************/
 String MC60::getManufacturerID(void)
 {
-    if (sendCommandWait("ATI\r", "ATI\r\r\n", 300))
-    {
-        String manufacturer_ID = readline();
-        (void)waitForOK();
-        return manufacturer_ID;
-    }
-    return "";
+    if (!(identity.valid & IDENTITY_ATI) && !readATI())
+        return "";
+    return identity.manufacturer_ID;
 }
 
 /**************************************************************************/
@@ -217,14 +451,9 @@ String MC60::getManufacturerID(void)
 /**************************************************************************/
 String MC60::getModule(void)
 {
-    if (sendCommandWait("ATI\r", "ATI\r\r\n", 300))
-    {
-        (void)readline();
-        String module = readline();
-        (void)waitForOK();
-        return module;
-    }
-    return "";
+    if (!(identity.valid & IDENTITY_ATI) && !readATI())
+        return "";
+    return identity.module;
 }
 
 /**************************************************************************/
@@ -235,16 +464,9 @@ String MC60::getModule(void)
 /**************************************************************************/
 String MC60::getVersion(void)
 {
-    if (sendCommandWait("ATI\r", "ATI\r\r\n", 300))
-    {
-        (void)readline();
-        (void)readline();
-        (void)waitForResponse("Revision: ");
-        String version = readline();
-        (void)waitForOK();
-        return version;
-    }
-    return "";
+    if (!(identity.valid & IDENTITY_ATI) && !readATI())
+        return "";
+    return identity.version;
 }
 
 /**************************************************************************/
@@ -255,11 +477,14 @@ String MC60::getVersion(void)
 /**************************************************************************/
 registation_codes MC60::getNetworkRegistration(void)
 {
-    if (sendCommandWait("AT+CREG?\r", "+CREG: ", 300))
+    registation_codes status;
+    if (sendCommand(&AT_CREG, NULL, &status) == RESULT_OK)
     {
-        char *rb = readbetween(',', '\r');
-        (void)waitForOK();
-        return (abs(rb[0] - 48) <= 5 ? (registation_codes)(rb[0] - 48) : registation_codes::INVALID_CODE);
+        if (status != lastRegistration) ///< Registration changed, the operator may have too
+            invalidateIdentity(IDENTITY_OPERATOR);
+        lastRegistration = status;
+
+        return status;
     }
     return registation_codes::INVALID_CODE;
 }
@@ -272,28 +497,36 @@ registation_codes MC60::getNetworkRegistration(void)
 /**************************************************************************/
 registation_codes MC60::getGPRSRegistration(void)
 {
-    if (sendCommandWait("AT+CGREG?\r", "+CGREG: ", 300))
-    {
-        char *rb = readbetween(',', '\r');
-        (void)waitForOK();
-        return (abs(rb[0] - 48) <= 5 ? (registation_codes)(rb[0] - 48) : registation_codes::INVALID_CODE);
-    }
+    registation_codes status;
+    if (sendCommand(&AT_CGREG, NULL, &status) == RESULT_OK)
+        return status;
     return registation_codes::INVALID_CODE;
 }
 
 /**************************************************************************/
 /*!
-    @brief Get operator name
+    @brief Get operator name, cached until the network registration changes
     @returns Operator name
 */
 /**************************************************************************/
 String MC60::getOperatorName(void)
 {
-    if (sendCommandWait("AT+COPS?\r", "+COPS: ", 300))
+    if (identity.valid & IDENTITY_OPERATOR)
+        return identity.operator_name;
+
+    if (sendCommand(&AT_COPS) == RESULT_OK)
     {
-        String operator_name = readbetween('"', '"');
-        (void)waitForOK();
-        return operator_name;
+        char *rb = readbetween('"', '"');
+        if (rb != NULL)
+        {
+            strncpy(identity.operator_name, rb, sizeof(identity.operator_name) - 1);
+            identity.operator_name[sizeof(identity.operator_name) - 1] = '\0';
+        }
+        if (waitForOK() && rb != NULL)
+        {
+            identity.valid |= IDENTITY_OPERATOR;
+            return identity.operator_name;
+        }
     }
     return "";
 }
@@ -306,13 +539,10 @@ String MC60::getOperatorName(void)
 /**************************************************************************/
 String MC60::getIMSI(void)
 {
-    if (sendCommandWait("AT+CIMI\r", "AT+CIMI\r\r\n", 300))
-    {
-        String IMSI = readline();
-        (void)waitForOK();
-        return IMSI;
-    }
-    return "";
+    if (!(identity.valid & IDENTITY_IMSI) &&
+        !readIdentityLine(&AT_IMSI, identity.IMSI, sizeof(identity.IMSI), IDENTITY_IMSI))
+        return "";
+    return identity.IMSI;
 }
 
 /**************************************************************************/
@@ -323,42 +553,32 @@ String MC60::getIMSI(void)
 /**************************************************************************/
 String MC60::getICCID(void)
 {
-    if (sendCommandWait("AT+QCCID\r", "AT+QCCID\r\r\n", 300))
-    {
-        String ICCID = readline();
-        (void)waitForOK();
-        return ICCID;
-    }
-    return "";
+    if (!(identity.valid & IDENTITY_ICCID) &&
+        !readIdentityLine(&AT_ICCID, identity.ICCID, sizeof(identity.ICCID), IDENTITY_ICCID))
+        return "";
+    return identity.ICCID;
 }
 
 /**************************************************************************/
 /*!
-    @brief Send SMS
+    @brief Send SMS. Messages longer than one SMS or with characters outside
+   ASCII are sent with sendSMSPDU().
     @param number Phone number to send SMS to
-    @param message Message to send
-    @returns True on successful send, False on failure
+    @param message Message to send, UTF-8
+    @returns True on successful send, False on failure (see getLastResult() and getLastErrorCode())
 */
 /**************************************************************************/
 bool MC60::sendSMS(const char *number, const char *message)
 {
+    if (SMS_PDU_Encoder::needsPDU(message))
+        return sendSMSPDU(number, message);
+
     if (!initializeSMS())
         return false;
 
-    char cmd[20];
-    sprintf(cmd, "AT+CMGS=\"%s\"\r", number);
+    int16_t reference;
 
-    if (sendCommandWait(cmd, "> ", 300))
-    {
-        write(message);
-        sendEndMarker();
-        (void)waitForResponse("+CMGS: ");
-        (void)waitForOK();
-    }
-    else
-        return false;
-
-    return true;
+    return submitSMS(number, message, SMS_SEND_TIMEOUT, &reference) == RESULT_OK;
 }
 
 /**************************************************************************/
@@ -400,7 +620,580 @@ bool MC60::sendSMS(String number, String message)
     return sendSMS(number.c_str(), message.c_str());
 }
 
-// TODO: Read NMEA/GGA parse and write to a struct
+/**************************************************************************/
+/*!
+    @brief Send several SMS back to back. AT+CMMS keeps the relay link to the
+   network up between them, so only the first message waits for it to be set
+   up, and each message is submitted as soon as the previous one is accepted.
+   Messages that sendSMS() would send with sendSMSPDU() go out in PDU mode on
+   the same link, their reference is the one of their last part.
+    @param messages Messages to send, reference and result are filled in
+    @param count Number of messages
+    @returns Number of messages sent
+*/
+/**************************************************************************/
+uint8_t MC60::sendSMSBatch(sms_message *messages, uint8_t count)
+{
+    uint8_t sent = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        messages[i].reference = -1;
+        messages[i].result = RESULT_PENDING;
+    }
+
+    if (count == 0 || !initializeSMS())
+        return 0;
+
+    bool keepLink = count > 1 && sendCommand(&AT_SMS_KEEP_LINK) == RESULT_OK;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (SMS_PDU_Encoder::needsPDU(messages[i].message))
+            messages[i].result = submitSMSPDU(messages[i].number, messages[i].message, keepLink, &messages[i].reference);
+        else
+            messages[i].result = submitSMS(messages[i].number, messages[i].message, SMS_SEND_TIMEOUT, &messages[i].reference);
+        if (messages[i].result == RESULT_OK)
+            sent++;
+    }
+
+    if (keepLink)
+        (void)sendCommand(&AT_SMS_RELEASE_LINK);
+
+    return sent;
+}
+
+/**************************************************************************/
+/*!
+    @brief Send SMS in PDU mode. The text is sent in GSM 7-bit when possible,
+   UCS2 otherwise, split into concatenated parts when it does not fit one SMS.
+   Each part is encoded straight from message into the serial port.
+    @param number Phone number to send SMS to, digits with an optional
+   leading '+'
+    @param message Message to send, UTF-8
+    @returns True if every part was sent, False on failure (see getLastResult()
+   and getLastErrorCode())
+*/
+/**************************************************************************/
+bool MC60::sendSMSPDU(const char *number, const char *message)
+{
+    int16_t reference;
+
+    if (!initializeSMS())
+        return false;
+
+    return submitSMSPDU(number, message, false, &reference) == RESULT_OK;
+}
+
+/**************************************************************************/
+/*!
+    @brief Submit one SMS in PDU mode, part by part, and go back to text mode
+    @param number Phone number to send SMS to, digits with an optional
+   leading '+'
+    @param message Message to send, UTF-8
+    @param linkKept True if the caller already keeps the relay link up with
+   AT+CMMS, so it is neither set up nor released here
+    @param reference Set to the message reference of the last part, -1 if none
+   was received
+    @returns Result of the first part that failed, RESULT_OK if all were sent
+*/
+/**************************************************************************/
+command_result MC60::submitSMSPDU(const char *number, const char *message, bool linkKept, int16_t *reference)
+{
+    SMS_PDU_Encoder pdu;
+    command_result result;
+
+    *reference = -1;
+
+    if (!pdu.begin(number, message, ++concatReference))
+    {
+        lastResult = RESULT_ERROR;
+        lastErrorCode = -1;
+        return RESULT_ERROR;
+    }
+
+    result = sendCommand(&AT_SMS_PDU_MODE);
+    if (result != RESULT_OK)
+        return result;
+
+    bool keepLink = !linkKept && pdu.getSegmentCount() > 1 && sendCommand(&AT_SMS_KEEP_LINK) == RESULT_OK;
+
+    while (result == RESULT_OK && pdu.nextSegment())
+    {
+        char length[4];
+        (void)formatNumber(length, pdu.getLength());
+
+        result = sendCommand(&AT_SMS_SUBMIT, length);
+        if (result == RESULT_OK)
+        {
+            pdu.write(*this);
+            sendEndMarker();
+            result = waitForResult_P(SMS_SUBMITTED, SMS_SEND_TIMEOUT);
+        }
+
+        if (result == RESULT_OK)
+            readSMSReference(reference);
+        else if (result == RESULT_TIMEOUT)
+            result = cancelSMS(reference);
+    }
+
+    int16_t errorCode = result == RESULT_OK ? -1 : lastErrorCode;
+
+    if (keepLink)
+        (void)sendCommand(&AT_SMS_RELEASE_LINK);
+    (void)sendCommand(&AT_SMS_TEXT_MODE); ///< Back to the text mode set by initializeSMS()
+
+    lastResult = result;
+    lastErrorCode = errorCode;
+    return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief Submit one SMS with AT+CMGS
+    @param number Phone number to send SMS to, at most SMS_NUMBER_LENGTH
+   characters
+    @param message Message to send
+    @param timeout How long to wait for +CMGS in milliseconds
+    @param reference Set to the message reference, -1 if none was received
+    @returns Result of the submission
+*/
+/**************************************************************************/
+command_result MC60::submitSMS(const char *number, const char *message, unsigned long timeout, int16_t *reference)
+{
+    char quoted[SMS_NUMBER_LENGTH + 3];
+    command_result result;
+
+    *reference = -1;
+
+    if (strlen(number) > SMS_NUMBER_LENGTH)
+    {
+        lastResult = RESULT_ERROR;
+        lastErrorCode = -1;
+        return RESULT_ERROR;
+    }
+
+    quoted[0] = '"';
+    strcpy(quoted + 1, number);
+    strcat(quoted, "\"");
+
+    result = sendCommand(&AT_SMS_SUBMIT, quoted);
+    if (result == RESULT_OK)
+    {
+        write(message);
+        sendEndMarker();
+        result = waitForResult_P(SMS_SUBMITTED, timeout);
+    }
+
+    if (result == RESULT_OK)
+        readSMSReference(reference);
+    else if (result == RESULT_TIMEOUT)
+        result = cancelSMS(reference);
+
+    return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief Read the message reference after "+CMGS: " and the OK after it
+    @param reference Set to the message reference, -1 if none was received,
+   may be NULL
+*/
+/**************************************************************************/
+void MC60::readSMSReference(int16_t *reference)
+{
+    char digits[6];
+
+    if (readline(digits, sizeof(digits)) > 0 && reference)
+        *reference = atoi(digits);
+    (void)waitForOK();
+}
+
+/**************************************************************************/
+/*!
+    @brief Clean up after the prompt or +CMGS of a submission timed out. ESC
+   ends text entry if the modem still waits for the message, its OK is read
+   here. If the message went out after all, its late +CMGS and OK are read
+   instead, so neither is taken for the result of the next command.
+    @param reference Set to the message reference if it was sent after all,
+   may be NULL
+    @returns RESULT_OK if the message was sent after all, RESULT_TIMEOUT
+   otherwise
+*/
+/**************************************************************************/
+command_result MC60::cancelSMS(int16_t *reference)
+{
+    if (sendCommand_P(SMS_ESCAPE, SMS_SUBMITTED) == RESULT_OK)
+    {
+        readSMSReference(reference);
+        return RESULT_OK;
+    }
+
+    lastResult = RESULT_TIMEOUT;
+    lastErrorCode = -1;
+    return RESULT_TIMEOUT;
+}
+
+/**************************************************************************/
+/*!
+    @brief Queue the index of a +CMTI URC, e.g. +CMTI: "SM",3
+    @param line Unsolicited line
+    @param context The MC60 that registered the handler
+*/
+/**************************************************************************/
+void MC60::onNewSMS(const char *line, void *context)
+{
+    MC60 *mc60 = static_cast<MC60 *>(context);
+    const char *comma = strrchr(line, ',');
+
+    if (comma == NULL)
+        return;
+
+    if (mc60->newSMSCount == SMS_NOTIFY_QUEUE) ///< Drop the oldest index, listSMS() still finds it
+    {
+        memmove(mc60->newSMS, mc60->newSMS + 1, (SMS_NOTIFY_QUEUE - 1) * sizeof(mc60->newSMS[0]));
+        mc60->newSMSCount--;
+    }
+
+    mc60->newSMS[mc60->newSMSCount++] = atoi(comma + 1);
+}
+
+/**************************************************************************/
+/*!
+    @brief Number of new messages reported by +CMTI and not taken with
+   getNewSMSIndex() yet. URCs are only seen while the MC60 is serviced, call
+   poll() when idle.
+    @returns Number of queued indexes
+*/
+/**************************************************************************/
+uint8_t MC60::newSMSAvailable(void) { return newSMSCount; }
+
+/**************************************************************************/
+/*!
+    @brief Take the oldest index reported by +CMTI
+    @returns Storage index for readSMS(), -1 if there is none
+*/
+/**************************************************************************/
+int16_t MC60::getNewSMSIndex(void)
+{
+    if (newSMSCount == 0)
+        return -1;
+
+    int16_t index = newSMS[0];
+    memmove(newSMS, newSMS + 1, --newSMSCount * sizeof(newSMS[0]));
+    return index;
+}
+
+/**************************************************************************/
+/*!
+    @brief Read one stored message with AT+CMGR. An unread message becomes read.
+    @param index Storage index, e.g. from getNewSMSIndex()
+    @param sms Filled with the message, text and size must point to the
+   caller's buffer
+    @returns True on successful read, False on failure or an empty index
+*/
+/**************************************************************************/
+bool MC60::readSMS(uint16_t index, sms_received &sms)
+{
+    if (!initializeSMS())
+        return false;
+
+    char argument[6];
+    (void)formatNumber(argument, index);
+
+    if (sendCommand(&AT_SMS_READ, argument) != RESULT_OK)
+        return false;
+
+    sms.index = index;
+    return readSMSResponse("+CMGR: ", sms, NULL, NULL) == 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief List the stored messages with one AT+CMGL. The response is parsed
+   as it arrives, every message is written into sms and handed to callback
+   before the next one overwrites it, so the inbox never has to fit in RAM.
+   Unread messages become read, so a full inbox can be drained with listSMS()
+   followed by deleteSMS(1, SMS_DELETE_READ). Listing SMS_ALL or
+   SMS_REC_UNREAD also clears the indexes queued by +CMTI.
+    @param sms Buffer for one message, text and size must point to the
+   caller's buffer
+    @param callback Called for each message
+    @param context Passed to callback (optional)
+    @param status Which messages to list (optional, default = SMS_ALL)
+    @returns Number of messages listed, check getLastResult() to tell an empty
+   list from a failure
+*/
+/**************************************************************************/
+uint16_t MC60::listSMS(sms_received &sms, sms_callback callback, void *context, sms_status status)
+{
+    static const char names[][sizeof("\"REC UNREAD\"")] PROGMEM = {"\"REC UNREAD\"", "\"REC READ\"", "\"STO UNSENT\"",
+                                                                 "\"STO SENT\"", "\"ALL\""};
+
+    if (!initializeSMS())
+        return 0;
+
+    char argument[sizeof(names[0])];
+    strcpy_P(argument, names[status]);
+
+    switch (sendCommand(&AT_SMS_LIST, argument))
+    {
+    case RESULT_OK:
+        break;
+    case RESULT_UNEXPECTED: ///< Plain OK, nothing stored
+        lastResult = RESULT_OK;
+        if (status == SMS_ALL || status == SMS_REC_UNREAD)
+            newSMSCount = 0;
+        return 0;
+    default:
+        return 0;
+    }
+
+    uint16_t count = readSMSResponse("+CMGL: ", sms, callback, context);
+    if (lastResult == RESULT_OK && (status == SMS_ALL || status == SMS_REC_UNREAD))
+        newSMSCount = 0;
+    return count;
+}
+
+/**************************************************************************/
+/*!
+    @brief Delete stored messages with AT+CMGD
+    @param index Storage index, ignored by the flags other than SMS_DELETE_INDEX
+    @param flag Which messages to delete (optional, default = SMS_DELETE_INDEX)
+    @returns True on success, False on failure
+*/
+/**************************************************************************/
+bool MC60::deleteSMS(uint16_t index, sms_delete_flag flag)
+{
+    if (!initializeSMS())
+        return false;
+
+    char argument[sizeof("65535,4")];
+    char *end = formatNumber(argument, index);
+    *end++ = ',';
+    (void)formatNumber(end, flag);
+
+    return sendCommand(flag == SMS_DELETE_INDEX ? &AT_SMS_DELETE : &AT_SMS_DELETE_ALL, argument) == RESULT_OK;
+}
+
+/**************************************************************************/
+/*!
+    @brief Store the characters of a message text, dropping what does not fit
+    @param sms Message being read
+    @param text Characters to store
+    @param length Number of characters
+*/
+/**************************************************************************/
+static void appendSMSText(sms_received &sms, const char *text, uint8_t length)
+{
+    while (length--)
+    {
+        if (sms.length + 1 < sms.size)
+            sms.text[sms.length++] = *text++;
+        else
+            sms.truncated = true;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Store one line of a message text after the line breaks that
+   preceded it, leading breaks are dropped
+    @param sms Message being read
+    @param line Characters of the line
+    @param length Number of characters
+    @param breaks Line breaks since the previous text
+*/
+/**************************************************************************/
+static void appendSMSLine(sms_received &sms, const char *line, uint8_t length, uint8_t breaks)
+{
+    if (sms.length)
+        while (breaks--)
+            appendSMSText(sms, "\n", 1);
+    appendSMSText(sms, line, length);
+}
+
+/**************************************************************************/
+/*!
+    @brief Terminate the text of a complete message and hand it over
+    @param sms Message that was read
+    @param callback Called with the message, may be NULL
+    @param context Passed to callback
+*/
+/**************************************************************************/
+static void deliverSMS(sms_received &sms, sms_callback callback, void *context)
+{
+    if (sms.size)
+        sms.text[sms.length] = '\0';
+    if (callback)
+        callback(sms, context);
+}
+
+/**************************************************************************/
+/*!
+    @brief Copy the next quoted field of a +CMGL or +CMGR header
+    @param p Where to start looking for the opening quote
+    @param dest Buffer for the field, may be NULL to skip it
+    @param length Size of dest
+    @returns Position after the closing quote
+*/
+/**************************************************************************/
+static const char *copyQuoted(const char *p, char *dest, uint8_t length)
+{
+    uint8_t idx = 0;
+
+    p = strchr(p, '"');
+    if (p != NULL)
+        for (p++; *p && *p != '"'; p++)
+            if (dest && idx < length - 1)
+                dest[idx++] = *p;
+
+    if (dest)
+        dest[idx] = '\0';
+    return p == NULL ? "" : *p ? p + 1 : p;
+}
+
+/**************************************************************************/
+/*!
+    @brief Parse the rest of a +CMGL or +CMGR response, whose first prefix
+   was matched by sendCommand(). Header lines are collected in a small buffer,
+   text lines are streamed into sms.text. A message ends at the next header,
+   or at the OK that follows an empty line. Unsolicited lines in between are
+   taken back out of the text.
+    @param prefix "+CMGL: " or "+CMGR: ", headers of +CMGL start with the index
+    @param sms Buffer for one message
+    @param callback Called for each complete message, may be NULL
+    @param context Passed to callback
+    @returns Number of complete messages
+*/
+/**************************************************************************/
+uint16_t MC60::readSMSResponse(const char *prefix, sms_received &sms, sms_callback callback, void *context)
+{
+    const uint8_t prefixLength = strlen(prefix);
+    const bool indexed = prefix[4] == 'L';
+    unsigned long startTime = millis();
+    char line[80];
+    uint8_t idx = 0;
+    bool header = true; ///< The prefix of the first header was already matched
+    bool streaming = false;
+    bool message = false;
+    bool blank = false;
+    uint8_t breaks = 0;
+    uint16_t count = 0;
+    uint16_t lineStart = 0;     ///< sms.length before the current line
+    bool lineTruncated = false; ///< sms.truncated before the current line
+    uint8_t lineBreaks = 0;     ///< breaks before the current line
+
+    lastResult = RESULT_TIMEOUT;
+
+    while (millis() - startTime < DEFAULT_TIMEOUT)
+    {
+        if (!available())
+            continue;
+
+        char c = read();
+        startTime = millis(); ///< A long listing keeps the timeout going while it arrives
+
+        if (c == '\r')
+            continue;
+
+        if (c != '\n')
+        {
+            if (streaming)
+                appendSMSText(sms, &c, 1);
+            else if (header || idx < prefixLength)
+            {
+                if (idx < sizeof(line) - 1)
+                    line[idx++] = c;
+            }
+
+            if (streaming || header || idx < prefixLength)
+                continue;
+
+            if (message && memcmp(line, prefix, prefixLength) == 0) ///< Next header, the last message is complete
+            {
+                deliverSMS(sms, callback, context);
+                count++;
+                message = false;
+                header = true;
+            }
+            else if (message) ///< Too long for a result code, so it is text
+            {
+                streaming = true;
+                appendSMSLine(sms, line, idx, breaks);
+                breaks = 0;
+            }
+            continue;
+        }
+
+        line[idx] = '\0';
+
+        if (wasUnsolicited()) ///< Went to its handler or queue, it is not part of the text
+        {
+            sms.length = lineStart;
+            sms.truncated = lineTruncated;
+            breaks = lineBreaks;
+            idx = 0;
+            streaming = false;
+            continue;
+        }
+
+        if (header)
+        {
+            const char *p = strncmp(line, prefix, prefixLength) == 0 ? line + prefixLength : line;
+
+            if (indexed)
+                sms.index = atoi(p);
+
+            char status[12];
+            p = copyQuoted(p, status, sizeof(status));
+            p = copyQuoted(p, sms.number, sizeof(sms.number));
+            p = copyQuoted(p, NULL, 0); ///< Phone book name
+            (void)copyQuoted(p, sms.timestamp, sizeof(sms.timestamp));
+
+            sms.status = strcmp(status, "REC UNREAD") == 0   ? SMS_REC_UNREAD
+                         : strcmp(status, "REC READ") == 0   ? SMS_REC_READ
+                         : strcmp(status, "STO UNSENT") == 0 ? SMS_STO_UNSENT
+                                                             : SMS_STO_SENT;
+            sms.length = 0;
+            sms.truncated = false;
+            message = true;
+            breaks = 0;
+        }
+        else if (!streaming && (blank || !message) && strcmp(line, "OK") == 0)
+        {
+            if (message)
+            {
+                deliverSMS(sms, callback, context);
+                count++;
+            }
+            lastResult = RESULT_OK;
+            return count;
+        }
+        else if (!streaming && !message && strstr(line, "ERROR") != NULL)
+        {
+            lastResult = RESULT_ERROR;
+            return count;
+        }
+        else if (!streaming && message && idx) ///< Text line shorter than the prefix
+        {
+            appendSMSLine(sms, line, idx, breaks);
+            breaks = 1;
+        }
+        else if (message)
+            breaks++;
+
+        blank = idx == 0;
+        idx = 0;
+        header = false;
+        streaming = false;
+        lineStart = sms.length;
+        lineTruncated = sms.truncated;
+        lineBreaks = breaks;
+    }
+
+    return count;
+}
 
 // > AT+QGNSSRD="NMEA/GGA"
 // +QGNSSRD: $GNGGA,000654.095,,,,,0,0,,,M,,M,,*5D
@@ -415,45 +1208,89 @@ bool MC60::sendSMS(String number, String message)
 */
 /**************************************************************************/
 bool MC60::readGPS(bool signedCoordinates)
+{
+    (void)signedCoordinates; ///< The fix always holds signed coordinates
+
+    if (!initializeGPS())
+        return false;
+
+    if (sendCommand(&AT_GNSS_GGA) != RESULT_OK)
+        return false;
+
+    return readNMEA();
+}
+
+/**************************************************************************/
+/*!
+    @brief Read every NMEA sentence of the current epoch with a single
+   AT+QGNSSRD? and parse them into one fix, so all fields come from the same
+   epoch. The previous fix is kept if the read fails.
+    @returns True on successful read, False on failure
+*/
+/**************************************************************************/
+bool MC60::readGNSS(void)
 {
     if (!initializeGPS())
         return false;
 
-    if (sendCommandWait("AT+QGNSSRD=\"NMEA/GGA\"\r", "+QGNSSRD: ", 300))
+    if (sendCommand(&AT_GNSS_EPOCH) != RESULT_OK)
+        return false;
+
+    gnss.clear();
+    return readNMEA();
+}
+
+/**************************************************************************/
+/*!
+    @brief Feed the sentences of a +QGNSSRD response to the parser byte by
+   byte until the final result, then publish the fix if the response was
+   complete and at least one sentence passed its checksum. Times out when
+   nothing arrives for DEFAULT_TIMEOUT.
+    @returns True on successful read, False on failure
+*/
+/**************************************************************************/
+bool MC60::readNMEA(void)
+{
+    uint16_t accepted = gnss.getStatistics().sentences;
+    unsigned long startTime = millis();
+    char result[8];
+    uint8_t idx = 0;
+    bool sentence = false;
+    bool ok = false;
+
+    while (!ok && millis() - startTime < DEFAULT_TIMEOUT)
     {
-        String ggaString = readline();
-        (void)waitForOK();
+        if (!available())
+            continue;
 
-        hour = getValue(ggaString, ',', 1).substring(0, 2).toInt();
-        minute = getValue(ggaString, ',', 1).substring(2, 4).toInt();
-        second = getValue(ggaString, ',', 1).substring(4, 6).toInt();
-        millisecond = getValue(ggaString, ',', 1).substring(7, 9).toInt();
-
-        double decimalDegreeMinuteLat = getValue(ggaString, ',', 2).toDouble();
-        latitude_direction = getValue(ggaString, ',', 3)[0];
-        latitude_degrees = decimalDegreeMinuteLat / 100;
-        latitude_degrees *= latitude_direction == 'N' ? 1 : -1;
-        latitude_minutes = (uint32_t)decimalDegreeMinuteLat % 100;
-        latitude_seconds = fmod(decimalDegreeMinuteLat, 1) * 60;
-
-        double decimalDegreeMinuteLon = getValue(ggaString, ',', 4).toDouble();
-        longitude_direction = getValue(ggaString, ',', 5)[0];
-        longitude_degrees = decimalDegreeMinuteLon / 100;
-        longitude_degrees *= longitude_direction == 'E' ? 1 : -1;
-        longitude_minutes = (uint32_t)decimalDegreeMinuteLon % 100;
-        longitude_seconds = fmod(decimalDegreeMinuteLon, 1) * 60;
-
-        fix_type = getValue(ggaString, ',', 6).toInt();
-        number_of_satellites = getValue(ggaString, ',', 7).toInt();
-        horizontal_dilution = getValue(ggaString, ',', 8).toFloat();
-        altitude = getValue(ggaString, ',', 9).toFloat();
-        geoidal_separation = getValue(ggaString, ',', 11).toFloat();
-        age_of_differential = getValue(ggaString, ',', 13).toInt();
-        differential_reference_station_id = getValue(ggaString, ',', 14).toInt();
+        char c = read();
+        startTime = millis(); ///< A full epoch takes longer than the timeout at low baud rates, keep it going while it arrives
+        (void)gnss.encode(c);
 
-        return true;
+        if (c == '\r' || c == '\n')
+        {
+            result[idx] = '\0';
+            ok = strcmp(result, "OK") == 0;
+            if (strstr(result, "ERROR") != NULL)
+                return false;
+            idx = 0;
+            sentence = false;
+        }
+        else if (idx == 0 && c == '$')
+            sentence = true;
+        else if (!sentence && idx < sizeof(result) - 1)
+            result[idx++] = c;
     }
-    return false;
+
+    if (!ok || gnss.getStatistics().sentences == accepted)
+        return false;
+
+    gnssFix = gnss.getFix();
+    gnssSatellites = gnss.getSatellites();
+#ifdef USE_FLOAT_GPS
+    updateFloatFields();
+#endif
+    return true;
 }
 
 /**************************************************************************/
@@ -464,8 +1301,84 @@ bool MC60::readGPS(bool signedCoordinates)
 /**************************************************************************/
 bool MC60::gpsFix()
 {
-    return (bool)fix_type;
+    return (bool)gnssFix.fix_type;
+}
+
+/**************************************************************************/
+/*!
+    @brief Get the last GPS fix in integer fixed-point
+    @returns Fix read by readGPS() or readGNSS()
+*/
+/**************************************************************************/
+const gnss_fix &MC60::getFix(void)
+{
+    return gnssFix;
+}
+
+/**************************************************************************/
+/*!
+    @brief Get the satellites in view, filled by readGNSS()
+    @returns Satellite table
+*/
+/**************************************************************************/
+const gnss_satellites &MC60::getSatellites(void)
+{
+    return gnssSatellites;
+}
+
+/**************************************************************************/
+/*!
+    @brief Get the counters of NMEA sentences accepted and rejected by
+   readGPS() and readGNSS()
+    @returns Sentence counters
+*/
+/**************************************************************************/
+const nmea_statistics &MC60::getNMEAStatistics(void)
+{
+    return gnss.getStatistics();
+}
+
+#ifdef USE_FLOAT_GPS
+/**************************************************************************/
+/*!
+    @brief Fill the floating point GPS fields from the fixed-point fix, for
+   sketches using the original fields. Define NO_FLOAT_GPS to leave them out.
+*/
+/**************************************************************************/
+void MC60::updateFloatFields(void)
+{
+    const gnss_fix &fix = gnssFix;
+    bool position = fix.flags & GNSS_HAS_POSITION;
+    uint32_t latitude = fix.latitude < 0 ? -fix.latitude : fix.latitude;
+    uint32_t longitude = fix.longitude < 0 ? -fix.longitude : fix.longitude;
+    uint32_t microMinutes;
+
+    hour = fix.hour;
+    minute = fix.minute;
+    second = fix.second;
+    millisecond = fix.centisecond;
+
+    microMinutes = (latitude % 10000000UL) * 6;
+    latitude_direction = position ? (fix.latitude < 0 ? 'S' : 'N') : '\0';
+    latitude_degrees = (latitude / 10000000UL) * (fix.latitude < 0 ? -1 : 1);
+    latitude_minutes = microMinutes / 1000000UL;
+    latitude_seconds = (microMinutes % 1000000UL) * 60 / 1e6;
+
+    microMinutes = (longitude % 10000000UL) * 6;
+    longitude_direction = position ? (fix.longitude < 0 ? 'W' : 'E') : '\0';
+    longitude_degrees = (longitude / 10000000UL) * (fix.longitude < 0 ? -1 : 1);
+    longitude_minutes = microMinutes / 1000000UL;
+    longitude_seconds = (microMinutes % 1000000UL) * 60 / 1e6;
+
+    fix_type = fix.fix_type;
+    number_of_satellites = fix.satellites;
+    horizontal_dilution = fix.hdop / 100.0f;
+    altitude = fix.altitude / 100.0f;
+    geoidal_separation = fix.geoidal_separation / 100.0f;
+    age_of_differential = fix.age_of_differential;
+    differential_reference_station_id = fix.differential_reference_station_id;
 }
+#endif
 
 /**************************************************************************/
 /*!
@@ -478,7 +1391,7 @@ String MC60::getGGASentence()
     if (!initializeGPS())
         return "";
 
-    if (sendCommandWait("AT+QGNSSRD=\"NMEA/GGA\"\r", "+QGNSSRD: ", 300))
+    if (sendCommand(&AT_GNSS_GGA) == RESULT_OK)
     {
         String ggaString = readline();
         (void)waitForOK();
@@ -487,31 +1400,3 @@ String MC60::getGGASentence()
     }
     return "";
 }
-
-/**************************************************************************/
-/*!
-    @brief Get value from string
-    @param data String to get value from
-    @param separator Separator character
-    @param index Index of value to get
-    @returns Value at index
-*/
-/**************************************************************************/
-String MC60::getValue(String data, char separator, int index)
-{
-    int found = 0;
-    int strIndex[] = {0, -1};
-    int maxIndex = data.length() - 1;
-
-    for (int i = 0; i <= maxIndex && found <= index; i++)
-    {
-        if (data.charAt(i) == separator || i == maxIndex)
-        {
-            found++;
-            strIndex[0] = strIndex[1] + 1;
-            strIndex[1] = (i == maxIndex) ? i + 1 : i;
-        }
-    }
-
-    return found > index ? data.substring(strIndex[0], strIndex[1]) : "";
-}
\ No newline at end of file
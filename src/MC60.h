@@ -2,6 +2,12 @@
 #define __MC60_H__
 
 #include "Serial_Command_Handler.h"
+#include "NMEA_Parser.h"
+#include "SMS_PDU.h"
+
+#ifndef NO_FLOAT_GPS
+#define USE_FLOAT_GPS
+#endif
 
 typedef enum
 {
@@ -14,6 +20,92 @@ typedef enum
     INVALID_CODE = 6
 } registation_codes;
 
+#ifndef SMS_NUMBER_LENGTH
+#define SMS_NUMBER_LENGTH 20 ///< longest phone number accepted by sendSMS
+#endif
+
+#ifndef SMS_SEND_TIMEOUT
+#define SMS_SEND_TIMEOUT 60000UL ///< how long sendSMS() and sendSMSBatch() wait for the network to accept each message
+#endif
+
+#ifndef SMS_NOTIFY_QUEUE
+#define SMS_NOTIFY_QUEUE 4 ///< how many +CMTI indexes are kept until getNewSMSIndex()
+#endif
+
+#define SMS_TIMESTAMP_LENGTH 21 ///< "yy/MM/dd,hh:mm:ss+zz" plus terminator
+
+#define IDENTITY_ATI 0x01      ///< manufacturer_ID, module and version are cached
+#define IDENTITY_IMSI 0x02     ///< IMSI is cached
+#define IDENTITY_ICCID 0x04    ///< ICCID is cached
+#define IDENTITY_OPERATOR 0x08 ///< operator_name is cached
+
+/**************************************************************************/
+/*!
+    @brief Cached module and SIM identity
+*/
+/**************************************************************************/
+typedef struct
+{
+    char manufacturer_ID[16]; ///< e.g. "Quectel_Ltd"
+    char module[16];          ///< e.g. "Quectel_MC60"
+    char version[24];         ///< Firmware revision
+    char IMSI[16];            ///< 15 digit IMSI
+    char ICCID[22];           ///< 19-20 digit ICCID
+    char operator_name[24];   ///< Operator reported by +COPS
+    uint8_t valid;            ///< IDENTITY_* flags of the fields that are cached
+} mc60_identity;
+
+/**************************************************************************/
+/*!
+    @brief One message of sendSMSBatch()
+*/
+/**************************************************************************/
+typedef struct
+{
+    const char *number;    ///< Phone number to send to
+    const char *message;   ///< Text to send, UTF-8
+    int16_t reference;     ///< Message reference from +CMGS, -1 if not sent
+    command_result result; ///< RESULT_OK once sent, RESULT_PENDING if not tried
+} sms_message;
+
+typedef enum
+{
+    SMS_REC_UNREAD = 0, ///< Received, not read yet
+    SMS_REC_READ = 1,   ///< Received and read
+    SMS_STO_UNSENT = 2, ///< Stored, not sent
+    SMS_STO_SENT = 3,   ///< Stored and sent
+    SMS_ALL = 4         ///< Any status, only for listSMS()
+} sms_status;
+
+typedef enum
+{
+    SMS_DELETE_INDEX = 0,            ///< Only the message at the index
+    SMS_DELETE_READ = 1,             ///< Every read message
+    SMS_DELETE_READ_SENT = 2,        ///< Every read and sent message
+    SMS_DELETE_READ_SENT_UNSENT = 3, ///< Every read, sent and unsent message
+    SMS_DELETE_ALL = 4               ///< Every message
+} sms_delete_flag;
+
+/**************************************************************************/
+/*!
+    @brief A stored SMS read by readSMS() or listSMS(). The text goes into a
+   buffer the caller provides.
+*/
+/**************************************************************************/
+typedef struct
+{
+    uint16_t index;                       ///< Storage index, for readSMS() and deleteSMS()
+    sms_status status;                    ///< Status before it was read
+    char number[SMS_NUMBER_LENGTH + 1];   ///< Sender, or recipient of a stored message
+    char timestamp[SMS_TIMESTAMP_LENGTH]; ///< Service centre time stamp, empty for stored messages
+    char *text;                           ///< Caller's buffer for the text
+    uint16_t size;                        ///< Size of text
+    uint16_t length;                      ///< Characters stored in text, without the terminator
+    bool truncated;                       ///< The text did not fit in size - 1 characters
+} sms_received;
+
+typedef void (*sms_callback)(const sms_received &sms, void *context); ///< Called by listSMS() for each message
+
 /**************************************************************************/
 /*!
     @brief The MC60 Class
@@ -31,12 +123,17 @@ public:
     MC60(SoftwareSerial *ser);
 #endif
     MC60(HardwareSerial *ser);
+    MC60(Stream *ser);
     MC60();
     ~MC60();
 
     bool powerUp(uint8_t pin);
     bool powerDown(bool urgent = false, uint8_t pin = 255);
 
+    bool refreshIdentity(void);
+    const mc60_identity &getIdentity(void);
+    void invalidateIdentity(uint8_t fields = 0xFF);
+
     String getManufacturerID(void);
     String getModule(void);
     String getVersion(void);
@@ -50,12 +147,25 @@ public:
     bool sendSMS(String number, const char *message);
     bool sendSMS(const char *number, String message);
     bool sendSMS(String number, String message);
+    uint8_t sendSMSBatch(sms_message *messages, uint8_t count);
+    bool sendSMSPDU(const char *number, const char *message);
+
+    uint8_t newSMSAvailable(void);
+    int16_t getNewSMSIndex(void);
+    bool readSMS(uint16_t index, sms_received &sms);
+    uint16_t listSMS(sms_received &sms, sms_callback callback, void *context = NULL, sms_status status = SMS_ALL);
+    bool deleteSMS(uint16_t index, sms_delete_flag flag = SMS_DELETE_INDEX);
 
     bool readGPS(bool signedCoordinates = false);
+    bool readGNSS(void);
     String getGGASentence();
 
     bool gpsFix();
+    const gnss_fix &getFix(void);
+    const gnss_satellites &getSatellites(void);
+    const nmea_statistics &getNMEAStatistics(void);
 
+#ifdef USE_FLOAT_GPS
     uint8_t hour; ///< Hour in 24-hour format
     uint8_t minute; ///< Minute
     uint8_t second; ///< Second
@@ -75,9 +185,33 @@ public:
     float geoidal_separation; ///< Geoidal separation in meters
     uint32_t age_of_differential; ///< Age of differential GPS data (seconds)
     uint32_t differential_reference_station_id; ///< Differential reference station ID
+#endif
 
 private:
-    String getValue(String data, char separator, int index);
+#ifdef USE_FLOAT_GPS
+    void updateFloatFields(void);
+#endif
+    void mc60_init(void);
+    bool readATI(void);
+    bool readIdentityLine(const at_command *cmd, char *dest, uint8_t length, uint8_t field);
+    static void onRegistrationChange(const char *line, void *context);
+    static void onNewSMS(const char *line, void *context);
+
+    bool readNMEA(void);
+    command_result submitSMS(const char *number, const char *message, unsigned long timeout, int16_t *reference);
+    command_result submitSMSPDU(const char *number, const char *message, bool linkKept, int16_t *reference);
+    void readSMSReference(int16_t *reference);
+    command_result cancelSMS(int16_t *reference);
+    uint16_t readSMSResponse(const char *prefix, sms_received &sms, sms_callback callback, void *context);
+
+    NMEA_Parser gnss;                       ///< Checks and parses the NMEA sentences
+    gnss_fix gnssFix = {};                  ///< Last GNSS fix in fixed-point
+    gnss_satellites gnssSatellites = {};    ///< Satellites of the last GNSS fix
+    mc60_identity identity;                 ///< Cached identity, see refreshIdentity()
+    uint8_t concatReference = 0;            ///< Reference of the last concatenated SMS
+    uint8_t lastRegistration = INVALID_CODE; ///< Last +CREG status, a change invalidates the operator
+    uint16_t newSMS[SMS_NOTIFY_QUEUE];      ///< Indexes reported by +CMTI, oldest first
+    uint8_t newSMSCount = 0;                ///< Indexes waiting in newSMS
 
     bool began = false;
     bool connected = false;
@@ -0,0 +1,459 @@
+#include "MC60_Fleet.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <poll.h>
+#endif
+
+#define STEP_SMS_MODE 0    ///< AT+CMGF=1, skipped once text mode is selected
+#define STEP_SMS_PROMPT 1  ///< AT+CMGS="<number>" up to the "> " prompt
+#define STEP_SMS_BODY 2    ///< Text and Ctrl-Z up to +CMGS
+#define STEP_GNSS_POWER 3  ///< AT+QGNSSC=1, skipped once GNSS is powered
+#define STEP_GNSS_READ 4   ///< AT+QGNSSRD="NMEA/GGA"
+#define STEP_STATUS_CREG 5 ///< AT+CREG?
+#define STEP_STATUS_CSQ 6  ///< AT+CSQ
+#define STEP_SMS_CANCEL 7  ///< ESC after a prompt or body timed out, up to its OK
+
+/**************************************************************************/
+/*!
+    @brief Register a modem. The fleet sends its commands with
+   queueCommand(), so the modem needs no other setup than its transport.
+    @param modem Modem to drive, must stay valid
+    @param fd Descriptor of its port for wait(), e.g. Posix_Serial::getFD()
+   (optional, default = -1 for none)
+    @returns Index of the modem, -1 if the fleet is full
+*/
+/**************************************************************************/
+int16_t MC60_Fleet::add(MC60 *modem, int fd)
+{
+    if (count == FLEET_MAX_MODEMS)
+        return -1;
+
+    fleet_modem &slot = modems[count];
+    memset(&slot, 0, sizeof(slot));
+    slot.fleet = this;
+    slot.modem = modem;
+    slot.fd = fd;
+    slot.index = count;
+    slot.work = FLEET_IDLE;
+    slot.lastWork = FLEET_STATUS; ///< The first search starts with SMS
+    slot.registration = INVALID_CODE;
+    slot.signal = 99;
+    slot.reference = -1;
+    slot.failure = RESULT_OK;
+
+    return count++;
+}
+
+/**************************************************************************/
+/*!
+    @brief Number of registered modems
+    @returns Modem count
+*/
+/**************************************************************************/
+uint8_t MC60_Fleet::getCount(void) { return count; }
+
+/**************************************************************************/
+/*!
+    @brief Set the function called whenever work finishes
+    @param callback Function to call, NULL for none
+    @param context Pointer passed to the callback (optional)
+*/
+/**************************************************************************/
+void MC60_Fleet::onComplete(fleet_callback callback, void *context)
+{
+    this->callback = callback;
+    this->context = context;
+}
+
+/**************************************************************************/
+/*!
+    @brief Queue an SMS on one modem. Only texts that fit one text mode SMS
+   are accepted, see SMS_PDU_Encoder::needsPDU().
+    @param modem Index returned by add()
+    @param number Phone number, must stay valid until the work finishes
+    @param message Text, must stay valid until the work finishes
+    @returns True if queued, False if the modem's queue is full or the SMS
+   is not accepted
+*/
+/**************************************************************************/
+bool MC60_Fleet::queueSMS(uint8_t modem, const char *number, const char *message)
+{
+    if (modem >= count || strlen(number) > SMS_NUMBER_LENGTH || SMS_PDU_Encoder::needsPDU(message))
+        return false;
+
+    fleet_modem &slot = modems[modem];
+    if (slot.smsCount == FLEET_SMS_QUEUE)
+        return false;
+
+    uint8_t idx = (slot.smsHead + slot.smsCount++) % FLEET_SMS_QUEUE;
+    slot.numbers[idx] = number;
+    slot.messages[idx] = message;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Ask for a GNSS fix. Requests made before the read starts are
+   served by the same read.
+    @param modem Index returned by add(), FLEET_ALL for every modem (optional)
+    @returns True on success, False for an unknown modem
+*/
+/**************************************************************************/
+bool MC60_Fleet::requestGNSS(uint8_t modem)
+{
+    if (modem != FLEET_ALL && modem >= count)
+        return false;
+
+    for (uint8_t i = 0; i < count; i++)
+        if (modem == FLEET_ALL || modem == i)
+            modems[i].gnssPending = true;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Ask for the registration status and signal quality. Requests made
+   before the read starts are served by the same read.
+    @param modem Index returned by add(), FLEET_ALL for every modem (optional)
+    @returns True on success, False for an unknown modem
+*/
+/**************************************************************************/
+bool MC60_Fleet::requestStatus(uint8_t modem)
+{
+    if (modem != FLEET_ALL && modem >= count)
+        return false;
+
+    for (uint8_t i = 0; i < count; i++)
+        if (modem == FLEET_ALL || modem == i)
+            modems[i].statusPending = true;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Start waiting work and handle the bytes that arrived on every
+   modem, call this often. The modem served first rotates on every call.
+*/
+/**************************************************************************/
+void MC60_Fleet::poll(void)
+{
+    for (uint8_t n = 0; n < count; n++)
+    {
+        fleet_modem &slot = modems[(first + n) % count];
+
+        schedule(slot);
+        slot.modem->poll();
+        schedule(slot);
+        slot.modem->poll(); ///< Sends the command queued by a completion in the first poll()
+    }
+
+    if (count)
+        first = (first + 1) % count;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+/**************************************************************************/
+/*!
+    @brief Sleep until a modem's port has something to read, so a gateway
+   loop does not spin. Modems added without a descriptor are only checked
+   once.
+    @param timeout Longest wait in milliseconds, keep it short compared to
+   the command timeouts
+    @returns True if something can be read, False on a timeout
+*/
+/**************************************************************************/
+bool MC60_Fleet::wait(int timeout)
+{
+    struct pollfd fds[FLEET_MAX_MODEMS];
+    nfds_t used = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (modems[i].modem->available()) ///< Already buffered bytes would not wake poll()
+            return true;
+        if (modems[i].fd >= 0)
+        {
+            fds[used].fd = modems[i].fd;
+            fds[used].events = POLLIN;
+            fds[used++].revents = 0;
+        }
+    }
+
+    return ::poll(fds, used, timeout) > 0;
+}
+#endif
+
+/**************************************************************************/
+/*!
+    @brief Check if every modem has finished its work
+    @returns True if nothing is running or waiting
+*/
+/**************************************************************************/
+bool MC60_Fleet::isIdle(void)
+{
+    for (uint8_t i = 0; i < count; i++)
+        if (modems[i].work != FLEET_IDLE || modems[i].smsCount || modems[i].gnssPending || modems[i].statusPending)
+            return false;
+
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Last fix read by requestGNSS()
+    @param modem Index returned by add()
+    @returns Fix, all zero if none was read
+*/
+/**************************************************************************/
+const gnss_fix &MC60_Fleet::getFix(uint8_t modem)
+{
+    static const gnss_fix none = {};
+    return modem < count ? modems[modem].fix : none;
+}
+
+/**************************************************************************/
+/*!
+    @brief Last registration status read by requestStatus()
+    @param modem Index returned by add()
+    @returns Status, INVALID_CODE if none was read
+*/
+/**************************************************************************/
+registation_codes MC60_Fleet::getRegistration(uint8_t modem)
+{
+    return modem < count ? (registation_codes)modems[modem].registration : INVALID_CODE;
+}
+
+/**************************************************************************/
+/*!
+    @brief Last signal quality read by requestStatus()
+    @param modem Index returned by add()
+    @returns +CSQ RSSI (0-31), 99 if unknown
+*/
+/**************************************************************************/
+uint8_t MC60_Fleet::getSignalQuality(uint8_t modem) { return modem < count ? modems[modem].signal : 99; }
+
+/**************************************************************************/
+/*!
+    @brief Message reference of the last SMS sent
+    @param modem Index returned by add()
+    @returns Reference, -1 if none
+*/
+/**************************************************************************/
+int16_t MC60_Fleet::getSMSReference(uint8_t modem) { return modem < count ? modems[modem].reference : -1; }
+
+/**************************************************************************/
+/*!
+    @brief Number of commands completed on all modems
+    @returns Command count
+*/
+/**************************************************************************/
+uint32_t MC60_Fleet::getCommandCount(void) { return commands; }
+
+/**************************************************************************/
+/*!
+    @brief Start the next waiting work of an idle modem, taking SMS, GNSS and
+   status in turn
+    @param slot Modem
+*/
+/**************************************************************************/
+void MC60_Fleet::schedule(fleet_modem &slot)
+{
+    if (slot.work != FLEET_IDLE)
+        return;
+
+    for (uint8_t i = 1; i <= FLEET_IDLE; i++)
+    {
+        fleet_work work = (fleet_work)((slot.lastWork + i) % FLEET_IDLE);
+
+        if ((work == FLEET_SMS && slot.smsCount) || (work == FLEET_GNSS && slot.gnssPending) ||
+            (work == FLEET_STATUS && slot.statusPending))
+        {
+            startWork(slot, work);
+            return;
+        }
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Queue the first command of a piece of work
+    @param slot Modem
+    @param work What to start
+*/
+/**************************************************************************/
+void MC60_Fleet::startWork(fleet_modem &slot, fleet_work work)
+{
+    slot.work = work;
+    slot.lastWork = work;
+
+    switch (work)
+    {
+    case FLEET_SMS:
+        slot.step = STEP_SMS_MODE;
+        if (slot.smsReady)
+            advance(slot, RESULT_OK);
+        else
+            queueStep(slot, "AT+CMGF=1\r", NULL, DEFAULT_TIMEOUT, false);
+        break;
+
+    case FLEET_GNSS:
+        slot.gnssPending = false;
+        slot.step = STEP_GNSS_POWER;
+        if (slot.gnssReady)
+            advance(slot, RESULT_OK);
+        else
+            queueStep(slot, "AT+QGNSSC=1\r", NULL, DEFAULT_TIMEOUT, false);
+        break;
+
+    default:
+        slot.statusPending = false;
+        slot.step = STEP_STATUS_CREG;
+        queueStep(slot, "AT+CREG?\r", "+CREG: ", DEFAULT_TIMEOUT, true);
+        break;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Move the running work on after a command completed
+    @param slot Modem
+    @param result Result of the command of slot.step
+*/
+/**************************************************************************/
+void MC60_Fleet::advance(fleet_modem &slot, command_result result)
+{
+    if (slot.step == STEP_SMS_CANCEL)
+    {
+        finish(slot, slot.failure);
+        return;
+    }
+
+    if (result != RESULT_OK)
+    {
+        bool sms = slot.step == STEP_SMS_PROMPT || slot.step == STEP_SMS_BODY;
+
+        if (sms && (result == RESULT_TIMEOUT || result == RESULT_UNEXPECTED))
+        {
+            slot.failure = result; ///< The modem may still be in text entry, wait for the OK of the ESC
+            slot.step = STEP_SMS_CANCEL;
+            queueStep(slot, "\x1B", NULL, DEFAULT_TIMEOUT, false);
+            return;
+        }
+
+        if (sms)
+            slot.modem->write((uint8_t)0x1B); ///< Ignored unless the modem is still in text entry
+        finish(slot, result);
+        return;
+    }
+
+    switch (slot.step)
+    {
+    case STEP_SMS_MODE:
+        slot.smsReady = true;
+        strcpy(slot.command, "AT+CMGS=\"");
+        strcat(slot.command, slot.numbers[slot.smsHead]);
+        strcat(slot.command, "\"\r");
+        slot.step = STEP_SMS_PROMPT;
+        queueStep(slot, slot.command, "> ", DEFAULT_TIMEOUT, false);
+        break;
+
+    case STEP_SMS_PROMPT:
+        slot.modem->write(slot.messages[slot.smsHead]);
+        slot.step = STEP_SMS_BODY;
+        queueStep(slot, "\x1A", "+CMGS: ", SMS_SEND_TIMEOUT, true);
+        break;
+
+    case STEP_SMS_BODY:
+        slot.reference = atoi(slot.capture);
+        finish(slot, RESULT_OK);
+        break;
+
+    case STEP_GNSS_POWER:
+        slot.gnssReady = true;
+        slot.step = STEP_GNSS_READ;
+        queueStep(slot, "AT+QGNSSRD=\"NMEA/GGA\"\r", "+QGNSSRD: ", DEFAULT_TIMEOUT, true);
+        break;
+
+    case STEP_GNSS_READ:
+        parser.clear();
+        if (!parser.parse(slot.capture))
+        {
+            finish(slot, RESULT_ERROR);
+            break;
+        }
+        slot.fix = parser.getFix();
+        finish(slot, RESULT_OK);
+        break;
+
+    case STEP_STATUS_CREG:
+    {
+        const char *comma = strchr(slot.capture, ',');
+        slot.registration = comma ? atoi(comma + 1) : INVALID_CODE;
+        slot.step = STEP_STATUS_CSQ;
+        queueStep(slot, "AT+CSQ\r", "+CSQ: ", DEFAULT_TIMEOUT, true);
+        break;
+    }
+
+    default:
+        slot.signal = atoi(slot.capture);
+        finish(slot, RESULT_OK);
+        break;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Queue one command of the running work on the modem
+    @param slot Modem
+    @param cmd Command, must stay valid until it completes
+    @param response Expected response, NULL for "OK"
+    @param timeout How long to wait in milliseconds
+    @param capture Keep the rest of the response line in slot.capture
+*/
+/**************************************************************************/
+void MC60_Fleet::queueStep(fleet_modem &slot, const char *cmd, const char *response, unsigned long timeout, bool capture)
+{
+    slot.capture[0] = '\0';
+
+    if (slot.modem->queueCommand(cmd, response, onCommand, &slot, timeout, capture ? slot.capture : NULL,
+                                 capture ? sizeof(slot.capture) : 0) == 0)
+        finish(slot, RESULT_ERROR); ///< Only if something else filled the modem's queue
+}
+
+/**************************************************************************/
+/*!
+    @brief End the running work and report it. A failed SMS is dropped, the
+   callback can queue it again.
+    @param slot Modem
+    @param result Result to report
+*/
+/**************************************************************************/
+void MC60_Fleet::finish(fleet_modem &slot, command_result result)
+{
+    fleet_work work = slot.work;
+
+    slot.work = FLEET_IDLE;
+    if (work == FLEET_SMS)
+    {
+        slot.smsHead = (slot.smsHead + 1) % FLEET_SMS_QUEUE;
+        slot.smsCount--;
+    }
+
+    if (callback)
+        callback(slot.index, work, result, context);
+}
+
+/**************************************************************************/
+/*!
+    @brief Completion of every command queued by the fleet
+    @param result Result of the command
+    @param context The fleet_modem that queued it
+*/
+/**************************************************************************/
+void MC60_Fleet::onCommand(command_result result, void *context)
+{
+    fleet_modem *slot = static_cast<fleet_modem *>(context);
+
+    slot->fleet->commands++;
+    slot->fleet->advance(*slot, result);
+}
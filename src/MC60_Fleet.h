@@ -0,0 +1,118 @@
+#ifndef __MC60_FLEET_H__
+#define __MC60_FLEET_H__
+
+#include "MC60.h"
+
+#ifndef FLEET_MAX_MODEMS
+#if defined(__unix__) || defined(__APPLE__)
+#define FLEET_MAX_MODEMS 64 ///< modems one MC60_Fleet can drive
+#elif defined(__AVR__)
+#define FLEET_MAX_MODEMS 2 ///< modems one MC60_Fleet can drive
+#else
+#define FLEET_MAX_MODEMS 4 ///< modems one MC60_Fleet can drive
+#endif
+#endif
+
+#ifndef FLEET_SMS_QUEUE
+#define FLEET_SMS_QUEUE 4 ///< SMS waiting per modem
+#endif
+
+#define FLEET_ALL 0xFF ///< every modem, for requestGNSS() and requestStatus()
+
+typedef enum
+{
+    FLEET_SMS = 0,    ///< Send one queued SMS
+    FLEET_GNSS = 1,   ///< Read the GGA sentence into the modem's fix
+    FLEET_STATUS = 2, ///< Read the network registration and signal quality
+    FLEET_IDLE = 3    ///< Nothing running
+} fleet_work;
+
+/**************************************************************************/
+/*!
+    @brief  Called when a piece of work finishes on one modem
+    @param modem Index returned by MC60_Fleet::add()
+    @param work What finished
+    @param result RESULT_OK on success, the failing command's result otherwise
+    @param context Pointer given to MC60_Fleet::onComplete()
+*/
+/**************************************************************************/
+typedef void (*fleet_callback)(uint8_t modem, fleet_work work, command_result result, void *context);
+
+/**************************************************************************/
+/*!
+    @brief  Drives many MC60 modems from one loop. Work is queued per modem
+   and run as chains of queued commands, so nothing blocks: poll() only
+   handles the bytes that already arrived on each port. Each modem runs one
+   piece of work at a time and takes SMS, GNSS and status work in turn, so
+   a long SMS queue cannot starve the position reports. The modems given to
+   add() must not be used with blocking calls while the fleet drives them.
+*/
+/**************************************************************************/
+class MC60_Fleet
+{
+public:
+    int16_t add(MC60 *modem, int fd = -1);
+    uint8_t getCount(void);
+    void onComplete(fleet_callback callback, void *context = NULL);
+
+    bool queueSMS(uint8_t modem, const char *number, const char *message);
+    bool requestGNSS(uint8_t modem = FLEET_ALL);
+    bool requestStatus(uint8_t modem = FLEET_ALL);
+
+    void poll(void);
+#if defined(__unix__) || defined(__APPLE__)
+    bool wait(int timeout);
+#endif
+    bool isIdle(void);
+
+    const gnss_fix &getFix(uint8_t modem);
+    registation_codes getRegistration(uint8_t modem);
+    uint8_t getSignalQuality(uint8_t modem);
+    int16_t getSMSReference(uint8_t modem);
+    uint32_t getCommandCount(void);
+
+private:
+    /// Work queue and command state machine of one modem
+    typedef struct
+    {
+        MC60_Fleet *fleet;                                           ///< Owner, for the command callbacks
+        MC60 *modem;                                                 ///< The modem
+        int fd;                                                      ///< Descriptor for wait(), -1 if unknown
+        uint8_t index;                                               ///< Position in modems
+        uint8_t step;                                                ///< Command of the running work, see the STEP_* values
+        fleet_work work;                                             ///< Running work, FLEET_IDLE if none
+        fleet_work lastWork;                                         ///< Last work started, the next search starts after it
+        bool smsReady;                                               ///< Text mode is selected
+        bool gnssReady;                                              ///< GNSS is powered
+        bool gnssPending;                                            ///< requestGNSS() is waiting
+        bool statusPending;                                          ///< requestStatus() is waiting
+        const char *numbers[FLEET_SMS_QUEUE];                        ///< Queued SMS recipients
+        const char *messages[FLEET_SMS_QUEUE];                       ///< Queued SMS texts
+        uint8_t smsHead;                                             ///< Oldest queued SMS
+        uint8_t smsCount;                                            ///< Queued SMS
+        char command[sizeof("AT+CMGS=\"\"\r") + SMS_NUMBER_LENGTH]; ///< Command being sent, must outlive it
+        char capture[NMEA_SENTENCE_LENGTH];                          ///< Rest of the response line
+        gnss_fix fix;                                                ///< Last fix read
+        uint8_t registration;                                        ///< Last +CREG status
+        uint8_t signal;                                              ///< Last +CSQ RSSI, 99 if unknown
+        int16_t reference;                                           ///< Message reference of the last SMS, -1 if none
+        command_result failure;                                      ///< Result reported once STEP_SMS_CANCEL is done
+    } fleet_modem;
+
+    void schedule(fleet_modem &slot);
+    void startWork(fleet_modem &slot, fleet_work work);
+    void advance(fleet_modem &slot, command_result result);
+    void queueStep(fleet_modem &slot, const char *cmd, const char *response, unsigned long timeout, bool capture);
+    void finish(fleet_modem &slot, command_result result);
+    static void onCommand(command_result result, void *context);
+
+    fleet_modem modems[FLEET_MAX_MODEMS]; ///< Registered modems
+    uint8_t count = 0;                    ///< Modems in use
+    uint8_t first = 0;                    ///< Modem poll() starts with, rotates every pass
+    NMEA_Parser parser;                   ///< Parses the GGA sentences of all modems
+    fleet_callback callback = NULL;       ///< Called when work finishes
+    void *context = NULL;                 ///< Passed to callback
+    uint32_t commands = 0;                ///< Commands completed on all modems
+};
+
+#endif
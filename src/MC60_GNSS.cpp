@@ -0,0 +1,131 @@
+#include "MC60_GNSS.h"
+
+/**************************************************************************/
+/*!
+    @brief Constructor when using SoftwareSerial
+    @param ser Pointer to SoftwareSerial device
+*/
+/**************************************************************************/
+#if (defined(__AVR__) || defined(ESP8266)) && defined(USE_SW_SERIAL)
+MC60_GNSS::MC60_GNSS(SoftwareSerial *ser) : Serial_Command_Handler(ser)
+{
+    memset(fixes, 0, sizeof(fixes));
+    memset(satellites, 0, sizeof(satellites));
+}
+#endif
+
+/**************************************************************************/
+/*!
+    @brief Constructor when using HardwareSerial
+    @param ser Pointer to a HardwareSerial object
+*/
+/**************************************************************************/
+MC60_GNSS::MC60_GNSS(HardwareSerial *ser) : Serial_Command_Handler(ser)
+{
+    memset(fixes, 0, sizeof(fixes));
+    memset(satellites, 0, sizeof(satellites));
+}
+
+/**************************************************************************/
+/*!
+    @brief Constructor for any other Stream
+    @param ser Pointer to a Stream object
+*/
+/**************************************************************************/
+MC60_GNSS::MC60_GNSS(Stream *ser) : Serial_Command_Handler(ser)
+{
+    memset(fixes, 0, sizeof(fixes));
+    memset(satellites, 0, sizeof(satellites));
+}
+
+MC60_GNSS::~MC60_GNSS() = default;
+
+/**************************************************************************/
+/*!
+    @brief Feed the received bytes to the parser and publish the epoch once
+   the burst of sentences is followed by GNSS_EPOCH_GAP ms of silence
+    @returns True if a new epoch was published
+*/
+/**************************************************************************/
+bool MC60_GNSS::update(void)
+{
+    while (available())
+    {
+        pending |= parser.encode(readByte());
+        lastByte = millis();
+    }
+
+    if (!pending || millis() - lastByte < GNSS_EPOCH_GAP)
+        return false;
+
+    publish();
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Set the function called from update() for each published epoch
+    @param callback Function to call, NULL to stop calling
+    @param context Passed to the callback (optional)
+*/
+/**************************************************************************/
+void MC60_GNSS::onFix(gnss_callback callback, void *context)
+{
+    this->callback = callback;
+    callbackContext = context;
+}
+
+/**************************************************************************/
+/*!
+    @brief Get the latest published fix. The reference stays valid and
+   unchanged until the epoch after the next one is published.
+    @returns Fix, check flags for the fields that are set
+*/
+/**************************************************************************/
+const gnss_fix &MC60_GNSS::getFix(void) { return fixes[front]; }
+
+/**************************************************************************/
+/*!
+    @brief Get the satellites of the latest published epoch
+    @returns Satellite table
+*/
+/**************************************************************************/
+const gnss_satellites &MC60_GNSS::getSatellites(void) { return satellites[front]; }
+
+/**************************************************************************/
+/*!
+    @brief Get how many epochs have been published, to tell when getFix()
+   changed
+    @returns Epochs published, wraps around
+*/
+/**************************************************************************/
+uint16_t MC60_GNSS::getEpochCount(void) { return epochCount; }
+
+/**************************************************************************/
+/*!
+    @brief Get the counters of accepted and rejected sentences
+    @returns Sentence counters
+*/
+/**************************************************************************/
+const nmea_statistics &MC60_GNSS::getStatistics(void) { return parser.getStatistics(); }
+
+/**************************************************************************/
+/*!
+    @brief Copy the epoch into the back buffer, make it the front one and
+   start the next epoch from scratch
+*/
+/**************************************************************************/
+void MC60_GNSS::publish(void)
+{
+    uint8_t back = front ^ 1;
+
+    fixes[back] = parser.getFix();
+    satellites[back] = parser.getSatellites();
+    front = back;
+    epochCount++;
+    pending = false;
+    parser.clear();
+
+    if (callback)
+        callback(fixes[back], satellites[back], callbackContext);
+}
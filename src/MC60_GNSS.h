@@ -0,0 +1,52 @@
+#ifndef __MC60_GNSS_H__
+#define __MC60_GNSS_H__
+
+#include "Serial_Command_Handler.h"
+#include "NMEA_Parser.h"
+
+#ifndef GNSS_EPOCH_GAP
+#define GNSS_EPOCH_GAP 50 ///< milliseconds of silence that end an NMEA burst
+#endif
+
+typedef void (*gnss_callback)(const gnss_fix &fix, const gnss_satellites &satellites, void *context);
+
+/**************************************************************************/
+/*!
+    @brief Reader for the NMEA stream the MC60 sends on its GNSS UART. It
+   needs no AT commands, so the command port stays free for SMS and data.
+   Call update() from loop() as often as possible.
+*/
+/**************************************************************************/
+class MC60_GNSS : public Serial_Command_Handler
+{
+public:
+#ifdef USE_SW_SERIAL
+    MC60_GNSS(SoftwareSerial *ser);
+#endif
+    MC60_GNSS(HardwareSerial *ser);
+    MC60_GNSS(Stream *ser);
+    ~MC60_GNSS();
+
+    bool update(void);
+    void onFix(gnss_callback callback, void *context = NULL);
+
+    const gnss_fix &getFix(void);
+    const gnss_satellites &getSatellites(void);
+    uint16_t getEpochCount(void);
+    const nmea_statistics &getStatistics(void);
+
+private:
+    void publish(void);
+
+    NMEA_Parser parser;                   ///< Builds the epoch being received
+    gnss_fix fixes[2];                    ///< Published fix and the one before it
+    gnss_satellites satellites[2];        ///< Satellites of fixes
+    volatile uint8_t front = 0;           ///< Index of the latest published epoch
+    uint16_t epochCount = 0;              ///< Epochs published
+    bool pending = false;                 ///< Sentences were accepted since the last publish
+    unsigned long lastByte = 0;           ///< When the last byte was read
+    gnss_callback callback = NULL;        ///< Called for each published epoch
+    void *callbackContext = NULL;         ///< Passed to callback
+};
+
+#endif
@@ -0,0 +1,1054 @@
+#include "MC60_Simulator.h"
+
+/// One epoch of MC60 NMEA output, as returned by AT+QGNSSRD?
+static const char defaultEpoch[] =
+    "$GNRMC,123519.000,A,4807.0380,N,01131.0000,E,0.13,309.62,130624,,,A*71\r\n"
+    "$GNVTG,309.62,T,,M,0.13,N,0.24,K,A*29\r\n"
+    "$GNGGA,123519.000,4807.0380,N,01131.0000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n"
+    "$GPGSA,A,3,04,05,09,12,24,,,,,,,,2.5,1.3,2.1*39\r\n"
+    "$GLGSA,A,3,65,66,,,,,,,,,,,2.5,1.3,2.1*2B\r\n"
+    "$GPGSV,2,1,06,04,77,045,42,05,38,293,40,09,21,061,35,12,45,210,44*77\r\n"
+    "$GPGSV,2,2,06,24,12,150,30,25,05,330,*7F\r\n"
+    "$GLGSV,1,1,02,65,33,100,38,66,50,200,41*6C\r\n"
+    "$GNGLL,4807.0380,N,01131.0000,E,123519.000,A,A*48";
+
+/// GGA sentence of defaultEpoch
+static const char defaultGGA[] = "$GNGGA,123519.000,4807.0380,N,01131.0000,E,1,08,0.9,545.4,M,46.9,M,,*47";
+
+#define SIM_CMUX_FLAG_BYTE 0xF9 ///< opens and closes every basic mode frame
+#define SIM_CMUX_EA 0x01        ///< extension bit, set in the last byte of a field
+#define SIM_CMUX_CR 0x02        ///< command/response bit
+#define SIM_CMUX_PF 0x10        ///< poll/final bit of the control field
+#define SIM_CMUX_SABM 0x2F      ///< set asynchronous balanced mode, opens a DLCI
+#define SIM_CMUX_UA 0x63        ///< unnumbered acknowledgement
+#define SIM_CMUX_DM 0x0F        ///< disconnected mode, DLCI refused
+#define SIM_CMUX_DISC 0x43      ///< disconnect
+#define SIM_CMUX_UIH 0xEF       ///< unnumbered information, FCS over the header only
+#define SIM_CMUX_CLD 0xC1       ///< multiplexer close down control message
+#define SIM_CMUX_FCS_GOOD 0xCF  ///< FCS register after a frame and its FCS were fed in
+
+/**************************************************************************/
+/*!
+    @brief Feed one byte to the 27.010 frame check sequence, bit by bit since
+   speed does not matter here
+    @param fcs Running FCS, start with 0xFF
+    @param c Byte to add
+    @return Updated FCS
+*/
+/**************************************************************************/
+static uint8_t cmuxFcsStep(uint8_t fcs, uint8_t c)
+{
+    fcs ^= c;
+    for (uint8_t i = 0; i < 8; i++)
+        fcs = fcs & 1 ? (fcs >> 1) ^ 0xE0 : fcs >> 1;
+    return fcs;
+}
+
+/**************************************************************************/
+/*!
+    @brief Constructor
+    @param baud Baud rate to throttle responses to, 0 for no limit (optional)
+*/
+/**************************************************************************/
+MC60_Simulator::MC60_Simulator(uint32_t baud) : baud(baud), ggaSentence(defaultGGA), nmeaEpoch(defaultEpoch)
+{
+    lastSMSText[0] = '\0';
+    memset(inbox, 0, sizeof(inbox));
+}
+
+/**************************************************************************/
+/*!
+    @brief How many response bytes can be read now - part of 'Stream'-class
+   functionality
+    @return Bytes available, 0 if none
+*/
+/**************************************************************************/
+int MC60_Simulator::available(void)
+{
+    return released();
+}
+
+/**************************************************************************/
+/*!
+    @brief Read one response byte - part of 'Stream'-class functionality
+    @return The byte, or -1 if nothing was available
+*/
+/**************************************************************************/
+int MC60_Simulator::read(void)
+{
+    if (released() == 0)
+        return -1;
+
+    uint8_t c = output[outputHead];
+    outputHead = (outputHead + 1) % SIM_OUTPUT_SIZE;
+    outputLength--;
+    outputConsumed++;
+    return c;
+}
+
+/**************************************************************************/
+/*!
+    @brief Look at the next response byte without reading it - part of
+   'Stream'-class functionality
+    @return The byte, or -1 if nothing was available
+*/
+/**************************************************************************/
+int MC60_Simulator::peek(void)
+{
+    return released() ? output[outputHead] : -1;
+}
+
+/**************************************************************************/
+/*!
+    @brief Receive one byte from the library - part of 'Print'-class functionality
+    @param c Byte sent to the modem
+    @return Bytes written, always 1
+*/
+/**************************************************************************/
+size_t MC60_Simulator::write(uint8_t c)
+{
+    if (poweredDown)
+        return 1;
+
+    if (cmuxMode)
+        cmuxDecode(c);
+    else
+        receive(c);
+    return 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief Act on one byte of AT commands or SMS text, from the UART or from
+   the information field of a CMUX frame
+    @param c Received byte
+*/
+/**************************************************************************/
+void MC60_Simulator::receive(uint8_t c)
+{
+    if (smsTextMode)
+    {
+        if (c == 26) ///< CTRL+Z sends
+            handleSMSText();
+        else if (c == 27) ///< ESC cancels
+        {
+            smsTextMode = false;
+            inputLength = 0;
+            replyOK();
+        }
+        else
+        {
+            replyChar(c);
+            if (inputLength < SIM_INPUT_SIZE - 1)
+                input[inputLength++] = c;
+        }
+        return;
+    }
+
+    if (echo)
+        replyChar(c);
+
+    if (c == '\r')
+    {
+        handleCommand();
+        interleaving = false;
+    }
+    else if (c != '\n' && c != 27 && inputLength < SIM_INPUT_SIZE - 1) ///< ESC outside text entry is ignored
+        input[inputLength++] = c;
+}
+
+/**************************************************************************/
+/*!
+    @brief Nothing to wait for, writes are handled immediately - part of
+   'Print'-class functionality
+*/
+/**************************************************************************/
+void MC60_Simulator::flush(void) {}
+
+/**************************************************************************/
+/*!
+    @brief Set how long the simulated modem takes before it starts answering
+    @param ms Latency in milliseconds
+*/
+/**************************************************************************/
+void MC60_Simulator::setLatency(unsigned long ms) { latency = ms; }
+
+/**************************************************************************/
+/*!
+    @brief Throttle responses to the speed of a UART
+    @param baud Baud rate, 0 for no limit
+*/
+/**************************************************************************/
+void MC60_Simulator::setBaud(uint32_t baud) { this->baud = baud; }
+
+/**************************************************************************/
+/*!
+    @brief Answer a share of the commands with ERROR
+    @param percent Percentage of commands, 0 to disable
+*/
+/**************************************************************************/
+void MC60_Simulator::setErrorRate(uint8_t percent) { errorRate = percent; }
+
+/**************************************************************************/
+/*!
+    @brief Leave a share of the commands unanswered
+    @param percent Percentage of commands, 0 to disable
+*/
+/**************************************************************************/
+void MC60_Simulator::setDropRate(uint8_t percent) { dropRate = percent; }
+
+/**************************************************************************/
+/*!
+    @brief Corrupt a share of the response bytes
+    @param perMille Bytes per thousand, 0 to disable
+*/
+/**************************************************************************/
+void MC60_Simulator::setCorruptionRate(uint16_t perMille) { corruptionRate = perMille; }
+
+/**************************************************************************/
+/*!
+    @brief Seed the fault injection, the same seed gives the same faults
+    @param seed Any non-zero value
+*/
+/**************************************************************************/
+void MC60_Simulator::setSeed(uint32_t seed) { this->seed = seed ? seed : 1; }
+
+/**************************************************************************/
+/*!
+    @brief Answer the next command starting with a prefix with a scripted reply
+    @param command Command prefix, e.g. "AT+CPIN?", must stay valid
+    @param reply Line to send instead, e.g. "+CME ERROR: 10", must stay valid
+*/
+/**************************************************************************/
+void MC60_Simulator::failNext(const char *command, const char *reply)
+{
+    failCommand = command;
+    failReply = reply;
+}
+
+/**************************************************************************/
+/*!
+    @brief Set the status reported by +CREG and +CGREG, a change is announced
+   with a +CREG URC after AT+CREG=1
+    @param status Registration status, see registation_codes
+*/
+/**************************************************************************/
+void MC60_Simulator::setRegistration(uint8_t status)
+{
+    if (status == registration)
+        return;
+
+    registration = status;
+    if (registrationURC)
+    {
+        reply("\r\n+CREG: ");
+        replyNumber(registration);
+        reply("\r\n");
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Set the name reported by +COPS
+    @param name Operator name, must stay valid
+*/
+/**************************************************************************/
+void MC60_Simulator::setOperatorName(const char *name) { operatorName = name; }
+
+/**************************************************************************/
+/*!
+    @brief Set the RSSI reported by +CSQ
+    @param rssi 0 to 31, 99 for unknown
+*/
+/**************************************************************************/
+void MC60_Simulator::setSignalQuality(uint8_t rssi) { signalQuality = rssi; }
+
+/**************************************************************************/
+/*!
+    @brief Set how long the network takes to set up the relay link for an
+   SMS. AT+CMMS keeps the link up, so only the first message of a burst pays.
+    @param ms Delay added to the +CMGS response in milliseconds
+*/
+/**************************************************************************/
+void MC60_Simulator::setSMSLinkSetup(unsigned long ms) { smsLinkSetup = ms; }
+
+/**************************************************************************/
+/*!
+    @brief Set the sentence reported by AT+QGNSSRD="NMEA/GGA"
+    @param sentence GGA sentence without line ending, must stay valid
+*/
+/**************************************************************************/
+void MC60_Simulator::setGGASentence(const char *sentence) { ggaSentence = sentence; }
+
+/**************************************************************************/
+/*!
+    @brief Set the sentences reported by AT+QGNSSRD?
+    @param sentences Sentences separated by "\r\n", without a trailing line
+   ending, must stay valid
+*/
+/**************************************************************************/
+void MC60_Simulator::setNMEAEpoch(const char *sentences) { nmeaEpoch = sentences; }
+
+/**************************************************************************/
+/*!
+    @brief Send the sentences set with setNMEAEpoch() as one burst, the way
+   the GNSS UART outputs them every second
+*/
+/**************************************************************************/
+void MC60_Simulator::streamNMEAEpoch(void)
+{
+    reply(nmeaEpoch);
+    reply("\r\n");
+}
+
+/**************************************************************************/
+/*!
+    @brief Send an unsolicited line, e.g. "+CMTI: \"SM\",1"
+    @param line Line without line ending
+*/
+/**************************************************************************/
+void MC60_Simulator::injectUnsolicited(const char *line)
+{
+    reply("\r\n");
+    reply(line);
+    reply("\r\n");
+}
+
+/**************************************************************************/
+/*!
+    @brief Send an unsolicited line in the middle of the response to the next
+   command starting with a prefix, right after the first line of the response
+    @param command Command prefix, e.g. "AT+CMGL", must stay valid
+    @param line Line to send, e.g. "RING", must stay valid
+*/
+/**************************************************************************/
+void MC60_Simulator::interleaveUnsolicited(const char *command, const char *line)
+{
+    interleaveCommand = command;
+    interleaveLine = line;
+}
+
+/**************************************************************************/
+/*!
+    @brief Store an incoming SMS in the first free slot and announce it with
+   +CMTI
+    @param number Sender
+    @param text Message text, up to 160 characters
+    @return True if stored, False if the inbox is full
+*/
+/**************************************************************************/
+bool MC60_Simulator::receiveSMS(const char *number, const char *text)
+{
+    for (uint8_t i = 0; i < SIM_INBOX_SIZE; i++)
+        if (!inbox[i].used)
+        {
+            inbox[i].used = true;
+            inbox[i].read = false;
+            strncpy(inbox[i].number, number, sizeof(inbox[i].number) - 1);
+            inbox[i].number[sizeof(inbox[i].number) - 1] = '\0';
+            strncpy(inbox[i].text, text, sizeof(inbox[i].text) - 1);
+            inbox[i].text[sizeof(inbox[i].text) - 1] = '\0';
+
+            reply("\r\n+CMTI: \"SM\",");
+            replyNumber(i + 1);
+            reply("\r\n");
+            return true;
+        }
+
+    return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief Replace the clock used for latency and baud rate throttling, use the
+   same one as the MC60 under test
+    @param source Clock to use, NULL for the Arduino millis()
+*/
+/**************************************************************************/
+void MC60_Simulator::setTimeSource(Time_Source *source)
+{
+    timeSource = source ? source : &ArduinoTime;
+}
+
+/**************************************************************************/
+/*!
+    @brief Set how many virtual channels the CMUX responder accepts, SABM on
+   a higher DLCI is answered with DM
+    @param count Highest DLCI accepted, 0 to 7
+*/
+/**************************************************************************/
+void MC60_Simulator::setCMUXChannels(uint8_t count) { cmuxChannels = count; }
+
+/**************************************************************************/
+/*!
+    @brief Send a UIH frame as the modem, e.g. one with a bad FCS or a longer
+   information field than the multiplexer accepts
+    @param dlci Channel
+    @param data Information field
+    @param length Bytes in data, up to 32767
+    @param badFCS Send a wrong frame check sequence (optional, default = false)
+*/
+/**************************************************************************/
+void MC60_Simulator::injectCMUXFrame(uint8_t dlci, const uint8_t *data, uint16_t length, bool badFCS)
+{
+    cmuxFlush();
+    cmuxSend(dlci, SIM_CMUX_UIH, data, length, false, badFCS);
+}
+
+/**************************************************************************/
+/*!
+    @brief Check if AT+QPOWD has been received
+    @return True if the simulated modem is off
+*/
+/**************************************************************************/
+bool MC60_Simulator::isPoweredDown(void) { return poweredDown; }
+
+/**************************************************************************/
+/*!
+    @brief Number of commands received so far
+    @return Command count
+*/
+/**************************************************************************/
+uint16_t MC60_Simulator::getCommandCount(void) { return commandCount; }
+
+/**************************************************************************/
+/*!
+    @brief Number of SMS sent so far
+    @return SMS count
+*/
+/**************************************************************************/
+uint16_t MC60_Simulator::getSentSMSCount(void) { return sentSMSCount; }
+
+/**************************************************************************/
+/*!
+    @brief Text of the last SMS sent
+    @return Null terminated text
+*/
+/**************************************************************************/
+const char *MC60_Simulator::getLastSMSText(void) { return lastSMSText; }
+
+/**************************************************************************/
+/*!
+    @brief Number of received SMS stored and not deleted
+    @return Stored SMS count
+*/
+/**************************************************************************/
+uint8_t MC60_Simulator::getStoredSMSCount(void)
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < SIM_INBOX_SIZE; i++)
+        count += inbox[i].used;
+    return count;
+}
+
+/**************************************************************************/
+/*!
+    @brief Answer the command line collected in input
+*/
+/**************************************************************************/
+void MC60_Simulator::handleCommand(void)
+{
+    input[inputLength] = '\0';
+    inputLength = 0;
+
+    if ((input[0] != 'A' && input[0] != 'a') || (input[1] != 'T' && input[1] != 't'))
+        return;
+
+    commandCount++;
+
+    if (interleaveCommand && strncmp(input, interleaveCommand, strlen(interleaveCommand)) == 0)
+    {
+        interleaveCommand = NULL;
+        interleaving = true;
+        interleaveText = false;
+    }
+
+    if (failCommand && strncmp(input, failCommand, strlen(failCommand)) == 0)
+    {
+        failCommand = NULL;
+        injectUnsolicited(failReply);
+        return;
+    }
+
+    if (chance(dropRate, 100))
+        return;
+
+    if (chance(errorRate, 100))
+    {
+        replyError();
+        return;
+    }
+
+    const char *cmd = input + 2;
+
+    if (strcmp(cmd, "+CMUX=0") == 0)
+    {
+        replyOK();
+        cmuxMode = true; ///< The OK is the last byte sent outside a frame
+        cmuxState = SIM_CMUX_FLAG;
+        cmuxDlci = 1;
+    }
+    else if (cmd[0] == '\0' || strncmp(cmd, "+IPR=", 5) == 0 || strncmp(cmd, "+IFC=", 5) == 0 ||
+        strncmp(cmd, "+CSCS=", 6) == 0)
+        replyOK();
+    else if (strcmp(cmd, "+CMGF=0") == 0 || strcmp(cmd, "+CMGF=1") == 0)
+    {
+        pduMode = cmd[6] == '0';
+        replyOK();
+    }
+    else if (strncmp(cmd, "+CMMS=", 6) == 0 && cmd[6] >= '0' && cmd[6] <= '2' && cmd[7] == '\0')
+    {
+        moreMessages = cmd[6] - '0';
+        smsLinkOpen = smsLinkOpen && moreMessages;
+        replyOK();
+    }
+    else if (strcmp(cmd, "+CMMS?") == 0)
+    {
+        reply("\r\n+CMMS: ");
+        replyNumber(moreMessages);
+        reply("\r\n");
+        replyOK();
+    }
+    else if (strcmp(cmd, "E0") == 0 || strcmp(cmd, "E1") == 0)
+    {
+        echo = cmd[1] == '1';
+        replyOK();
+    }
+    else if (strcmp(cmd, "I") == 0)
+    {
+        reply("\r\nQuectel_Ltd\r\nQuectel_MC60\r\nRevision: MC60CAR01A10\r\n");
+        replyOK();
+    }
+    else if (strcmp(cmd, "+CPIN?") == 0)
+        replyInfo("+CPIN: ", "READY");
+    else if (strcmp(cmd, "+CREG=0") == 0 || strcmp(cmd, "+CREG=1") == 0)
+    {
+        registrationURC = cmd[6] == '1';
+        replyOK();
+    }
+    else if (strcmp(cmd, "+CREG?") == 0 || strcmp(cmd, "+CGREG?") == 0)
+    {
+        reply(cmd[2] == 'G' ? "\r\n+CGREG: 0," : (registrationURC ? "\r\n+CREG: 1," : "\r\n+CREG: 0,"));
+        replyNumber(registration);
+        reply("\r\n");
+        replyOK();
+    }
+    else if (strcmp(cmd, "+COPS?") == 0)
+    {
+        reply("\r\n+COPS: 0,0,\"");
+        reply(operatorName);
+        reply("\"\r\n");
+        replyOK();
+    }
+    else if (strcmp(cmd, "+CSQ") == 0)
+    {
+        reply("\r\n+CSQ: ");
+        replyNumber(signalQuality);
+        reply(",0\r\n");
+        replyOK();
+    }
+    else if (strcmp(cmd, "+CIMI") == 0)
+        replyInfo("", "286010000000001");
+    else if (strcmp(cmd, "+QCCID") == 0)
+        replyInfo("", "89900100000000000017");
+    else if (strncmp(cmd, "+CMGS=", 6) == 0)
+    {
+        pduLength = atoi(cmd + 6);
+        smsTextMode = true;
+        reply("\r\n> ");
+    }
+    else if (strncmp(cmd, "+CMGL=\"", 7) == 0 && !pduMode)
+    {
+        const char *status = cmd + 7;
+        bool all = strcmp(status, "ALL\"") == 0;
+        bool unread = strcmp(status, "REC UNREAD\"") == 0;
+        bool read = strcmp(status, "REC READ\"") == 0;
+        bool listed = false;
+
+        for (uint8_t i = 0; i < SIM_INBOX_SIZE; i++)
+            if (inbox[i].used && (all || (unread && !inbox[i].read) || (read && inbox[i].read)))
+            {
+                if (!listed)
+                    reply("\r\n");
+                replySMS(i, "+CMGL: ");
+                listed = true;
+            }
+        replyOK();
+    }
+    else if (strncmp(cmd, "+CMGR=", 6) == 0 && !pduMode)
+    {
+        uint16_t index = atoi(cmd + 6);
+
+        if (index < 1 || index > SIM_INBOX_SIZE)
+            reply("\r\n+CMS ERROR: 321\r\n");
+        else
+        {
+            if (inbox[index - 1].used)
+            {
+                reply("\r\n");
+                replySMS(index - 1, "+CMGR: ");
+            }
+            replyOK();
+        }
+    }
+    else if (strncmp(cmd, "+CMGD=", 6) == 0)
+    {
+        uint16_t index = atoi(cmd + 6);
+        const char *comma = strchr(cmd, ',');
+        uint8_t flag = comma ? atoi(comma + 1) : 0;
+
+        if (flag > 4 || (flag == 0 && (index < 1 || index > SIM_INBOX_SIZE)))
+            reply("\r\n+CMS ERROR: 321\r\n");
+        else
+        {
+            for (uint8_t i = 0; i < SIM_INBOX_SIZE; i++)
+                if (flag == 0 ? i == index - 1 : (flag == 4 || inbox[i].read))
+                    inbox[i].used = false;
+            replyOK();
+        }
+    }
+    else if (strcmp(cmd, "+QGNSSC?") == 0)
+        replyInfo("+QGNSSC: ", gnssOn ? "1" : "0");
+    else if (strncmp(cmd, "+QGNSSC=", 8) == 0)
+    {
+        gnssOn = cmd[8] == '1';
+        replyOK();
+    }
+    else if (strcmp(cmd, "+QGNSSRD=\"NMEA/GGA\"") == 0)
+    {
+        if (gnssOn)
+            replyInfo("+QGNSSRD: ", ggaSentence);
+        else
+            replyError();
+    }
+    else if (strcmp(cmd, "+QGNSSRD?") == 0)
+    {
+        if (gnssOn)
+            replyInfo("+QGNSSRD: ", nmeaEpoch);
+        else
+            replyError();
+    }
+    else if (strcmp(cmd, "+QPOWD=0") == 0)
+    {
+        replyOK();
+        poweredDown = true;
+    }
+    else if (strcmp(cmd, "+QPOWD=1") == 0)
+    {
+        reply("\r\nNORMAL POWER DOWN\r\n");
+        poweredDown = true;
+    }
+    else
+        replyError();
+}
+
+/**************************************************************************/
+/*!
+    @brief Accept the SMS text collected in input
+*/
+/**************************************************************************/
+void MC60_Simulator::handleSMSText(void)
+{
+    input[inputLength] = '\0';
+    strcpy(lastSMSText, input);
+    inputLength = 0;
+    smsTextMode = false;
+
+    if (pduMode) ///< The hex PDU must hold the SMSC field plus the announced TPDU length
+    {
+        uint16_t length = strlen(lastSMSText);
+        uint8_t smsc = 0;
+        bool valid = length >= 2 && length % 2 == 0;
+
+        for (uint16_t i = 0; valid && i < length; i++)
+            valid = isxdigit(lastSMSText[i]);
+        if (valid)
+        {
+            char octet[3] = {lastSMSText[0], lastSMSText[1], '\0'};
+            smsc = strtoul(octet, NULL, 16);
+            valid = length / 2 == 1 + smsc + pduLength;
+        }
+        if (!valid)
+        {
+            reply("\r\n+CMS ERROR: 304\r\n");
+            return;
+        }
+    }
+
+    sentSMSCount++;
+
+    if (moreMessages == 1 && millis() - lastSMSAt > 5000) ///< AT+CMMS=1 lapses after 5 s without a message
+        moreMessages = 0;
+    bool linkOpen = smsLinkOpen && moreMessages;
+
+    reply("\r\n+CMGS: ");
+    replyNumber(++smsReference);
+    reply("\r\n");
+    replyOK();
+
+    if (!linkOpen)
+    {
+        cmuxFlush(); ///< The delay applies to the frame carrying the reply
+        outputReadyAt += smsLinkSetup;
+    }
+    smsLinkOpen = moreMessages != 0;
+    lastSMSAt = millis();
+}
+
+/**************************************************************************/
+/*!
+    @brief Queue a stored SMS as a +CMGL or +CMGR entry and mark it read
+    @param slot Index in inbox
+    @param prefix "+CMGL: " or "+CMGR: ", +CMGL entries start with the index
+*/
+/**************************************************************************/
+void MC60_Simulator::replySMS(uint8_t slot, const char *prefix)
+{
+    reply(prefix);
+    if (prefix[4] == 'L')
+    {
+        replyNumber(slot + 1);
+        reply(",");
+    }
+    reply(inbox[slot].read ? "\"REC READ\",\"" : "\"REC UNREAD\",\"");
+    reply(inbox[slot].number);
+    reply("\",\"\",\"24/06/13,12:35:19+12\"\r\n");
+    reply(inbox[slot].text);
+    reply("\r\n");
+    inbox[slot].read = true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Queue response bytes
+    @param text Null terminated bytes to send
+*/
+/**************************************************************************/
+void MC60_Simulator::reply(const char *text)
+{
+    while (*text)
+        replyChar(*text++);
+}
+
+/**************************************************************************/
+/*!
+    @brief Queue one response byte, collecting it for the next frame in CMUX
+   mode
+    @param c Byte to send
+*/
+/**************************************************************************/
+void MC60_Simulator::replyChar(char c)
+{
+    if (interleaving && c == '\n' && interleaveText)
+    {
+        interleaving = false;
+        replyChar(c);
+        reply(interleaveLine);
+        reply("\r\n");
+        return;
+    }
+    if (c != '\r' && c != '\n')
+        interleaveText = true;
+
+    if (!cmuxMode)
+    {
+        queueByte(c);
+        return;
+    }
+
+    cmuxReply[cmuxReplyLength++] = c;
+    if (cmuxReplyLength == sizeof(cmuxReply))
+        cmuxFlush();
+}
+
+/**************************************************************************/
+/*!
+    @brief Queue one byte on the UART, corrupting it if requested
+    @param c Byte to send
+*/
+/**************************************************************************/
+void MC60_Simulator::queueByte(uint8_t c)
+{
+    if (outputLength == 0)
+    {
+        outputReadyAt = millis() + latency;
+        outputConsumed = 0;
+    }
+
+    if (outputLength >= SIM_OUTPUT_SIZE)
+        return;
+
+    if (chance(corruptionRate, 1000))
+        c ^= 0x20;
+    output[(outputHead + outputLength++) % SIM_OUTPUT_SIZE] = c;
+}
+
+/**************************************************************************/
+/*!
+    @brief Queue an information response followed by OK
+    @param prefix Response prefix, e.g. "+CPIN: "
+    @param value Response value
+*/
+/**************************************************************************/
+void MC60_Simulator::replyInfo(const char *prefix, const char *value)
+{
+    reply("\r\n");
+    reply(prefix);
+    reply(value);
+    reply("\r\n");
+    replyOK();
+}
+
+/**************************************************************************/
+/*!
+    @brief Queue a decimal number
+    @param value Number to send
+*/
+/**************************************************************************/
+void MC60_Simulator::replyNumber(uint32_t value)
+{
+    char digits[11];
+    uint8_t i = sizeof(digits) - 1;
+
+    digits[i] = '\0';
+    do
+    {
+        digits[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    reply(digits + i);
+}
+
+/**************************************************************************/
+/*!
+    @brief Queue the OK final result
+*/
+/**************************************************************************/
+void MC60_Simulator::replyOK(void) { reply("\r\nOK\r\n"); }
+
+/**************************************************************************/
+/*!
+    @brief Queue the ERROR final result
+*/
+/**************************************************************************/
+void MC60_Simulator::replyError(void) { reply("\r\nERROR\r\n"); }
+
+/**************************************************************************/
+/*!
+    @brief Decide whether to inject a fault
+    @param rate How often, 0 for never
+    @param scale What rate is out of, e.g. 100 for percent
+    @return True if the fault should happen
+*/
+/**************************************************************************/
+bool MC60_Simulator::chance(uint16_t rate, uint16_t scale)
+{
+    return rate && nextRandom() % scale < rate;
+}
+
+/**************************************************************************/
+/*!
+    @brief Small deterministic pseudo random generator for fault injection
+    @return Pseudo random 16 bit value
+*/
+/**************************************************************************/
+uint32_t MC60_Simulator::nextRandom(void)
+{
+    seed = seed * 1103515245UL + 12345UL;
+    return (seed >> 16) & 0x7FFF;
+}
+
+/**************************************************************************/
+/*!
+    @brief How many response bytes the latency and baud rate let through now
+    @return Readable bytes
+*/
+/**************************************************************************/
+int MC60_Simulator::released(void)
+{
+    cmuxFlush();
+    if (outputLength == 0)
+        return 0;
+
+    unsigned long elapsed = millis() - outputReadyAt;
+    if ((long)elapsed < 0)
+        return 0;
+
+    if (baud == 0)
+        return outputLength;
+
+    if (elapsed > 60000UL)
+        elapsed = 60000UL;
+
+    uint32_t allowed = 1 + elapsed * (baud / 10) / 1000;
+    if (allowed <= outputConsumed)
+        return 0;
+
+    return allowed - outputConsumed < outputLength ? allowed - outputConsumed : outputLength;
+}
+
+/**************************************************************************/
+/*!
+    @brief Current time from the configured clock
+    @return Milliseconds since start
+*/
+/**************************************************************************/
+unsigned long MC60_Simulator::millis(void) { return timeSource->millis(); }
+
+/**************************************************************************/
+/*!
+    @brief Check if the simulated modem is in CMUX mode
+    @return True between AT+CMUX=0 and the close down of the multiplexer
+*/
+/**************************************************************************/
+bool MC60_Simulator::isMultiplexed(void) { return cmuxMode; }
+
+/**************************************************************************/
+/*!
+    @brief Feed one received byte to the basic mode frame decoder, frames
+   with a bad FCS or closing flag are ignored
+    @param c Received byte
+*/
+/**************************************************************************/
+void MC60_Simulator::cmuxDecode(uint8_t c)
+{
+    switch (cmuxState)
+    {
+    case SIM_CMUX_FLAG:
+        if (c == SIM_CMUX_FLAG_BYTE)
+            cmuxState = SIM_CMUX_ADDRESS;
+        break;
+    case SIM_CMUX_ADDRESS:
+        if (c == SIM_CMUX_FLAG_BYTE)
+            break;
+        cmuxAddress = c;
+        cmuxFcs = cmuxFcsStep(0xFF, c);
+        cmuxState = SIM_CMUX_CONTROL;
+        break;
+    case SIM_CMUX_CONTROL:
+        cmuxControl = c;
+        cmuxFcs = cmuxFcsStep(cmuxFcs, c);
+        cmuxState = SIM_CMUX_LENGTH;
+        break;
+    case SIM_CMUX_LENGTH:
+        cmuxFcs = cmuxFcsStep(cmuxFcs, c);
+        cmuxLength = c >> 1;
+        cmuxIdx = 0;
+        if (!(c & SIM_CMUX_EA)) ///< Longer than N1, the sender is broken
+            cmuxState = SIM_CMUX_FLAG;
+        else
+            cmuxState = cmuxLength ? SIM_CMUX_DATA : SIM_CMUX_FCS;
+        break;
+    case SIM_CMUX_DATA:
+        cmuxFrame[cmuxIdx++] = c;
+        if (cmuxIdx == cmuxLength)
+            cmuxState = SIM_CMUX_FCS;
+        break;
+    case SIM_CMUX_FCS:
+        cmuxFcs = cmuxFcsStep(cmuxFcs, c);
+        cmuxState = SIM_CMUX_CLOSE;
+        break;
+    case SIM_CMUX_CLOSE:
+        cmuxState = SIM_CMUX_ADDRESS;
+        if (c != SIM_CMUX_FLAG_BYTE || cmuxFcs != SIM_CMUX_FCS_GOOD)
+            cmuxState = SIM_CMUX_FLAG;
+        else
+            cmuxHandleFrame();
+        break;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Answer a checked frame from the multiplexer
+*/
+/**************************************************************************/
+void MC60_Simulator::cmuxHandleFrame(void)
+{
+    uint8_t dlci = cmuxAddress >> 2;
+
+    switch (cmuxControl & ~SIM_CMUX_PF)
+    {
+    case SIM_CMUX_SABM:
+        cmuxFlush();
+        cmuxSend(dlci, (dlci <= cmuxChannels ? SIM_CMUX_UA : SIM_CMUX_DM) | SIM_CMUX_PF, NULL, 0, true);
+        break;
+    case SIM_CMUX_DISC:
+        cmuxFlush();
+        cmuxSend(dlci, SIM_CMUX_UA | SIM_CMUX_PF, NULL, 0, true);
+        if (dlci == 0)
+            cmuxMode = false;
+        break;
+    case SIM_CMUX_UIH:
+        if (dlci == 0) ///< Control message, acknowledged by sending it back as a response
+        {
+            if (cmuxLength < 2 || !(cmuxFrame[0] & SIM_CMUX_CR))
+                break;
+            cmuxFlush();
+            cmuxFrame[0] &= ~SIM_CMUX_CR;
+            cmuxSend(0, SIM_CMUX_UIH, cmuxFrame, cmuxLength);
+            if (cmuxFrame[0] == SIM_CMUX_CLD)
+                cmuxMode = false;
+            break;
+        }
+        if (dlci != cmuxDlci)
+            cmuxFlush();
+        cmuxDlci = dlci;
+        for (uint8_t i = 0; i < cmuxLength; i++)
+            receive(cmuxFrame[i]);
+        break;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Queue one basic mode frame on the UART
+    @param dlci Channel
+    @param control Control field
+    @param data Information field, may be NULL if length is 0
+    @param length Bytes in data, a two byte length field is used above 127
+    @param response Set to true when answering a command from the
+   multiplexer (optional, default = false)
+    @param badFCS Send a wrong frame check sequence (optional, default = false)
+*/
+/**************************************************************************/
+void MC60_Simulator::cmuxSend(uint8_t dlci, uint8_t control, const uint8_t *data, uint16_t length, bool response,
+                              bool badFCS)
+{
+    uint8_t header[4] = {(uint8_t)((dlci << 2) | (response ? SIM_CMUX_CR : 0) | SIM_CMUX_EA), control,
+                         (uint8_t)(length << 1), (uint8_t)(length >> 7)}; ///< The multiplexer is the initiator
+    uint8_t headerLength = 4;
+    uint8_t fcs = 0xFF;
+
+    if (length <= 127)
+    {
+        header[2] |= SIM_CMUX_EA;
+        headerLength = 3;
+    }
+
+    queueByte(SIM_CMUX_FLAG_BYTE);
+    for (uint8_t i = 0; i < headerLength; i++)
+    {
+        queueByte(header[i]);
+        fcs = cmuxFcsStep(fcs, header[i]);
+    }
+    for (uint16_t i = 0; i < length; i++)
+        queueByte(data[i]);
+    queueByte((0xFF - fcs) ^ (badFCS ? 0x55 : 0));
+    queueByte(SIM_CMUX_FLAG_BYTE);
+}
+
+/**************************************************************************/
+/*!
+    @brief Send the reply bytes collected in CMUX mode as one UIH frame
+*/
+/**************************************************************************/
+void MC60_Simulator::cmuxFlush(void)
+{
+    if (cmuxReplyLength == 0)
+        return;
+
+    cmuxSend(cmuxDlci, SIM_CMUX_UIH, cmuxReply, cmuxReplyLength);
+    cmuxReplyLength = 0;
+}
@@ -0,0 +1,175 @@
+#ifndef __MC60_SIMULATOR_H__
+#define __MC60_SIMULATOR_H__
+
+#include <Arduino.h>
+#include "Time_Source.h"
+
+#ifndef SIM_INPUT_SIZE
+#define SIM_INPUT_SIZE 400 ///< longest command, SMS text or hex PDU the simulator accepts
+#endif
+
+#ifndef SIM_OUTPUT_SIZE
+#define SIM_OUTPUT_SIZE 2048 ///< how many response bytes can be waiting to be read
+#endif
+
+#ifndef SIM_CMUX_FRAME_SIZE
+#define SIM_CMUX_FRAME_SIZE 127 ///< longest information field of a CMUX frame, N1 of AT+CMUX
+#endif
+
+#ifndef SIM_INBOX_SIZE
+#define SIM_INBOX_SIZE 10 ///< how many received SMS the simulated SIM stores
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  In-process MC60 that answers the AT commands used by this library,
+   for running the library without a modem. Pass it to the MC60(Stream *)
+   constructor. After AT+CMUX=0 it answers as a 27.010 basic mode responder,
+   all DLCIs share one command interpreter and replies go to the DLCI the last
+   command came on.
+*/
+/**************************************************************************/
+class MC60_Simulator : public Stream
+{
+public:
+    MC60_Simulator(uint32_t baud = 0);
+
+    int available(void);
+    int read(void);
+    int peek(void);
+    size_t write(uint8_t c);
+    using Print::write;
+    void flush(void);
+
+    void setLatency(unsigned long ms);
+    void setBaud(uint32_t baud);
+    void setErrorRate(uint8_t percent);
+    void setDropRate(uint8_t percent);
+    void setCorruptionRate(uint16_t perMille);
+    void setSeed(uint32_t seed);
+    void failNext(const char *command, const char *reply);
+
+    void setRegistration(uint8_t status);
+    void setOperatorName(const char *name);
+    void setSignalQuality(uint8_t rssi);
+    void setSMSLinkSetup(unsigned long ms);
+    void setGGASentence(const char *sentence);
+    void setNMEAEpoch(const char *sentences);
+    void streamNMEAEpoch(void);
+    void injectUnsolicited(const char *line);
+    void interleaveUnsolicited(const char *command, const char *line);
+    bool receiveSMS(const char *number, const char *text);
+    void setTimeSource(Time_Source *source);
+    void setCMUXChannels(uint8_t count);
+    void injectCMUXFrame(uint8_t dlci, const uint8_t *data, uint16_t length, bool badFCS = false);
+
+    bool isPoweredDown(void);
+    uint16_t getCommandCount(void);
+    uint16_t getSentSMSCount(void);
+    const char *getLastSMSText(void);
+    uint8_t getStoredSMSCount(void);
+    bool isMultiplexed(void);
+
+private:
+    typedef enum
+    {
+        SIM_CMUX_FLAG,    ///< Looking for the opening flag
+        SIM_CMUX_ADDRESS, ///< Waiting for the address field
+        SIM_CMUX_CONTROL, ///< Waiting for the control field
+        SIM_CMUX_LENGTH,  ///< Waiting for the length field
+        SIM_CMUX_DATA,    ///< Receiving the information field
+        SIM_CMUX_FCS,     ///< Waiting for the frame check sequence
+        SIM_CMUX_CLOSE    ///< Waiting for the closing flag
+    } sim_cmux_state;
+
+    void receive(uint8_t c);
+    void cmuxDecode(uint8_t c);
+    void cmuxHandleFrame(void);
+    void cmuxSend(uint8_t dlci, uint8_t control, const uint8_t *data, uint16_t length, bool response = false,
+                  bool badFCS = false);
+    void cmuxFlush(void);
+    void queueByte(uint8_t c);
+    void handleCommand(void);
+    void handleSMSText(void);
+    void replySMS(uint8_t slot, const char *prefix);
+    void reply(const char *text);
+    void replyChar(char c);
+    void replyNumber(uint32_t value);
+    void replyInfo(const char *prefix, const char *value);
+    void replyOK(void);
+    void replyError(void);
+    bool chance(uint16_t rate, uint16_t scale);
+    uint32_t nextRandom(void);
+    int released(void);
+    unsigned long millis(void);
+
+    char input[SIM_INPUT_SIZE]; ///< Command or SMS text being received
+    uint16_t inputLength = 0;   ///< Characters in input
+    bool smsTextMode = false;   ///< Collecting SMS text after the "> " prompt
+
+    char output[SIM_OUTPUT_SIZE];         ///< Response bytes not read yet
+    uint16_t outputHead = 0;              ///< Index of the next byte to read
+    uint16_t outputLength = 0;            ///< Bytes waiting in output
+    unsigned long outputReadyAt = 0;      ///< When the first waiting byte becomes readable
+    uint16_t outputConsumed = 0;          ///< Bytes read since outputReadyAt
+
+    Time_Source *timeSource = &ArduinoTime; ///< Clock for latency and baud rate throttling
+    unsigned long latency = 0;            ///< Delay before a response starts
+    uint32_t baud;                        ///< Throttles how fast responses arrive, 0 for no limit
+    uint8_t errorRate = 0;                ///< Percentage of commands answered with ERROR
+    uint8_t dropRate = 0;                 ///< Percentage of commands not answered at all
+    uint16_t corruptionRate = 0;          ///< Per mille of response bytes corrupted
+    uint32_t seed = 1;                    ///< State of the fault injection generator
+
+    const char *failCommand = NULL;       ///< Prefix of the command to fail once
+    const char *failReply = NULL;         ///< Reply used instead of the normal response
+    const char *interleaveCommand = NULL; ///< Prefix of the command whose response gets an unsolicited line
+    const char *interleaveLine = NULL;    ///< Unsolicited line sent after the first line of that response
+    bool interleaving = false;            ///< The response of that command is being queued
+    bool interleaveText = false;          ///< The first line of that response has started
+
+    bool echo = true;                     ///< ATE state
+    bool gnssOn = false;                  ///< AT+QGNSSC state
+    bool poweredDown = false;             ///< AT+QPOWD received
+    uint8_t registration = 1;             ///< Reported by +CREG and +CGREG
+    bool registrationURC = false;         ///< AT+CREG=1, changes are reported with +CREG URCs
+    const char *operatorName = "Simulated"; ///< Reported by +COPS
+    uint8_t signalQuality = 20;           ///< RSSI reported by +CSQ
+    const char *ggaSentence;              ///< Reported by AT+QGNSSRD="NMEA/GGA"
+    const char *nmeaEpoch;                ///< Reported by AT+QGNSSRD?
+    uint8_t smsReference = 0;             ///< Reference of the last sent SMS
+    uint8_t moreMessages = 0;             ///< AT+CMMS state
+    bool pduMode = false;                 ///< AT+CMGF=0 selected
+    uint16_t pduLength = 0;               ///< TPDU length given to AT+CMGS in PDU mode
+    bool smsLinkOpen = false;             ///< The relay link of the last SMS is still up
+    unsigned long smsLinkSetup = 0;       ///< Extra delay of an SMS sent without an open link
+    unsigned long lastSMSAt = 0;          ///< When the last SMS was sent
+    uint16_t commandCount = 0;            ///< Commands received
+    uint16_t sentSMSCount = 0;            ///< SMS sent
+    char lastSMSText[SIM_INPUT_SIZE];     ///< Text, or hex PDU in PDU mode, of the last sent SMS
+
+    bool cmuxMode = false;                    ///< AT+CMUX=0 received, bytes are basic mode frames
+    uint8_t cmuxChannels = 7;                 ///< DLCIs above this are refused with DM
+    uint8_t cmuxDlci = 1;                     ///< DLCI replies go to
+    sim_cmux_state cmuxState = SIM_CMUX_FLAG; ///< Where cmuxDecode() is in the frame
+    uint8_t cmuxAddress = 0;                  ///< Address field of the frame being received
+    uint8_t cmuxControl = 0;                  ///< Control field of the frame being received
+    uint8_t cmuxLength = 0;                   ///< Length of the information field
+    uint8_t cmuxIdx = 0;                      ///< Information bytes received
+    uint8_t cmuxFcs = 0;                      ///< Running frame check sequence
+    uint8_t cmuxFrame[SIM_CMUX_FRAME_SIZE];   ///< Information field being received
+    uint8_t cmuxReply[SIM_CMUX_FRAME_SIZE];   ///< Reply bytes for the next frame
+    uint8_t cmuxReplyLength = 0;              ///< Bytes in cmuxReply
+
+    typedef struct
+    {
+        bool used;       ///< Slot holds a message
+        bool read;       ///< Reported as "REC READ" instead of "REC UNREAD"
+        char number[21]; ///< Sender
+        char text[161];  ///< Message text
+    } sim_sms;
+
+    sim_sms inbox[SIM_INBOX_SIZE]; ///< Received SMS, index 1 is inbox[0]
+};
+
+#endif
@@ -0,0 +1,725 @@
+#include "NMEA_Parser.h"
+
+/**************************************************************************/
+/*!
+    @brief Check if a character terminates an NMEA field
+    @param c Character to check
+    @returns True on ',', '*' or the end of the string
+*/
+/**************************************************************************/
+static inline bool isFieldEnd(char c)
+{
+    return c == ',' || c == '*' || c == '\0';
+}
+
+/**************************************************************************/
+/*!
+    @brief Parse an unsigned integer from the start of a field
+    @param p Pointer to the field, advanced past the digits
+    @param maxDigits Maximum number of digits to consume (optional)
+    @returns Parsed value, 0 if the field is empty
+*/
+/**************************************************************************/
+static uint32_t parseUnsigned(const char *&p, uint8_t maxDigits = 9)
+{
+    uint32_t value = 0;
+
+    while (maxDigits-- && *p >= '0' && *p <= '9')
+        value = value * 10 + (*p++ - '0');
+
+    return value;
+}
+
+/**************************************************************************/
+/*!
+    @brief Parse a signed decimal number into fixed-point
+    @param p Pointer to the field, advanced past the number
+    @param decimals Number of decimals to keep, extra digits are truncated
+    @returns Value multiplied by 10^decimals
+*/
+/**************************************************************************/
+static int32_t parseFixed(const char *&p, uint8_t decimals)
+{
+    bool negative = *p == '-';
+    if (negative || *p == '+')
+        p++;
+
+    int32_t value = parseUnsigned(p);
+
+    if (*p == '.')
+        p++;
+
+    for (; decimals; decimals--)
+        value = value * 10 + ((*p >= '0' && *p <= '9') ? *p++ - '0' : 0);
+
+    while (*p >= '0' && *p <= '9') ///< Skip what does not fit
+        p++;
+
+    return negative ? -value : value;
+}
+
+/**************************************************************************/
+/*!
+    @brief Parse a (d)ddmm.mmmmmm coordinate
+    @param p Pointer to the field, advanced past the number
+    @returns Coordinate in 1e-7 degrees, always positive
+*/
+/**************************************************************************/
+static int32_t parseCoordinate(const char *&p)
+{
+    uint32_t degreeMinutes = parseUnsigned(p);
+    uint32_t microMinutes = (degreeMinutes % 100) * 1000000UL;
+
+    if (*p == '.')
+    {
+        p++;
+        for (uint32_t scale = 100000UL; scale && *p >= '0' && *p <= '9'; scale /= 10)
+            microMinutes += (*p++ - '0') * scale;
+        while (*p >= '0' && *p <= '9')
+            p++;
+    }
+
+    return (degreeMinutes / 100) * 10000000L + (microMinutes + 3) / 6; ///< 1e-6 minutes to 1e-7 degrees
+}
+
+/**************************************************************************/
+/*!
+    @brief Parse a hhmmss.ss time into the fix
+    @param p Pointer to the field, advanced past the time
+    @param fix Fix to update
+*/
+/**************************************************************************/
+static void parseTime(const char *&p, gnss_fix &fix)
+{
+    fix.hour = parseUnsigned(p, 2);
+    fix.minute = parseUnsigned(p, 2);
+    fix.second = parseUnsigned(p, 2);
+    fix.centisecond = 0;
+    if (*p == '.')
+        fix.centisecond = parseUnsigned(++p, 2);
+}
+
+/**************************************************************************/
+/*!
+    @brief Get the constellation of a talker ID
+    @param talker Second character of the talker ID
+    @returns gnss_system, GNSS_ANY for combined (GN) or unknown talkers
+*/
+/**************************************************************************/
+static uint8_t talkerSystem(char talker)
+{
+    switch (talker)
+    {
+    case 'P':
+        return GNSS_GPS;
+    case 'L':
+        return GNSS_GLONASS;
+    case 'A':
+        return GNSS_GALILEO;
+    case 'B':
+    case 'D':
+        return GNSS_BEIDOU;
+    default:
+        return GNSS_ANY;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Guess the constellation of a satellite reported by a GN talker
+    @param prn Satellite ID
+    @returns GNSS_GLONASS for IDs 65 to 96, GNSS_GPS otherwise
+*/
+/**************************************************************************/
+static uint8_t prnSystem(uint8_t prn)
+{
+    return (prn >= 65 && prn <= 96) ? GNSS_GLONASS : GNSS_GPS;
+}
+
+/**************************************************************************/
+/*!
+    @brief Constructor
+*/
+/**************************************************************************/
+NMEA_Parser::NMEA_Parser()
+{
+    clear();
+    resetStatistics();
+    length = 0;
+    state = NMEA_IDLE;
+    checksum = expected = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief Feed one received character. The checksum is computed as the
+   characters arrive, and the fix is only touched once a whole sentence with
+   a matching checksum has been received, so a damaged sentence leaves the
+   previous fix as it was.
+    @param c Received character
+    @returns True if a sentence was accepted and updated the fix
+*/
+/**************************************************************************/
+bool NMEA_Parser::encode(char c)
+{
+    if (c == '$')
+    {
+        if (state != NMEA_IDLE)
+            statistics.truncated++;
+        state = NMEA_BODY;
+        checksum = 0;
+        sentence[0] = c;
+        length = 1;
+        return false;
+    }
+
+    if (state == NMEA_IDLE)
+        return false;
+
+    if (c == '\r' || c == '\n')
+    {
+        nmea_state ended = state;
+        state = NMEA_IDLE;
+
+        if (ended != NMEA_CHECKSUM_DONE)
+        {
+            statistics.truncated++;
+            return false;
+        }
+        if (expected != checksum)
+        {
+            statistics.checksum_errors++;
+            return false;
+        }
+
+        sentence[length] = '\0';
+        if (!dispatch())
+            return false;
+
+        statistics.sentences++;
+        return true;
+    }
+
+    switch (state)
+    {
+    case NMEA_BODY:
+        if (c == '*')
+            state = NMEA_CHECKSUM_HIGH;
+        else
+            checksum ^= c;
+        break;
+    case NMEA_CHECKSUM_HIGH:
+    case NMEA_CHECKSUM_LOW:
+    {
+        uint8_t digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else
+        {
+            statistics.checksum_errors++;
+            state = NMEA_IDLE;
+            return false;
+        }
+        expected = (state == NMEA_CHECKSUM_HIGH) ? digit << 4 : expected | digit;
+        state = (state == NMEA_CHECKSUM_HIGH) ? NMEA_CHECKSUM_LOW : NMEA_CHECKSUM_DONE;
+        break;
+    }
+    default: ///< Anything between the checksum and the line ending
+        statistics.checksum_errors++;
+        state = NMEA_IDLE;
+        return false;
+    }
+
+    if (length >= sizeof(sentence) - 1)
+    {
+        statistics.truncated++;
+        state = NMEA_IDLE;
+        return false;
+    }
+
+    sentence[length++] = c;
+    return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief Parse one sentence held in memory and update the fix. The sentence
+   goes through encode(), so it is checked the same way.
+    @param sentence Null terminated sentence starting with '$' and ending with
+   the checksum, the line ending is optional
+    @returns True if the sentence was accepted, False if it is damaged or its
+   type is not supported
+*/
+/**************************************************************************/
+bool NMEA_Parser::parse(const char *sentence)
+{
+    bool accepted = false;
+
+    while (*sentence)
+        accepted |= encode(*sentence++);
+
+    return accepted | encode('\n');
+}
+
+/**************************************************************************/
+/*!
+    @brief Parse the received sentence, its checksum already matched
+    @returns True if the sentence type is supported, False otherwise
+*/
+/**************************************************************************/
+bool NMEA_Parser::dispatch(void)
+{
+    if (length < 6)
+        return false;
+
+    const char *type = sentence + 3; ///< Skip '$' and the talker ID (GP, GL, GN, ...)
+    uint8_t system = talkerSystem(sentence[2]);
+
+    if (strncmp(type, "GGA", 3) == 0)
+        parseGGA(sentence);
+    else if (strncmp(type, "RMC", 3) == 0)
+        parseRMC(sentence);
+    else if (strncmp(type, "VTG", 3) == 0)
+        parseVTG(sentence);
+    else if (strncmp(type, "GSA", 3) == 0)
+        parseGSA(sentence, system);
+    else if (strncmp(type, "GSV", 3) == 0)
+        parseGSV(sentence, system);
+    else
+        return false;
+
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Get the fix built from the parsed sentences
+    @returns Fix, check flags for the fields that are set
+*/
+/**************************************************************************/
+const gnss_fix &NMEA_Parser::getFix(void) { return fix; }
+
+/**************************************************************************/
+/*!
+    @brief Get the satellites in view, built from GSA and GSV sentences
+    @returns Satellite table
+*/
+/**************************************************************************/
+const gnss_satellites &NMEA_Parser::getSatellites(void) { return satellites; }
+
+/**************************************************************************/
+/*!
+    @brief Forget the fix and the satellites
+*/
+/**************************************************************************/
+void NMEA_Parser::clear(void)
+{
+    memset(&fix, 0, sizeof(fix));
+    memset(&satellites, 0, sizeof(satellites));
+}
+
+/**************************************************************************/
+/*!
+    @brief Get the counters of accepted and rejected sentences
+    @returns Counters since the last resetStatistics()
+*/
+/**************************************************************************/
+const nmea_statistics &NMEA_Parser::getStatistics(void) { return statistics; }
+
+/**************************************************************************/
+/*!
+    @brief Reset the sentence counters
+*/
+/**************************************************************************/
+void NMEA_Parser::resetStatistics(void) { memset(&statistics, 0, sizeof(statistics)); }
+
+/**************************************************************************/
+/*!
+    @brief Parse a GGA sentence in a single pass
+    @param p Sentence, starting with the "$--GGA" field
+*/
+/**************************************************************************/
+void NMEA_Parser::parseGGA(const char *p)
+{
+    uint8_t flags = 0;
+
+    fix.hour = fix.minute = fix.second = fix.centisecond = 0;
+    fix.latitude = fix.longitude = fix.altitude = fix.geoidal_separation = 0;
+    fix.hdop = 0;
+    fix.fix_type = fix.satellites = 0;
+    fix.age_of_differential = fix.differential_reference_station_id = 0;
+
+    for (uint8_t field = 0;; field++)
+    {
+        bool empty = isFieldEnd(*p);
+
+        switch (field)
+        {
+        case 1: ///< hhmmss.ss
+            parseTime(p, fix);
+            flags |= empty ? 0 : GNSS_HAS_TIME;
+            break;
+        case 2: ///< ddmm.mmmm
+            fix.latitude = parseCoordinate(p);
+            flags |= empty ? 0 : GNSS_HAS_POSITION;
+            break;
+        case 3: ///< N/S
+            if (*p == 'S')
+                fix.latitude = -fix.latitude;
+            break;
+        case 4: ///< dddmm.mmmm
+            fix.longitude = parseCoordinate(p);
+            break;
+        case 5: ///< E/W
+            if (*p == 'W')
+                fix.longitude = -fix.longitude;
+            break;
+        case 6:
+            fix.fix_type = parseUnsigned(p);
+            break;
+        case 7:
+            fix.satellites = parseUnsigned(p);
+            break;
+        case 8:
+            fix.hdop = parseFixed(p, 2);
+            flags |= empty ? 0 : GNSS_HAS_HDOP;
+            break;
+        case 9:
+            fix.altitude = parseFixed(p, 2);
+            flags |= empty ? 0 : GNSS_HAS_ALTITUDE;
+            break;
+        case 11:
+            fix.geoidal_separation = parseFixed(p, 2);
+            break;
+        case 13:
+            fix.age_of_differential = parseUnsigned(p);
+            break;
+        case 14:
+            fix.differential_reference_station_id = parseUnsigned(p);
+            break;
+        }
+
+        while (!isFieldEnd(*p)) ///< Skip whatever is left of the field
+            p++;
+
+        if (*p != ',')
+            break;
+        p++;
+    }
+
+    fix.flags = (fix.flags & ~(GNSS_HAS_TIME | GNSS_HAS_POSITION | GNSS_HAS_ALTITUDE | GNSS_HAS_HDOP)) | flags;
+}
+
+/**************************************************************************/
+/*!
+    @brief Parse an RMC sentence in a single pass, the position is only kept
+   when the status is valid
+    @param p Sentence, starting with the "$--RMC" field
+*/
+/**************************************************************************/
+void NMEA_Parser::parseRMC(const char *p)
+{
+    uint8_t flags = 0;
+    bool valid = false;
+    int32_t latitude = 0, longitude = 0;
+
+    fix.hour = fix.minute = fix.second = fix.centisecond = 0;
+    fix.day = fix.month = fix.year = 0;
+    fix.speed = fix.course = 0;
+
+    for (uint8_t field = 0;; field++)
+    {
+        bool empty = isFieldEnd(*p);
+
+        switch (field)
+        {
+        case 1: ///< hhmmss.ss
+            parseTime(p, fix);
+            flags |= empty ? 0 : GNSS_HAS_TIME;
+            break;
+        case 2: ///< A = valid, V = void
+            valid = *p == 'A';
+            break;
+        case 3: ///< ddmm.mmmm
+            latitude = parseCoordinate(p);
+            break;
+        case 4: ///< N/S
+            if (*p == 'S')
+                latitude = -latitude;
+            break;
+        case 5: ///< dddmm.mmmm
+            longitude = parseCoordinate(p);
+            break;
+        case 6: ///< E/W
+            if (*p == 'W')
+                longitude = -longitude;
+            break;
+        case 7: ///< Knots
+            fix.speed = parseFixed(p, 2);
+            flags |= empty ? 0 : GNSS_HAS_VELOCITY;
+            break;
+        case 8: ///< Degrees, true north
+            fix.course = parseFixed(p, 2);
+            break;
+        case 9: ///< ddmmyy
+            fix.day = parseUnsigned(p, 2);
+            fix.month = parseUnsigned(p, 2);
+            fix.year = parseUnsigned(p, 2);
+            flags |= empty ? 0 : GNSS_HAS_DATE;
+            break;
+        }
+
+        while (!isFieldEnd(*p)) ///< Skip whatever is left of the field
+            p++;
+
+        if (*p != ',')
+            break;
+        p++;
+    }
+
+    if (valid)
+    {
+        fix.latitude = latitude;
+        fix.longitude = longitude;
+        flags |= GNSS_HAS_POSITION;
+    }
+
+    fix.flags = (fix.flags & ~(GNSS_HAS_TIME | GNSS_HAS_DATE | GNSS_HAS_VELOCITY | GNSS_HAS_POSITION)) | flags;
+}
+
+/**************************************************************************/
+/*!
+    @brief Parse a VTG sentence in a single pass
+    @param p Sentence, starting with the "$--VTG" field
+*/
+/**************************************************************************/
+void NMEA_Parser::parseVTG(const char *p)
+{
+    uint8_t flags = 0;
+
+    fix.speed = fix.course = 0;
+
+    for (uint8_t field = 0;; field++)
+    {
+        bool empty = isFieldEnd(*p);
+
+        switch (field)
+        {
+        case 1: ///< Degrees, true north
+            fix.course = parseFixed(p, 2);
+            break;
+        case 5: ///< Knots
+            fix.speed = parseFixed(p, 2);
+            flags |= empty ? 0 : GNSS_HAS_VELOCITY;
+            break;
+        }
+
+        while (!isFieldEnd(*p)) ///< Skip whatever is left of the field
+            p++;
+
+        if (*p != ',')
+            break;
+        p++;
+    }
+
+    fix.flags = (fix.flags & ~GNSS_HAS_VELOCITY) | flags;
+}
+
+/**************************************************************************/
+/*!
+    @brief Parse a GSA sentence in a single pass and mark the satellites used
+   in the fix. Satellites not seen in GSV yet are added to the table.
+    @param p Sentence, starting with the "$--GSA" field
+    @param system gnss_system of the talker, GNSS_ANY to guess it from the
+   first satellite ID
+*/
+/**************************************************************************/
+void NMEA_Parser::parseGSA(const char *p, uint8_t system)
+{
+    uint8_t flags = 0;
+    bool cleared = false;
+
+    fix.fix_mode = 0;
+    fix.pdop = fix.vdop = 0;
+
+    for (uint8_t field = 0;; field++)
+    {
+        bool empty = isFieldEnd(*p);
+
+        if (field == 2)
+            fix.fix_mode = parseUnsigned(p);
+        else if (field >= 3 && field <= 14 && !empty) ///< Satellites used
+        {
+            uint8_t prn = parseUnsigned(p, 3);
+
+            if (!cleared)
+            {
+                if (system == GNSS_ANY)
+                    system = prnSystem(prn);
+                for (uint8_t i = 0; i < satellites.count; i++)
+                    if (satellites.system[i] == system)
+                        satellites.status[i] &= ~GNSS_SATELLITE_USED;
+                cleared = true;
+            }
+
+            int16_t i = findSatellite(system, prn, true);
+            if (i >= 0)
+                satellites.status[i] |= GNSS_SATELLITE_USED;
+        }
+        else if (field == 15)
+            fix.pdop = parseFixed(p, 2);
+        else if (field == 17)
+        {
+            fix.vdop = parseFixed(p, 2);
+            flags |= empty ? 0 : GNSS_HAS_DOP;
+        }
+
+        while (!isFieldEnd(*p)) ///< Skip whatever is left of the field
+            p++;
+
+        if (*p != ',')
+            break;
+        p++;
+    }
+
+    fix.flags = (fix.flags & ~GNSS_HAS_DOP) | flags;
+}
+
+/**************************************************************************/
+/*!
+    @brief Parse one message of a GSV sequence in a single pass. Satellites
+   are updated as each message arrives; the first message marks the
+   constellation stale and the last one removes the satellites it did not
+   report.
+    @param p Sentence, starting with the "$--GSV" field
+    @param system gnss_system of the talker, GNSS_ANY to guess it from each
+   satellite ID
+*/
+/**************************************************************************/
+void NMEA_Parser::parseGSV(const char *p, uint8_t system)
+{
+    uint8_t messages = 0, message = 0, inView = 0, blocks = 0;
+    int16_t i = -1;
+
+    for (uint8_t field = 0;; field++)
+    {
+        bool empty = isFieldEnd(*p);
+
+        if (field == 1)
+            messages = parseUnsigned(p);
+        else if (field == 2)
+            message = parseUnsigned(p);
+        else if (field == 3)
+        {
+            inView = parseUnsigned(p);
+            if (message == 0 || message > messages)
+                return;
+            blocks = (inView > (message - 1) * 4) ? inView - (message - 1) * 4 : 0;
+            if (blocks > 4)
+                blocks = 4;
+            if (message == 1)
+                for (uint8_t j = 0; j < satellites.count; j++)
+                    if (system == GNSS_ANY || satellites.system[j] == system)
+                        satellites.status[j] |= GNSS_SATELLITE_STALE;
+        }
+        else if (field >= 4 && field < 4 + blocks * 4) ///< PRN, elevation, azimuth, SNR
+        {
+            switch ((field - 4) % 4)
+            {
+            case 0:
+                i = -1;
+                if (!empty)
+                {
+                    uint8_t prn = parseUnsigned(p, 3);
+                    i = findSatellite(system == GNSS_ANY ? prnSystem(prn) : system, prn, true);
+                    if (i >= 0)
+                        satellites.status[i] &= ~GNSS_SATELLITE_STALE;
+                }
+                break;
+            case 1:
+                if (i >= 0)
+                    satellites.elevation[i] = parseFixed(p, 0);
+                break;
+            case 2:
+                if (i >= 0)
+                    satellites.azimuth[i] = parseUnsigned(p, 3);
+                break;
+            case 3:
+                if (i >= 0)
+                    satellites.snr[i] = parseUnsigned(p, 2);
+                break;
+            }
+        }
+
+        while (!isFieldEnd(*p)) ///< Skip whatever is left of the field
+            p++;
+
+        if (*p != ',')
+            break;
+        p++;
+    }
+
+    if (message != 0 && message == messages)
+        removeSatellites(system, GNSS_SATELLITE_STALE);
+}
+
+/**************************************************************************/
+/*!
+    @brief Find a satellite in the table
+    @param system gnss_system of the satellite
+    @param prn Satellite ID
+    @param add Set to true to add the satellite if it is not in the table
+    @returns Index in the table, -1 if not found or the table is full
+*/
+/**************************************************************************/
+int16_t NMEA_Parser::findSatellite(uint8_t system, uint8_t prn, bool add)
+{
+    for (uint8_t i = 0; i < satellites.count; i++)
+        if (satellites.prn[i] == prn && satellites.system[i] == system)
+            return i;
+
+    if (!add || satellites.count >= GNSS_MAX_SATELLITES)
+        return -1;
+
+    uint8_t i = satellites.count++;
+    satellites.system[i] = system;
+    satellites.prn[i] = prn;
+    satellites.elevation[i] = 0;
+    satellites.azimuth[i] = 0;
+    satellites.snr[i] = 0;
+    satellites.status[i] = 0;
+    return i;
+}
+
+/**************************************************************************/
+/*!
+    @brief Remove satellites from the table, keeping the order of the others
+    @param system gnss_system to remove from, GNSS_ANY for all
+    @param status Remove the satellites having any of these GNSS_SATELLITE_*
+   flags
+*/
+/**************************************************************************/
+void NMEA_Parser::removeSatellites(uint8_t system, uint8_t status)
+{
+    uint8_t kept = 0;
+
+    for (uint8_t i = 0; i < satellites.count; i++)
+    {
+        if ((system == GNSS_ANY || satellites.system[i] == system) && (satellites.status[i] & status))
+            continue;
+
+        satellites.system[kept] = satellites.system[i];
+        satellites.prn[kept] = satellites.prn[i];
+        satellites.elevation[kept] = satellites.elevation[i];
+        satellites.azimuth[kept] = satellites.azimuth[i];
+        satellites.snr[kept] = satellites.snr[i];
+        satellites.status[kept] = satellites.status[i];
+        kept++;
+    }
+
+    satellites.count = kept;
+}
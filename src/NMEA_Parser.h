@@ -0,0 +1,147 @@
+#ifndef __NMEA_PARSER_H__
+#define __NMEA_PARSER_H__
+
+#include <Arduino.h>
+
+#define GNSS_HAS_TIME 0x01     ///< hour, minute, second and centisecond are set
+#define GNSS_HAS_POSITION 0x02 ///< latitude and longitude are set
+#define GNSS_HAS_ALTITUDE 0x04 ///< altitude and geoidal_separation are set
+#define GNSS_HAS_HDOP 0x08     ///< hdop is set
+#define GNSS_HAS_DATE 0x10     ///< day, month and year are set
+#define GNSS_HAS_VELOCITY 0x20 ///< speed and course are set
+#define GNSS_HAS_DOP 0x40      ///< fix_mode, pdop and vdop are set
+
+#ifndef GNSS_MAX_SATELLITES
+#if defined(__AVR__)
+#define GNSS_MAX_SATELLITES 12 ///< satellites kept in the satellite table
+#else
+#define GNSS_MAX_SATELLITES 32 ///< satellites kept in the satellite table
+#endif
+#endif
+
+#ifndef NMEA_SENTENCE_LENGTH
+#define NMEA_SENTENCE_LENGTH 83 ///< longest sentence kept, NMEA 0183 allows 82 characters
+#endif
+
+#define GNSS_SATELLITE_USED 0x01  ///< satellite is used in the fix (from GSA)
+#define GNSS_SATELLITE_STALE 0x02 ///< not reported by the GSV sequence in progress
+
+typedef enum
+{
+    GNSS_GPS = 0,
+    GNSS_GLONASS = 1,
+    GNSS_GALILEO = 2,
+    GNSS_BEIDOU = 3,
+    GNSS_ANY = 0xFF
+} gnss_system;
+
+/**************************************************************************/
+/*!
+    @brief GNSS fix in integer fixed-point, parsed without floating point
+*/
+/**************************************************************************/
+typedef struct
+{
+    uint8_t hour;                               ///< Hour in 24-hour format (UTC)
+    uint8_t minute;                             ///< Minute
+    uint8_t second;                             ///< Second
+    uint8_t centisecond;                        ///< Hundredths of a second
+    uint8_t day;                                ///< Day of the month (UTC)
+    uint8_t month;                              ///< Month
+    uint8_t year;                               ///< Year since 2000
+    int32_t latitude;                           ///< Latitude in 1e-7 degrees, north positive
+    int32_t longitude;                          ///< Longitude in 1e-7 degrees, east positive
+    int32_t altitude;                           ///< Altitude above mean sea level in centimeters
+    int32_t geoidal_separation;                 ///< Geoidal separation in centimeters
+    uint16_t hdop;                              ///< Horizontal dilution of precision x100
+    uint16_t pdop;                              ///< Position dilution of precision x100
+    uint16_t vdop;                              ///< Vertical dilution of precision x100
+    uint32_t speed;                             ///< Speed over ground in 1e-2 knots
+    uint16_t course;                            ///< Course over ground in 1e-2 degrees, true north
+    uint8_t fix_type;                           ///< GGA fix quality (0 = No fix, 1 = GPS fix, 2 = Differential GPS fix, ...)
+    uint8_t fix_mode;                           ///< GSA fix mode (1 = No fix, 2 = 2D, 3 = 3D)
+    uint8_t satellites;                         ///< Number of satellites used
+    uint16_t age_of_differential;               ///< Age of differential GPS data (seconds)
+    uint16_t differential_reference_station_id; ///< Differential reference station ID
+    uint8_t flags;                              ///< GNSS_HAS_* flags of the fields that are set
+} gnss_fix;
+
+/**************************************************************************/
+/*!
+    @brief Satellites in view, as a structure of arrays so each column is
+   packed without padding. Entry i is described by system[i], prn[i], ...
+*/
+/**************************************************************************/
+typedef struct
+{
+    uint8_t count;                         ///< Entries in use
+    uint8_t system[GNSS_MAX_SATELLITES];   ///< gnss_system of the satellite
+    uint8_t prn[GNSS_MAX_SATELLITES];      ///< Satellite ID as reported in NMEA
+    int8_t elevation[GNSS_MAX_SATELLITES]; ///< Elevation in degrees
+    uint16_t azimuth[GNSS_MAX_SATELLITES]; ///< Azimuth in degrees, true north
+    uint8_t snr[GNSS_MAX_SATELLITES];      ///< C/N0 in dB-Hz, 0 if not tracked
+    uint8_t status[GNSS_MAX_SATELLITES];   ///< GNSS_SATELLITE_* flags
+} gnss_satellites;
+
+/**************************************************************************/
+/*!
+    @brief Counters of the sentences seen by NMEA_Parser
+*/
+/**************************************************************************/
+typedef struct
+{
+    uint16_t sentences;       ///< Sentences accepted
+    uint16_t checksum_errors; ///< Sentences rejected because the checksum did not match
+    uint16_t truncated;       ///< Sentences rejected because they were cut short or too long
+} nmea_statistics;
+
+/**************************************************************************/
+/*!
+    @brief Parser for NMEA sentences filling a gnss_fix
+*/
+/**************************************************************************/
+class NMEA_Parser
+{
+public:
+    NMEA_Parser();
+
+    bool encode(char c);
+    bool parse(const char *sentence);
+    const gnss_fix &getFix(void);
+    const gnss_satellites &getSatellites(void);
+    void clear(void);
+
+    const nmea_statistics &getStatistics(void);
+    void resetStatistics(void);
+
+private:
+    typedef enum
+    {
+        NMEA_IDLE,          ///< Waiting for '$'
+        NMEA_BODY,          ///< Receiving the sentence, checksum running
+        NMEA_CHECKSUM_HIGH, ///< Waiting for the first checksum digit
+        NMEA_CHECKSUM_LOW,  ///< Waiting for the second checksum digit
+        NMEA_CHECKSUM_DONE  ///< Waiting for the line ending
+    } nmea_state;
+
+    bool dispatch(void);
+    void parseGGA(const char *p);
+    void parseRMC(const char *p);
+    void parseVTG(const char *p);
+    void parseGSA(const char *p, uint8_t system);
+    void parseGSV(const char *p, uint8_t system);
+    int16_t findSatellite(uint8_t system, uint8_t prn, bool add);
+    void removeSatellites(uint8_t system, uint8_t status);
+
+    gnss_fix fix;               ///< Fix built from the parsed sentences
+    gnss_satellites satellites; ///< Satellites built from GSA and GSV
+    nmea_statistics statistics; ///< Sentences accepted and rejected
+
+    char sentence[NMEA_SENTENCE_LENGTH]; ///< Sentence being received
+    uint8_t length;                      ///< Characters in sentence
+    nmea_state state;                    ///< Where encode() is in the sentence
+    uint8_t checksum;                    ///< XOR of the characters between '$' and '*'
+    uint8_t expected;                    ///< Checksum sent with the sentence
+};
+
+#endif
@@ -0,0 +1,403 @@
+#include "Posix_Serial.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define POSIX_SERIAL_WRITE_TIMEOUT 1000 ///< how long drain() waits for a full port to accept bytes, in milliseconds
+
+/**************************************************************************/
+/*!
+    @brief termios speed of a baud rate
+    @param baud Baud rate
+    @returns Speed constant, B0 if the rate is not supported
+*/
+/**************************************************************************/
+static speed_t speedOf(uint32_t baud)
+{
+    switch (baud)
+    {
+    case 1200:
+        return B1200;
+    case 2400:
+        return B2400;
+    case 4800:
+        return B4800;
+    case 9600:
+        return B9600;
+    case 19200:
+        return B19200;
+    case 38400:
+        return B38400;
+    case 57600:
+        return B57600;
+    case 115200:
+        return B115200;
+    case 230400:
+        return B230400;
+#ifdef B460800
+    case 460800:
+        return B460800;
+#endif
+#ifdef B921600
+    case 921600:
+        return B921600;
+#endif
+    default:
+        return B0;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Destructor, sends what is left and closes the port
+*/
+/**************************************************************************/
+Posix_Serial::~Posix_Serial() { close(); }
+
+/**************************************************************************/
+/*!
+    @brief Open and configure a serial port
+    @param path Device, e.g. "/dev/ttyUSB0"
+    @param baud Baud rate
+    @param hardwareFlowControl Use RTS/CTS, matching AT+IFC=2,2 (optional,
+   default = false)
+    @returns True on success, False on failure (see getError())
+*/
+/**************************************************************************/
+bool Posix_Serial::open(const char *path, uint32_t baud, bool hardwareFlowControl)
+{
+    close();
+
+    int port = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (port < 0)
+    {
+        fail(errno);
+        return false;
+    }
+
+    if (!attach(port, baud, hardwareFlowControl))
+    {
+        close();
+        return false;
+    }
+
+    tcflush(fd, TCIOFLUSH); ///< Drop whatever the modem sent before we opened the port
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Use an already open descriptor, e.g. the slave side of a pty. The
+   Posix_Serial closes it from now on.
+    @param fd Open file descriptor
+    @param baud Baud rate
+    @param hardwareFlowControl Use RTS/CTS (optional, default = false)
+    @returns True on success, False on failure (see getError())
+*/
+/**************************************************************************/
+bool Posix_Serial::attach(int fd, uint32_t baud, bool hardwareFlowControl)
+{
+    if (this->fd != fd)
+        close();
+
+    this->fd = fd;
+    rxHead = rxTail = 0;
+    txLength = 0;
+    error = 0;
+
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        fail(errno);
+        return false;
+    }
+
+    return configure(baud, hardwareFlowControl);
+}
+
+/**************************************************************************/
+/*!
+    @brief Change the baud rate, e.g. after AT+IPR, keeping the other settings
+    @param baud Baud rate
+    @returns True on success, False on failure (see getError())
+*/
+/**************************************************************************/
+bool Posix_Serial::begin(uint32_t baud)
+{
+    struct termios tio;
+
+    if (fd < 0)
+    {
+        fail(EBADF);
+        return false;
+    }
+
+    if (!drain()) ///< Bytes queued at the old rate go out at the old rate
+        return false;
+
+    if (tcgetattr(fd, &tio) < 0)
+    {
+        fail(errno);
+        return false;
+    }
+
+    return configure(baud, tio.c_cflag & CRTSCTS);
+}
+
+/**************************************************************************/
+/*!
+    @brief Send what is left and close the port
+*/
+/**************************************************************************/
+void Posix_Serial::close(void)
+{
+    if (fd < 0)
+        return;
+
+    (void)drain();
+    ::close(fd);
+    fd = -1;
+    rxHead = rxTail = 0;
+    txLength = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief Check if the port is open
+    @returns True if open
+*/
+/**************************************************************************/
+bool Posix_Serial::isOpen(void) { return fd >= 0; }
+
+/**************************************************************************/
+/*!
+    @brief File descriptor of the port, for poll() or epoll when serving
+   several modems from one loop
+    @returns Descriptor, -1 when closed
+*/
+/**************************************************************************/
+int Posix_Serial::getFD(void) { return fd; }
+
+/**************************************************************************/
+/*!
+    @brief errno of the last failure
+    @returns Error number, 0 if nothing failed
+*/
+/**************************************************************************/
+int Posix_Serial::getError(void) { return error; }
+
+/**************************************************************************/
+/*!
+    @brief Send the collected bytes, then get the number of bytes available
+   for reading - part of 'Stream'-class functionality
+    @returns Bytes available, 0 if none
+*/
+/**************************************************************************/
+int Posix_Serial::available(void)
+{
+    (void)drain();
+
+    if (rxTail == rxHead)
+        (void)fill();
+
+    return rxHead - rxTail;
+}
+
+/**************************************************************************/
+/*!
+    @brief Read one byte - part of 'Stream'-class functionality
+    @returns The byte, or -1 if nothing was available
+*/
+/**************************************************************************/
+int Posix_Serial::read(void)
+{
+    if (available() == 0)
+        return -1;
+
+    return rxBuffer[rxTail++];
+}
+
+/**************************************************************************/
+/*!
+    @brief Look at the next byte without taking it - part of 'Stream'-class
+   functionality
+    @returns The byte, or -1 if nothing was available
+*/
+/**************************************************************************/
+int Posix_Serial::peek(void)
+{
+    if (available() == 0)
+        return -1;
+
+    return rxBuffer[rxTail];
+}
+
+/**************************************************************************/
+/*!
+    @brief Queue one byte, sending the batch when it is full - part of
+   'Print'-class functionality
+    @param c Byte to send
+    @returns 1 on success, 0 if the port is closed or failed
+*/
+/**************************************************************************/
+size_t Posix_Serial::write(uint8_t c)
+{
+    if (fd < 0)
+        return 0;
+
+    if (txLength == POSIX_SERIAL_TX_SIZE && !drain())
+        return 0;
+
+    txBuffer[txLength++] = c;
+    return 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief Queue a block of bytes - part of 'Print'-class functionality
+    @param buffer Bytes to send
+    @param size Number of bytes
+    @returns Bytes queued
+*/
+/**************************************************************************/
+size_t Posix_Serial::write(const uint8_t *buffer, size_t size)
+{
+    size_t written = 0;
+
+    while (written < size && write(buffer[written]))
+        written++;
+
+    return written;
+}
+
+/**************************************************************************/
+/*!
+    @brief Send the collected bytes now - part of 'Print'-class functionality
+*/
+/**************************************************************************/
+void Posix_Serial::flush(void) { (void)drain(); }
+
+/**************************************************************************/
+/*!
+    @brief Apply raw mode, 8N1 and the baud rate
+    @param baud Baud rate
+    @param hardwareFlowControl Use RTS/CTS
+    @returns True on success, False on failure
+*/
+/**************************************************************************/
+bool Posix_Serial::configure(uint32_t baud, bool hardwareFlowControl)
+{
+    struct termios tio;
+    speed_t speed = speedOf(baud);
+
+    if (speed == B0)
+    {
+        fail(EINVAL);
+        return false;
+    }
+
+    if (tcgetattr(fd, &tio) < 0)
+    {
+        fail(errno);
+        return false;
+    }
+
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    if (hardwareFlowControl)
+        tio.c_cflag |= CRTSCTS;
+    tio.c_cc[VMIN] = 0; ///< read() returns at once with whatever is there
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+
+    if (tcsetattr(fd, TCSANOW, &tio) < 0)
+    {
+        fail(errno);
+        return false;
+    }
+
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Refill the empty receive buffer with one non-blocking read()
+    @returns True if bytes were read
+*/
+/**************************************************************************/
+bool Posix_Serial::fill(void)
+{
+    if (fd < 0)
+        return false;
+
+    ssize_t count = ::read(fd, rxBuffer, sizeof(rxBuffer));
+    if (count < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            fail(errno);
+        count = 0;
+    }
+
+    rxTail = 0;
+    rxHead = count;
+    return count > 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief Write the collected bytes, waiting up to POSIX_SERIAL_WRITE_TIMEOUT
+   for the port to accept them
+    @returns True if everything was sent, False on a failure or timeout
+*/
+/**************************************************************************/
+bool Posix_Serial::drain(void)
+{
+    uint16_t sent = 0;
+
+    while (fd >= 0 && sent < txLength)
+    {
+        ssize_t count = ::write(fd, txBuffer + sent, txLength - sent);
+        if (count > 0)
+        {
+            sent += count;
+            continue;
+        }
+
+        if (count < 0 && errno == EINTR)
+            continue;
+
+        if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            fail(errno);
+            break;
+        }
+
+        struct pollfd pfd = {fd, POLLOUT, 0};
+        if (poll(&pfd, 1, POSIX_SERIAL_WRITE_TIMEOUT) <= 0)
+        {
+            fail(ETIMEDOUT);
+            break;
+        }
+    }
+
+    memmove(txBuffer, txBuffer + sent, txLength - sent); ///< Keep what was not sent for the next try
+    txLength -= sent;
+    return txLength == 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief Record a failure
+    @param error errno value
+*/
+/**************************************************************************/
+void Posix_Serial::fail(int error) { this->error = error; }
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef __POSIX_SERIAL_H__
+#define __POSIX_SERIAL_H__
+
+#if defined(__unix__) || defined(__APPLE__) ///< Linux gateways and other POSIX hosts, not microcontrollers
+
+#include <Arduino.h>
+
+#ifndef POSIX_SERIAL_RX_SIZE
+#define POSIX_SERIAL_RX_SIZE 256 ///< bytes taken from the port with one read()
+#endif
+
+#ifndef POSIX_SERIAL_TX_SIZE
+#define POSIX_SERIAL_TX_SIZE 256 ///< bytes collected before they are written to the port
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Serial port of a POSIX host, e.g. /dev/ttyUSB0 on a Linux gateway,
+   as a Stream for the Stream constructor of MC60, MC60_GNSS or
+   Serial_Command_Handler. The port is put in raw mode with termios and read
+   without blocking. Written bytes are collected and sent with one write()
+   when POSIX_SERIAL_TX_SIZE bytes are waiting, on flush(), or as soon as the
+   port is read, so a command goes out in one system call.
+*/
+/**************************************************************************/
+class Posix_Serial : public Stream
+{
+public:
+    ~Posix_Serial();
+
+    bool open(const char *path, uint32_t baud, bool hardwareFlowControl = false);
+    bool attach(int fd, uint32_t baud, bool hardwareFlowControl = false);
+    bool begin(uint32_t baud);
+    void close(void);
+    bool isOpen(void);
+    int getFD(void);
+    int getError(void);
+
+    int available(void);
+    int read(void);
+    int peek(void);
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    void flush(void);
+
+private:
+    bool configure(uint32_t baud, bool hardwareFlowControl);
+    bool fill(void);
+    bool drain(void);
+    void fail(int error);
+
+    int fd = -1;                               ///< Port file descriptor, -1 when closed
+    int error = 0;                             ///< errno of the last failure, 0 if none
+    uint8_t rxBuffer[POSIX_SERIAL_RX_SIZE];    ///< Bytes read from the port
+    uint16_t rxHead = 0;                       ///< Bytes in rxBuffer
+    uint16_t rxTail = 0;                       ///< Next byte to return from rxBuffer
+    uint8_t txBuffer[POSIX_SERIAL_TX_SIZE];    ///< Bytes for the next write()
+    uint16_t txLength = 0;                     ///< Bytes in txBuffer
+};
+
+#endif
+
+#endif
@@ -0,0 +1,380 @@
+#include "SMS_PDU.h"
+
+#define GSM7_ESCAPE 0x1B       ///< switches the next septet to the extension table
+#define GSM7_EXTENDED 0x100    ///< added by gsmSeptet() to extension table septets
+#define UNICODE_INVALID 0xFFFD ///< replaces malformed UTF-8
+
+/// Unicode code point of each GSM 03.38 default alphabet septet, 0xFFFF for the escape
+static const uint16_t gsmAlphabet[128] PROGMEM = {
+    0x0040, 0x00A3, 0x0024, 0x00A5, 0x00E8, 0x00E9, 0x00F9, 0x00EC, 0x00F2, 0x00C7, 0x000A, 0x00D8, 0x00F8, 0x000D, 0x00C5, 0x00E5,
+    0x0394, 0x005F, 0x03A6, 0x0393, 0x039B, 0x03A9, 0x03A0, 0x03A8, 0x03A3, 0x0398, 0x039E, 0xFFFF, 0x00C6, 0x00E6, 0x00DF, 0x00C9,
+    0x0020, 0x0021, 0x0022, 0x0023, 0x00A4, 0x0025, 0x0026, 0x0027, 0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+    0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037, 0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+    0x00A1, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047, 0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+    0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058, 0x0059, 0x005A, 0x00C4, 0x00D6, 0x00D1, 0x00DC, 0x00A7,
+    0x00BF, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067, 0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+    0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x00E4, 0x00F6, 0x00F1, 0x00FC, 0x00E0};
+
+/**************************************************************************/
+/*!
+    @brief Decode one UTF-8 character
+    @param p Pointer into the text, advanced past the character
+    @returns Code point, UNICODE_INVALID for malformed sequences
+*/
+/**************************************************************************/
+static uint32_t nextCodePoint(const char *&p)
+{
+    uint8_t c = *p++;
+    uint8_t extra;
+    uint32_t cp;
+
+    if (c < 0x80)
+        return c;
+    else if ((c & 0xE0) == 0xC0)
+    {
+        extra = 1;
+        cp = c & 0x1F;
+    }
+    else if ((c & 0xF0) == 0xE0)
+    {
+        extra = 2;
+        cp = c & 0x0F;
+    }
+    else if ((c & 0xF8) == 0xF0)
+    {
+        extra = 3;
+        cp = c & 0x07;
+    }
+    else
+        return UNICODE_INVALID;
+
+    while (extra--)
+    {
+        if ((*p & 0xC0) != 0x80) ///< Also stops at the terminator
+            return UNICODE_INVALID;
+        cp = (cp << 6) | (*p++ & 0x3F);
+    }
+
+    return cp;
+}
+
+/**************************************************************************/
+/*!
+    @brief Find the GSM 7-bit septet of a character
+    @param cp Code point
+    @returns Septet, GSM7_EXTENDED plus the septet for the extension table, or
+   -1 if the character has no GSM 7-bit encoding
+*/
+/**************************************************************************/
+static int16_t gsmSeptet(uint32_t cp)
+{
+    if ((cp >= 'A' && cp <= 'Z') || (cp >= 'a' && cp <= 'z') || (cp >= '%' && cp <= '?') || (cp >= ' ' && cp <= '#'))
+        return cp; ///< Same as ASCII
+
+    switch (cp)
+    {
+    case '\f':
+        return GSM7_EXTENDED | 0x0A;
+    case '^':
+        return GSM7_EXTENDED | 0x14;
+    case '{':
+        return GSM7_EXTENDED | 0x28;
+    case '}':
+        return GSM7_EXTENDED | 0x29;
+    case '\\':
+        return GSM7_EXTENDED | 0x2F;
+    case '[':
+        return GSM7_EXTENDED | 0x3C;
+    case '~':
+        return GSM7_EXTENDED | 0x3D;
+    case ']':
+        return GSM7_EXTENDED | 0x3E;
+    case '|':
+        return GSM7_EXTENDED | 0x40;
+    case 0x20AC: ///< Euro sign
+        return GSM7_EXTENDED | 0x65;
+    }
+
+    if (cp < 0xFFFF)
+        for (uint8_t i = 0; i < 128; i++)
+            if (pgm_read_word(&gsmAlphabet[i]) == cp)
+                return i;
+
+    return -1;
+}
+
+/**************************************************************************/
+/*!
+    @brief Get how much room a character takes in a part
+    @param cp Code point
+    @param ucs2 Set to true for UCS2, false for GSM 7-bit
+    @returns Septets or UTF-16 units
+*/
+/**************************************************************************/
+static uint8_t unitsOf(uint32_t cp, bool ucs2)
+{
+    if (ucs2)
+        return cp > 0xFFFF ? 2 : 1;
+    return gsmSeptet(cp) >= GSM7_EXTENDED ? 2 : 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief Write one octet as two hex digits
+    @param out Where to write
+    @param octet Octet to write
+*/
+/**************************************************************************/
+static void writeOctet(Print &out, uint8_t octet)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    out.write(hex[octet >> 4]);
+    out.write(hex[octet & 0x0F]);
+}
+
+/**************************************************************************/
+/*!
+    @brief Prepare a message. The number and text are not copied and must stay
+   valid until the last part is written.
+    @param number Destination, digits with an optional leading '+'
+    @param text UTF-8 text
+    @param reference Concatenation reference, should change for every message
+    @returns True if the message can be sent, False if the number is invalid or
+   the text needs more than 255 parts
+*/
+/**************************************************************************/
+bool SMS_PDU_Encoder::begin(const char *number, const char *text, uint8_t reference)
+{
+    const char *p;
+    uint16_t total = 0;
+
+    this->number = number;
+    this->reference = reference;
+    cursor = segmentEnd = text;
+    segment = units = 0;
+    segments = 0;
+
+    p = number[0] == '+' ? number + 1 : number;
+    for (digits = 0; p[digits]; digits++)
+        if (p[digits] < '0' || p[digits] > '9' || digits >= SMS_PDU_MAX_DIGITS)
+            return false;
+    if (digits == 0)
+        return false;
+
+    ucs2 = false;
+    for (p = text; *p && !ucs2;)
+        ucs2 = gsmSeptet(nextCodePoint(p)) < 0;
+
+    for (p = text; *p && total <= SMS_GSM7_SINGLE;)
+        total += unitsOf(nextCodePoint(p), ucs2);
+
+    if (total <= (ucs2 ? SMS_UCS2_SINGLE : SMS_GSM7_SINGLE))
+    {
+        segments = 1;
+        return true;
+    }
+
+    uint8_t limit = ucs2 ? SMS_UCS2_SEGMENT : SMS_GSM7_SEGMENT;
+    uint8_t used = 0;
+
+    segments = 1;
+    for (p = text; *p;)
+    {
+        uint8_t size = unitsOf(nextCodePoint(p), ucs2);
+        if (used + size > limit)
+        {
+            if (segments == 255)
+            {
+                segments = 0;
+                return false;
+            }
+            segments++;
+            used = 0;
+        }
+        used += size;
+    }
+
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Get how many parts the message needs
+    @returns Number of parts, 0 if begin() failed
+*/
+/**************************************************************************/
+uint8_t SMS_PDU_Encoder::getSegmentCount(void) { return segments; }
+
+/**************************************************************************/
+/*!
+    @brief Check which alphabet the message uses
+    @returns True for UCS2, False for GSM 7-bit
+*/
+/**************************************************************************/
+bool SMS_PDU_Encoder::isUCS2(void) { return ucs2; }
+
+/**************************************************************************/
+/*!
+    @brief Move to the next part
+    @returns True if there is a part to write, False after the last one
+*/
+/**************************************************************************/
+bool SMS_PDU_Encoder::nextSegment(void)
+{
+    if (segment >= segments)
+        return false;
+
+    segment++;
+    cursor = segmentEnd;
+    units = 0;
+
+    uint8_t limit = concatenated() ? (ucs2 ? SMS_UCS2_SEGMENT : SMS_GSM7_SEGMENT) : (ucs2 ? SMS_UCS2_SINGLE : SMS_GSM7_SINGLE);
+    const char *p = cursor;
+
+    while (*p)
+    {
+        const char *next = p;
+        uint8_t size = unitsOf(nextCodePoint(next), ucs2);
+        if (units + size > limit)
+            break;
+        units += size;
+        p = next;
+    }
+
+    segmentEnd = p;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Get the length to give to AT+CMGS for the current part
+    @returns TPDU length in octets, not counting the SMSC field
+*/
+/**************************************************************************/
+uint8_t SMS_PDU_Encoder::getLength(void)
+{
+    bool header = concatenated();
+    uint8_t userData;
+
+    if (ucs2)
+        userData = (header ? 6 : 0) + units * 2;
+    else
+        userData = (((header ? 7 : 0) + units) * 7 + 7) / 8; ///< Septets packed into octets
+
+    return 7 + (digits + 1) / 2 + userData; ///< First octet, MR, address length, TOA, PID, DCS, UDL
+}
+
+/**************************************************************************/
+/*!
+    @brief Write the current part as hex, starting with an empty SMSC field so
+   the SIM's service centre is used
+    @param out Where to write, e.g. the MC60 after the "> " prompt
+*/
+/**************************************************************************/
+void SMS_PDU_Encoder::write(Print &out)
+{
+    bool header = concatenated();
+    const char *p = number[0] == '+' ? number + 1 : number;
+
+    writeOctet(out, 0x00);                 ///< SMSC from the SIM
+    writeOctet(out, header ? 0x41 : 0x01); ///< SMS-SUBMIT, UDHI when concatenated
+    writeOctet(out, 0x00);                 ///< Message reference set by the modem
+    writeOctet(out, digits);
+    writeOctet(out, number[0] == '+' ? 0x91 : 0x81); ///< International or unknown numbering
+    for (uint8_t i = 0; i < digits; i += 2)
+        writeOctet(out, (p[i] - '0') | ((i + 1 < digits ? p[i + 1] - '0' : 0x0F) << 4));
+    writeOctet(out, 0x00);               ///< Protocol identifier
+    writeOctet(out, ucs2 ? 0x08 : 0x00); ///< Data coding scheme
+
+    if (ucs2)
+        writeOctet(out, (header ? 6 : 0) + units * 2);
+    else
+        writeOctet(out, (header ? 7 : 0) + units);
+
+    if (header)
+    {
+        writeOctet(out, 0x05); ///< Header length
+        writeOctet(out, 0x00); ///< Concatenated message, 8-bit reference
+        writeOctet(out, 0x03);
+        writeOctet(out, reference);
+        writeOctet(out, segments);
+        writeOctet(out, segment);
+    }
+
+    uint16_t bits = 0;
+    uint8_t used = header ? 1 : 0; ///< The 48 header bits leave one fill bit before the first septet
+
+    for (p = cursor; p < segmentEnd;)
+    {
+        uint32_t cp = nextCodePoint(p);
+
+        if (ucs2)
+        {
+            if (cp > 0xFFFF) ///< Surrogate pair
+            {
+                cp -= 0x10000;
+                uint16_t high = 0xD800 | (cp >> 10);
+                writeOctet(out, high >> 8);
+                writeOctet(out, high & 0xFF);
+                cp = 0xDC00 | (cp & 0x3FF);
+            }
+            writeOctet(out, cp >> 8);
+            writeOctet(out, cp & 0xFF);
+            continue;
+        }
+
+        int16_t septet = gsmSeptet(cp);
+        for (uint8_t n = septet >= GSM7_EXTENDED ? 2 : 1; n; n--)
+        {
+            bits |= (uint16_t)((n == 2 ? GSM7_ESCAPE : septet) & 0x7F) << used;
+            used += 7;
+            if (used >= 8)
+            {
+                writeOctet(out, bits & 0xFF);
+                bits >>= 8;
+                used -= 8;
+            }
+        }
+    }
+
+    if (!ucs2 && used)
+        writeOctet(out, bits & 0xFF);
+}
+
+/**************************************************************************/
+/*!
+    @brief Check if a text can not be sent as one text mode SMS with the GSM
+   character set
+    @param text UTF-8 text
+    @returns True if it has characters outside ASCII, ASCII characters the GSM
+   7-bit default alphabet lacks such as '`', or more than one SMS of septets,
+   counting extension table characters such as '{' as two
+*/
+/**************************************************************************/
+bool SMS_PDU_Encoder::needsPDU(const char *text)
+{
+    uint16_t septets = 0;
+
+    for (; *text; text++)
+    {
+        int16_t septet = (uint8_t)*text < 0x80 ? gsmSeptet((uint8_t)*text) : -1;
+
+        if (septet < 0)
+            return true;
+
+        septets += septet >= GSM7_EXTENDED ? 2 : 1;
+        if (septets > SMS_GSM7_SINGLE)
+            return true;
+    }
+
+    return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief Check if the message is split into parts
+    @returns True if the parts carry a concatenation header
+*/
+/**************************************************************************/
+bool SMS_PDU_Encoder::concatenated(void) { return segments > 1; }
@@ -0,0 +1,47 @@
+#ifndef __SMS_PDU_H__
+#define __SMS_PDU_H__
+
+#include <Arduino.h>
+
+#define SMS_PDU_MAX_DIGITS 20 ///< longest destination address, in digits
+
+#define SMS_GSM7_SINGLE 160  ///< septets in a GSM 7-bit SMS
+#define SMS_GSM7_SEGMENT 153 ///< septets in each part of a concatenated GSM 7-bit SMS
+#define SMS_UCS2_SINGLE 70   ///< UTF-16 units in a UCS2 SMS
+#define SMS_UCS2_SEGMENT 67  ///< UTF-16 units in each part of a concatenated UCS2 SMS
+
+/**************************************************************************/
+/*!
+    @brief  Encoder for SMS-SUBMIT PDUs. Picks GSM 7-bit or UCS2 for a UTF-8
+   text, splits it into concatenated parts when needed, and writes each part
+   as hex straight from the caller's text, so nothing is copied.
+*/
+/**************************************************************************/
+class SMS_PDU_Encoder
+{
+public:
+    bool begin(const char *number, const char *text, uint8_t reference);
+    uint8_t getSegmentCount(void);
+    bool isUCS2(void);
+
+    bool nextSegment(void);
+    uint8_t getLength(void);
+    void write(Print &out);
+
+    static bool needsPDU(const char *text);
+
+private:
+    bool concatenated(void);
+
+    const char *number = NULL;     ///< Destination, digits with an optional leading '+'
+    const char *cursor = NULL;     ///< Start of the current part in the text
+    const char *segmentEnd = NULL; ///< End of the current part in the text
+    uint8_t digits = 0;            ///< Digits in number
+    uint8_t reference = 0;         ///< Concatenation reference shared by the parts
+    uint8_t segments = 0;          ///< Number of parts
+    uint8_t segment = 0;           ///< Current part, 1 based, 0 before nextSegment()
+    uint8_t units = 0;             ///< Septets or UTF-16 units in the current part
+    bool ucs2 = false;             ///< Text needs UCS2
+};
+
+#endif
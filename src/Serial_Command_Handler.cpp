@@ -1,19 +1,63 @@
 #include "Serial_Command_Handler.h"
 
+#if defined(__AVR__) && defined(USE_RX_ISR)
+#define RX_LOCK() noInterrupts() ///< receive() runs in an interrupt and AVR accesses wider than a byte are not atomic
+#define RX_UNLOCK() interrupts()
+#else
+#define RX_LOCK()
+#define RX_UNLOCK()
+#endif
+
+#if (defined(__AVR__) || defined(ESP8266)) && defined(USE_SW_SERIAL)
+/**************************************************************************/
+/*!
+    @brief Start a SoftwareSerial transport
+    @param transport The SoftwareSerial given to the constructor
+    @param baud Baud rate
+*/
+/**************************************************************************/
+static void beginSoftwareSerial(Stream *transport, uint32_t baud)
+{
+    static_cast<SoftwareSerial *>(transport)->begin(baud);
+}
+#endif
+
+/**************************************************************************/
+/*!
+    @brief Read one character of a command or pattern kept in RAM or in flash
+    @param cmd The command
+    @param index Position of the character
+    @param flash True if cmd is in flash
+    @return The character
+*/
+/**************************************************************************/
+static char commandChar(const char *cmd, uint8_t index, bool flash)
+{
+    return flash ? (char)pgm_read_byte(cmd + index) : cmd[index];
+}
+
+/**************************************************************************/
+/*!
+    @brief Start a HardwareSerial transport
+    @param transport The HardwareSerial given to the constructor
+    @param baud Baud rate
+*/
+/**************************************************************************/
+static void beginHardwareSerial(Stream *transport, uint32_t baud)
+{
+    static_cast<HardwareSerial *>(transport)->begin(baud);
+}
+
 /**************************************************************************/
 /*!
-    @brief Start the HW or SW serial port
+    @brief Start the HW or SW serial port, other Streams are left alone
     @param baud Baud rate for serial communication
 */
 /**************************************************************************/
 void Serial_Command_Handler::begin(uint32_t baud)
 {
-#if (defined(__AVR__) || defined(ESP8266)) && defined(USE_SW_SERIAL)
-    if (SwSerial)
-        SwSerial->begin(baud);
-#endif
-    if (HwSerial)
-        HwSerial->begin(baud);
+    if (beginTransport)
+        beginTransport(transport, baud);
 }
 
 /**************************************************************************/
@@ -26,7 +70,8 @@ void Serial_Command_Handler::begin(uint32_t baud)
 Serial_Command_Handler::Serial_Command_Handler(SoftwareSerial *ser)
 {
     common_init();
-    SwSerial = ser;
+    transport = ser;
+    beginTransport = beginSoftwareSerial;
 }
 #endif
 
@@ -39,7 +84,21 @@ Serial_Command_Handler::Serial_Command_Handler(SoftwareSerial *ser)
 Serial_Command_Handler::Serial_Command_Handler(HardwareSerial *ser)
 {
     common_init();
-    HwSerial = ser;
+    transport = ser;
+    beginTransport = beginHardwareSerial;
+}
+
+/**************************************************************************/
+/*!
+    @brief Constructor for any other Stream, e.g. a simulator or a USB CDC port.
+   The stream is expected to be started by its owner, begin() leaves it alone.
+    @param ser Pointer to a Stream object
+*/
+/**************************************************************************/
+Serial_Command_Handler::Serial_Command_Handler(Stream *ser)
+{
+    common_init();
+    transport = ser;
 }
 
 /**************************************************************************/
@@ -62,12 +121,11 @@ Serial_Command_Handler::~Serial_Command_Handler() = default;
 /**************************************************************************/
 void Serial_Command_Handler::common_init(void)
 {
-#if (defined(__AVR__) || defined(ESP8266)) && defined(USE_SW_SERIAL)
-    SwSerial = NULL;
-#endif
-    HwSerial = NULL;
     lineidx = 0;
     paused = false;
+
+    for (uint8_t i = 0; i < COMMAND_QUEUE_SIZE; i++)
+        completedHandles[i] = 0;
 }
 
 /**************************************************************************/
@@ -82,13 +140,133 @@ size_t Serial_Command_Handler::available(void)
     if (paused)
         return 0;
 
-#if (defined(__AVR__) || defined(ESP8266)) && defined(USE_SW_SERIAL)
-    if (SwSerial)
-        return SwSerial->available();
+    service();
+    return rxCount();
+}
+
+/**************************************************************************/
+/*!
+    @brief Move received bytes from the transport into the RX ring buffer.
+   Called on every available() and read(), call it from loop(), yield() or
+   serialEvent() as well to keep the transport's own small buffer from
+   overflowing while the sketch is busy elsewhere. Does nothing with
+   USE_RX_ISR, where an interrupt handler calls receive() instead.
+*/
+/**************************************************************************/
+void Serial_Command_Handler::service(void)
+{
+#ifndef USE_RX_ISR
+    if (transport == NULL)
+        return;
+
+    while (transport->available())
+        receive(transport->read());
 #endif
-    if (HwSerial)
-        return HwSerial->available();
-    return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief Store one received byte in the RX ring buffer. Call it from the
+   receive interrupt handler with USE_RX_ISR, it must not be called from
+   anywhere else then. Without USE_RX_ISR only service() calls it.
+    @param c Received byte
+*/
+/**************************************************************************/
+void Serial_Command_Handler::receive(uint8_t c)
+{
+    rx_index_t head = rxHead;
+    rx_index_t count = (rx_index_t)(head - rxTail);
+
+    if (count >= RX_BUFFER_SIZE)
+    {
+        rxOverflowBytes++;
+        rxLineDamaged = true;
+        return;
+    }
+
+    rxBuffer[head & (RX_BUFFER_SIZE - 1)] = c;
+    rxHead = head + 1;
+
+    if (++count > rxHighWater)
+        rxHighWater = count;
+
+    if (c == '\n' && rxLineDamaged)
+    {
+        rxDroppedLines++;
+        rxLineDamaged = false;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Number of bytes waiting in the RX ring buffer
+    @return Bytes buffered
+*/
+/**************************************************************************/
+Serial_Command_Handler::rx_index_t Serial_Command_Handler::rxCount(void)
+{
+    RX_LOCK();
+    rx_index_t head = rxHead;
+    RX_UNLOCK();
+    return (rx_index_t)(head - rxTail);
+}
+
+/**************************************************************************/
+/*!
+    @brief Highest number of bytes the RX ring buffer has held
+    @return High-water mark in bytes, compare with RX_BUFFER_SIZE
+*/
+/**************************************************************************/
+uint16_t Serial_Command_Handler::getRxHighWater(void)
+{
+    RX_LOCK();
+    uint16_t value = rxHighWater;
+    RX_UNLOCK();
+    return value;
+}
+
+/**************************************************************************/
+/*!
+    @brief Number of received bytes dropped because the RX ring buffer was full
+    @return Dropped bytes
+*/
+/**************************************************************************/
+uint32_t Serial_Command_Handler::getRxOverflowBytes(void)
+{
+    RX_LOCK();
+    uint32_t value = rxOverflowBytes;
+    RX_UNLOCK();
+    return value;
+}
+
+/**************************************************************************/
+/*!
+    @brief Number of lines that lost bytes to an RX ring buffer overflow
+    @return Damaged lines
+*/
+/**************************************************************************/
+uint16_t Serial_Command_Handler::getRxDroppedLines(void)
+{
+    RX_LOCK();
+    uint16_t value = rxDroppedLines;
+    RX_UNLOCK();
+    return value;
+}
+
+/**************************************************************************/
+/*!
+    @brief Reset the RX ring buffer counters
+*/
+/**************************************************************************/
+void Serial_Command_Handler::resetRxStatistics(void)
+{
+    rx_index_t count = rxCount();
+
+    RX_LOCK();
+    rxHighWater = count;
+    rxOverflowBytes = 0;
+    rxDroppedLines = 0;
+    RX_UNLOCK();
 }
 
 /**************************************************************************/
@@ -101,13 +279,31 @@ size_t Serial_Command_Handler::available(void)
 /**************************************************************************/
 size_t Serial_Command_Handler::write(uint8_t byte)
 {
-#if (defined(__AVR__) || defined(ESP8266)) && defined(USE_SW_SERIAL)
-    if (SwSerial)
-        return SwSerial->write(byte);
+#ifdef USE_COMMAND_STATS
+    if (statsIdx >= 0)
+        stats[statsIdx].bytesTx++;
 #endif
-    if (HwSerial)
-        return HwSerial->write(byte);
-    return 0;
+
+    return transport ? transport->write(byte) : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief Write a block of bytes to the underlying transport in one call -
+   part of 'Print'-class functionality
+    @param buffer Bytes to send
+    @param size Number of bytes
+    @return Bytes written
+*/
+/**************************************************************************/
+size_t Serial_Command_Handler::write(const uint8_t *buffer, size_t size)
+{
+#ifdef USE_COMMAND_STATS
+    if (statsIdx >= 0)
+        stats[statsIdx].bytesTx += size;
+#endif
+
+    return transport ? transport->write(buffer, size) : 0;
 }
 
 /**************************************************************************/
@@ -120,13 +316,12 @@ size_t Serial_Command_Handler::write(uint8_t byte)
 /**************************************************************************/
 size_t Serial_Command_Handler::write(const char *cmd)
 {
-#if (defined(__AVR__) || defined(ESP8266)) && defined(USE_SW_SERIAL)
-    if (SwSerial)
-        return SwSerial->write(cmd);
+#ifdef USE_COMMAND_STATS
+    if (statsIdx >= 0)
+        stats[statsIdx].bytesTx += strlen(cmd);
 #endif
-    if (HwSerial)
-        return HwSerial->write(cmd);
-    return 0;
+
+    return transport ? transport->write(cmd) : 0;
 }
 
 /**************************************************************************/
@@ -142,6 +337,33 @@ size_t Serial_Command_Handler::write(String cmd)
     return write(cmd.c_str());
 }
 
+/**************************************************************************/
+/*!
+    @brief Write a string kept in flash (PROGMEM on AVR) to the underlying
+   transport, in blocks so it is never copied to RAM as a whole
+    @param text Null terminated string in flash
+    @return Bytes written
+*/
+/**************************************************************************/
+size_t Serial_Command_Handler::write_P(const char *text)
+{
+    uint8_t block[16];
+    size_t written = 0;
+
+    for (;;)
+    {
+        uint8_t length = 0;
+        while (length < sizeof(block) && (block[length] = pgm_read_byte(text + length)) != '\0')
+            length++;
+
+        if (length > 0)
+            written += write(block, length);
+        if (length < sizeof(block))
+            return written;
+        text += length;
+    }
+}
+
 /**************************************************************************/
 /*!
     @brief Flush the input buffer - part of 'Print'-class functionality
@@ -149,48 +371,70 @@ size_t Serial_Command_Handler::write(String cmd)
 /**************************************************************************/
 void Serial_Command_Handler::flush(void)
 {
-#if (defined(__AVR__) || defined(ESP8266)) && defined(USE_SW_SERIAL)
-    while (SwSerial && available())
-        SwSerial->read();
-#endif
-    while (HwSerial && available())
-        HwSerial->read();
+    service();
+    RX_LOCK();
+    rxTail = rxHead;
+    RX_UNLOCK();
 }
 
 /**************************************************************************/
 /*!
-    @brief Read one character.
+    @brief Read one character of a response. Complete lines are checked for
+   unsolicited result codes, which go to their handler or to the queue of
+   readUnsolicited(), see wasUnsolicited().
     @return The character that we received, or 0 if nothing was available
 */
 /**************************************************************************/
 char Serial_Command_Handler::read(void)
 {
-    char c = 0;
+    char c = readByte();
+    if (c != '\0') ///< Nothing available, or a NUL that no line cares about
+        collectLine(c);
+    return c;
+}
+
+/**************************************************************************/
+/*!
+    @brief Check if the line ended by the last read() was an unsolicited
+   result code. It has been handed to its handler or queued, so code reading
+   a response by hand skips it.
+    @return True if the last complete line was unsolicited
+*/
+/**************************************************************************/
+bool Serial_Command_Handler::wasUnsolicited(void) { return urcTaken; }
 
+/**************************************************************************/
+/*!
+    @brief Read one character without looking for unsolicited lines, for
+   streams that carry no AT responses such as CMUX frames or raw NMEA
+    @return The character that we received, or 0 if nothing was available
+*/
+/**************************************************************************/
+char Serial_Command_Handler::readByte(void)
+{
     if (paused || noComms)
         return 0;
 
-#if (defined(__AVR__) || defined(ESP8266)) && defined(USE_SW_SERIAL)
-    if (SwSerial)
-    {
-        if (!SwSerial->available())
-            return 0;
-        c = SwSerial->read();
-    }
+    service();
+    if (rxCount() == 0)
+        return 0;
+
+#ifdef USE_COMMAND_STATS
+    if (statsIdx >= 0)
+        stats[statsIdx].bytesRx++;
 #endif
-    if (HwSerial)
-    {
-        if (!HwSerial->available())
-            return 0;
-        c = HwSerial->read();
-    }
 
+    rx_index_t tail = rxTail;
+    char c = rxBuffer[tail & (RX_BUFFER_SIZE - 1)];
+    RX_LOCK();
+    rxTail = tail + 1;
+    RX_UNLOCK();
     return c;
 }
 
 /**************************************************************************/
 /*!
-    @brief Read one line.
+    @brief Read one line, unsolicited lines are handed on and skipped
     @param timeout How long to wait in milliseconds (optional)
     @param length Max characters to read (optional)
     @return The string that we received, or empty string if nothing was available
@@ -212,6 +456,13 @@ String Serial_Command_Handler::readline(unsigned long timeout, uint8_t length)
             if (c == '\r')
                 continue;
 
+            if (c == '\n' && wasUnsolicited())
+            {
+                sbuffer = "";
+                lineidx = 0;
+                continue;
+            }
+
             if (c == '\n')
                 return sbuffer;
 
@@ -226,7 +477,60 @@ String Serial_Command_Handler::readline(unsigned long timeout, uint8_t length)
 
 /**************************************************************************/
 /*!
-    @brief Read one line.
+    @brief Read one line into a caller supplied buffer, without allocating.
+   Unsolicited lines are handed on and skipped.
+    @param dest Buffer to store the line in, always null terminated
+    @param length Size of the buffer
+    @param timeout How long to wait in milliseconds (optional)
+    @return Number of characters stored, 0 on timeout or if nothing was available
+*/
+/**************************************************************************/
+size_t Serial_Command_Handler::readline(char *dest, uint8_t length, unsigned long timeout)
+{
+    unsigned long startTime = millis();
+    uint8_t idx = 0;
+    char c = 0;
+
+    if (length == 0)
+        return 0;
+
+    dest[0] = '\0';
+
+    while (millis() - startTime < timeout)
+    {
+        if (available())
+        {
+            c = read();
+
+            if (c == '\r')
+                continue;
+
+            if (c == '\n' && wasUnsolicited())
+            {
+                idx = 0;
+                dest[0] = '\0';
+                continue;
+            }
+
+            if (c == '\n')
+                return idx;
+
+            dest[idx++] = c;
+            dest[idx] = '\0';
+
+            if (idx >= length - 1)
+                return idx;
+        }
+    }
+
+    dest[0] = '\0';
+    return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief Read what lies between two characters, starting over after an
+   unsolicited line
     @param first The first character to match
     @param last The last character to match
     @param timeout How long to wait in milliseconds (optional)
@@ -249,10 +553,19 @@ char *Serial_Command_Handler::readbetween(const char first, const char last, uns
         {
             c = read();
 
-            if (!firstEncounter && c == first)
-                firstEncounter = true;
-            else
+            if (c == '\n' && wasUnsolicited()) ///< Start over after an unsolicited line
+            {
+                cleanBuffer(buffer);
+                lineidx = 0;
+                firstEncounter = false;
+                continue;
+            }
+
+            if (!firstEncounter)
+            {
+                firstEncounter = c == first;
                 continue;
+            }
 
             if (c == last)
                 return buffer;
@@ -303,125 +616,602 @@ void Serial_Command_Handler::sendEndMarker(void) { write(26); }
 /**************************************************************************/
 bool Serial_Command_Handler::waitForOK(unsigned long timeout, uint8_t length)
 {
-    unsigned long startTime = millis();
-    lineidx = 0;
-
-    while (lineidx < length)
-    {
-        if (available())
-        {
-            buffer[lineidx] = read();
-            buffer[++lineidx] = '\0';
-
-            if (strstr(buffer, "OK") != NULL)
-            {
-                cleanBuffer(buffer, lineidx);
-                flush();
-                return true;
-            }
-        }
-
-        if (millis() - startTime >= timeout)
-            break;
-    }
-
-    cleanBuffer(buffer, lineidx);
-    flush();
-    return false;
+    return waitForResult(NULL, timeout, length) == RESULT_OK;
 }
 
 /**************************************************************************/
 /*!
-    @brief Wait for a specified sentence from the device
-    @param wait4me Pointer to a string holding the desired response
+    @brief Wait for an expected response or a final result code, whichever
+   comes first, so that errors return as soon as the modem reports them
+    @param response Pointer to a string holding the desired response, NULL to
+   wait for "OK" (optional)
     @param timeout How long to wait for a response in milliseconds (optional)
     @param length How many characters to wait (optional)
-    @return True if we got what we wanted, false otherwise
+    @return RESULT_OK if we got what we wanted, the error or timeout otherwise
 */
 /**************************************************************************/
-bool Serial_Command_Handler::waitForResponse(const char *wait4me, unsigned long timeout, uint8_t length)
+command_result Serial_Command_Handler::waitForResult(const char *response, unsigned long timeout, uint8_t length)
 {
-    unsigned long startTime = millis();
-    lineidx = 0;
-
-    while (lineidx < length)
-    {
-        if (available())
-        {
-            buffer[lineidx] = read();
-            buffer[++lineidx] = '\0';
-
-            if (strstr(buffer, wait4me) != NULL)
-            {
-                cleanBuffer(buffer, lineidx);
-                return true;
-            }
-        }
+    while (queueCount >= COMMAND_QUEUE_SIZE) ///< Let queued commands make room
+        poll();
 
-        if (millis() - startTime >= timeout)
-            break;
-    }
-
-    cleanBuffer(buffer, lineidx);
-    return false;
+    return runUntilDone(enqueue(NULL, response, timeout, length, NULL, NULL, NULL, 0));
 }
 
 /**************************************************************************/
 /*!
-    @brief Wait for a specified sentence from the device
-    @param wait4me String holding the desired response
+    @brief Send a command to the device and wait for its response or final result
+    @param cmd Pointer to a string holding the command to send
+    @param response Pointer to a string holding the desired response, NULL to
+   wait for "OK" (optional)
     @param timeout How long to wait for a response in milliseconds (optional)
     @param length How many characters to wait (optional)
-    @return True if we got what we wanted, false otherwise
+    @return RESULT_OK if we got what we wanted, the error or timeout otherwise
 */
 /**************************************************************************/
-bool Serial_Command_Handler::waitForResponse(String wait4me, unsigned long timeout, uint8_t length)
+command_result Serial_Command_Handler::sendCommand(const char *cmd, const char *response, unsigned long timeout, uint8_t length)
 {
-    return waitForResponse(wait4me.c_str(), timeout, length);
+    while (queueCount >= COMMAND_QUEUE_SIZE) ///< Let queued commands make room
+        poll();
+
+    return runUntilDone(enqueue(cmd, response, timeout, length, NULL, NULL, NULL, 0));
 }
 
 /**************************************************************************/
 /*!
-    @brief Send an user defined command to the device and wait for the response
-    @param cmd Pointer to a string holding the command to send
-    @param response Pointer to a string holding the desired response
+    @brief Wait for an expected response kept in flash (PROGMEM on AVR) or a
+   final result code, whichever comes first
+    @param response Pointer to the desired response in flash
     @param timeout How long to wait for a response in milliseconds (optional)
     @param length How many characters to wait (optional)
-    @return True if we got the response, false otherwise
+    @return RESULT_OK if we got what we wanted, the error or timeout otherwise
 */
 /**************************************************************************/
-bool Serial_Command_Handler::sendCommandWait(const char *cmd, const char *response, unsigned long timeout, uint8_t length)
+command_result Serial_Command_Handler::waitForResult_P(const char *response, unsigned long timeout, uint8_t length)
 {
-    write(cmd);
-    return waitForResponse(response, timeout, length);
+    while (queueCount >= COMMAND_QUEUE_SIZE) ///< Let queued commands make room
+        poll();
+
+    return runUntilDone(enqueue(NULL, response, timeout, length, NULL, NULL, NULL, 0, NULL, true));
 }
 
 /**************************************************************************/
 /*!
-    @brief Send an user defined command to the device and wait for the response
-    @param cmd String holding the command to send
-    @param response Pointer to a string holding the desired response
+    @brief Send a command kept in flash (PROGMEM on AVR) and wait for its
+   response or final result. Unlike an at_command, the command is written as
+   it is, so it carries its own "\r" if it needs one.
+    @param cmd Pointer to the command in flash
+    @param response Pointer to the desired response in flash, NULL to wait
+   for "OK" (optional)
     @param timeout How long to wait for a response in milliseconds (optional)
     @param length How many characters to wait (optional)
-    @return True if we got the response, false otherwise
+    @return RESULT_OK if we got what we wanted, the error or timeout otherwise
 */
 /**************************************************************************/
-bool Serial_Command_Handler::sendCommandWait(String cmd, const char *response, unsigned long timeout, uint8_t length)
+command_result Serial_Command_Handler::sendCommand_P(const char *cmd, const char *response, unsigned long timeout, uint8_t length)
 {
-    return sendCommandWait(cmd.c_str(), response, timeout, length);
+    while (queueCount >= COMMAND_QUEUE_SIZE) ///< Let queued commands make room
+        poll();
+
+    return runUntilDone(enqueue(cmd, response, timeout, length, NULL, NULL, NULL, 0, NULL, true));
 }
 
 /**************************************************************************/
 /*!
-    @brief Send an user defined command to the device and wait for the response
-    @param cmd Pointer to a string holding the command to send
-    @param response String holding the desired response
-    @param timeout How long to wait for a response in milliseconds (optional)
-    @param length How many characters to wait (optional)
-    @return True if we got the response, false otherwise
+    @brief Send a command kept in flash and wait for its response or final
+   result. The command is streamed from flash, followed by argument and "\r".
+   When the expected response arrives, the command's parser reads the rest.
+    @param cmd Command declared with AT_COMMAND()
+    @param argument Text written after the command, e.g. "3" for "AT+CMGR=",
+   must stay valid until it is sent (optional)
+    @param result Where the parser stores its value (optional)
+    @return RESULT_OK if we got what we wanted, RESULT_UNEXPECTED if the parser
+   could not read its value, the error or timeout otherwise
 */
 /**************************************************************************/
-bool Serial_Command_Handler::sendCommandWait(const char *cmd, String response, unsigned long timeout, uint8_t length)
+command_result Serial_Command_Handler::sendCommand(const at_command *cmd, const char *argument, void *result)
+{
+    at_command entry;
+    memcpy_P(&entry, cmd, sizeof(entry));
+
+    while (queueCount >= COMMAND_QUEUE_SIZE) ///< Let queued commands make room
+        poll();
+
+    command_result status = runUntilDone(enqueue(entry.command, entry.response, entry.timeout, MAXLINELENGTH, NULL, NULL,
+                                                 NULL, 0, argument ? argument : "", true));
+
+    if (status == RESULT_OK && entry.parser != NULL && !entry.parser(this, result))
+        status = lastResult = RESULT_UNEXPECTED;
+
+    return status;
+}
+
+/**************************************************************************/
+/*!
+    @brief Get the result of the last command
+    @return Result of the last waitForResult(), sendCommand() or sendCommandWait*()
+*/
+/**************************************************************************/
+command_result Serial_Command_Handler::getLastResult(void) { return lastResult; }
+
+/**************************************************************************/
+/*!
+    @brief Get the error code reported with the last +CME ERROR or +CMS ERROR
+    @return Numeric error code, -1 if the last command did not report one
+*/
+/**************************************************************************/
+int16_t Serial_Command_Handler::getLastErrorCode(void) { return lastErrorCode; }
+
+/**************************************************************************/
+/*!
+    @brief Queue a command to be sent and completed by poll() without blocking
+    @param cmd Pointer to a string holding the command to send, must stay valid
+   until the command completes
+    @param response Pointer to a string holding the desired response, NULL to
+   wait for "OK" (optional)
+    @param callback Function to call on completion (optional)
+    @param context Pointer passed to the callback (optional)
+    @param timeout How long to wait for a response in milliseconds (optional)
+    @param capture Buffer for the rest of the line following the response. If
+   given, the command completes on the final result instead of on the response
+   (optional)
+    @param captureLength Size of capture (optional)
+    @return Handle to check on the command, 0 if the queue is full
+*/
+/**************************************************************************/
+command_handle Serial_Command_Handler::queueCommand(const char *cmd, const char *response, command_callback callback, void *context,
+                                                    unsigned long timeout, char *capture, uint8_t captureLength)
+{
+    return enqueue(cmd, response, timeout, 0, callback, context, capture, captureLength);
+}
+
+/**************************************************************************/
+/*!
+    @brief Advance the queued commands and pick up unsolicited lines, call this
+   often from loop(). Only the bytes already received are processed, so it
+   never waits.
+*/
+/**************************************************************************/
+void Serial_Command_Handler::poll(void)
+{
+    if (queueCount == 0)
+    {
+#ifdef USE_COMMAND_STATS
+        if (statsOpen) ///< The caller read the rest of the response without waiting for its final result
+            recordCommandStats(RESULT_OK, statsEnd);
+#endif
+        drainUnsolicited();
+        return;
+    }
+
+    if (engineState == ENGINE_IDLE)
+        startCommand();
+
+    const queued_command &cmd = queue[queueHead];
+
+    while (engineState != ENGINE_IDLE && available())
+        processByte(readByte());
+
+    if (engineState == ENGINE_IDLE)
+        return;
+
+    if (millis() - commandStart >= cmd.timeout || (cmd.length && received >= cmd.length))
+        completeCommand(engineState == ENGINE_ERROR_CODE ? pendingResult : RESULT_TIMEOUT);
+}
+
+/**************************************************************************/
+/*!
+    @brief Check if a queued command is still waiting or running
+    @param handle Handle returned by queueCommand()
+    @return True if the command has not completed yet
+*/
+/**************************************************************************/
+bool Serial_Command_Handler::isPending(command_handle handle)
+{
+    for (uint8_t i = 0; i < queueCount; i++)
+        if (queue[(queueHead + i) % COMMAND_QUEUE_SIZE].handle == handle)
+            return true;
+
+    return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief Get the result of a queued command. Results are kept for the last
+   COMMAND_QUEUE_SIZE completed commands.
+    @param handle Handle returned by queueCommand()
+    @return Result of the command, RESULT_PENDING if it has not completed yet,
+   RESULT_TIMEOUT if the handle is unknown or too old
+*/
+/**************************************************************************/
+command_result Serial_Command_Handler::getResult(command_handle handle)
+{
+    if (isPending(handle))
+        return RESULT_PENDING;
+
+    for (uint8_t i = 0; i < COMMAND_QUEUE_SIZE; i++)
+        if (completedHandles[i] == handle)
+            return completedResults[i];
+
+    return RESULT_TIMEOUT;
+}
+
+/**************************************************************************/
+/*!
+    @brief Add a command to the end of the queue
+    @param cmd Command to send, NULL to only wait
+    @param response Expected response, NULL to wait for "OK"
+    @param timeout How long to wait in milliseconds
+    @param length How many characters to wait, 0 for no limit
+    @param callback Function to call on completion
+    @param context Pointer passed to the callback
+    @param capture Buffer for the rest of the response line
+    @param captureLength Size of capture
+    @param argument Written between a flash command and its "\r", NULL if the
+   command ends itself (optional)
+    @param flash True if cmd and response are in flash, see at_command
+   (optional, default = false)
+    @return Handle to check on the command, 0 if the queue is full
+*/
+/**************************************************************************/
+command_handle Serial_Command_Handler::enqueue(const char *cmd, const char *response, unsigned long timeout, uint8_t length,
+                                               command_callback callback, void *context, char *capture, uint8_t captureLength,
+                                               const char *argument, bool flash)
+{
+    if (queueCount >= COMMAND_QUEUE_SIZE)
+        return 0;
+
+    queued_command &entry = queue[(queueHead + queueCount++) % COMMAND_QUEUE_SIZE];
+    entry.command = cmd;
+    entry.response = response != NULL && commandChar(response, 0, flash) != '\0' ? response : NULL;
+    entry.argument = argument;
+    entry.flash = flash;
+    entry.capture = captureLength ? capture : NULL;
+    entry.captureLength = captureLength;
+    entry.timeout = timeout;
+    entry.length = length;
+    entry.callback = callback;
+    entry.context = context;
+    entry.handle = nextHandle;
+
+    if (++nextHandle == 0)
+        nextHandle = 1;
+
+    return entry.handle;
+}
+
+/**************************************************************************/
+/*!
+    @brief Poll until a command completes, the blocking API is built on this
+    @param handle Handle of the command
+    @return Result of the command
+*/
+/**************************************************************************/
+command_result Serial_Command_Handler::runUntilDone(command_handle handle)
+{
+    unsigned long startTime = millis();
+
+    while (isPending(handle))
+        poll();
+
+    waitTime += millis() - startTime;
+
+    return getResult(handle);
+}
+
+/**************************************************************************/
+/*!
+    @brief Send the command at the head of the queue and start waiting for it
+*/
+/**************************************************************************/
+void Serial_Command_Handler::startCommand(void)
+{
+    static const char finalResults[][sizeof("\n+CME ERROR: ")] PROGMEM = {"\nOK\r", "\nERROR\r", "\n+CME ERROR: ",
+                                                                          "\n+CMS ERROR: "};
+    const queued_command &cmd = queue[queueHead];
+
+    matcher.begin(NULL, 0);
+    responseIdx = matcher.add(cmd.response, cmd.flash) ? 1 : 0;
+    for (uint8_t i = 0; i < sizeof(finalResults) / sizeof(finalResults[0]); i++)
+        (void)matcher.add(finalResults[i], true);
+    (void)matcher.feed('\n'); ///< A final result may start right where the previous read stopped
+
+    responseSeen = false;
+    received = 0;
+    lastErrorCode = -1;
+
+#ifdef USE_COMMAND_STATS
+    bool followUp = statsOpen && cmd.command == NULL; ///< Waits for the rest of the response of the open class
+    if (statsOpen && !followUp)
+        recordCommandStats(RESULT_OK, statsEnd);
+    statsOpen = false;
+
+    if (!followUp)
+    {
+        statsIdx = findCommandStats(cmd.command, cmd.flash);
+        if (statsIdx >= 0 && statsIdx == statsFailedIdx)
+            stats[statsIdx].retries++;
+    }
+#endif
+
+    if (cmd.command && cmd.flash)
+    {
+        (void)write_P(cmd.command);
+        if (cmd.argument)
+        {
+            (void)write(cmd.argument);
+            (void)write((uint8_t)'\r');
+        }
+    }
+    else if (cmd.command)
+        write(cmd.command);
+
+    commandStart = millis();
+    engineState = ENGINE_WAITING;
+
+#ifdef USE_COMMAND_STATS
+    if (!followUp)
+        statsStart = commandStart;
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief Run one received character through the state machine of the
+   running command
+    @param c Received character
+*/
+/**************************************************************************/
+void Serial_Command_Handler::processByte(char c)
+{
+    const queued_command &cmd = queue[queueHead];
+    int8_t match;
+
+    received++;
+    collectLine(c);
+
+    switch (engineState)
+    {
+    case ENGINE_WAITING:
+        match = matcher.feed(c);
+
+        if (match < 0 || (match < responseIdx && responseSeen))
+            break;
+
+        if (match < responseIdx)
+        {
+            if (!cmd.capture)
+            {
+                completeCommand(RESULT_OK); ///< Leave the rest of the response for the caller
+                break;
+            }
+            responseSeen = true;
+            captured = 0;
+            cmd.capture[0] = '\0';
+            engineState = ENGINE_CAPTURING;
+        }
+        else if (match == responseIdx)
+            completeCommand(responseIdx && !responseSeen ? RESULT_UNEXPECTED : RESULT_OK);
+        else if (match - responseIdx == RESULT_ERROR)
+            completeCommand(RESULT_ERROR);
+        else
+        {
+            pendingResult = (command_result)(match - responseIdx);
+            lastErrorCode = 0;
+            engineState = ENGINE_ERROR_CODE;
+        }
+        break;
+
+    case ENGINE_CAPTURING:
+        if (c == '\r' || c == '\n')
+        {
+            engineState = ENGINE_WAITING;
+            (void)matcher.feed(c);
+        }
+        else if (captured < cmd.captureLength - 1)
+        {
+            cmd.capture[captured++] = c;
+            cmd.capture[captured] = '\0';
+        }
+        break;
+
+    case ENGINE_ERROR_CODE:
+        if (c >= '0' && c <= '9')
+            lastErrorCode = lastErrorCode * 10 + (c - '0');
+        else
+            completeCommand(pendingResult);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief Finish the running command, record its result and call its callback
+    @param result Final result of the command
+*/
+/**************************************************************************/
+void Serial_Command_Handler::completeCommand(command_result result)
+{
+    queued_command cmd = queue[queueHead];
+
+    engineState = ENGINE_IDLE;
+    queueHead = (queueHead + 1) % COMMAND_QUEUE_SIZE;
+    queueCount--;
+
+    completedHandles[completedIdx] = cmd.handle;
+    completedResults[completedIdx] = result;
+    completedIdx = (completedIdx + 1) % COMMAND_QUEUE_SIZE;
+    lastResult = result;
+
+#ifdef USE_COMMAND_STATS
+    if (result == RESULT_OK && cmd.response && !cmd.capture)
+    {
+        statsOpen = true; ///< The caller reads the rest, its bytes and follow-up wait still count
+        statsEnd = millis();
+    }
+    else
+        recordCommandStats(result, millis());
+#endif
+
+    if (result != RESULT_OK || cmd.capture || !cmd.response)
+        drainUnsolicited();
+    else
+        urcIdx = 0; ///< The rest of the line belongs to the caller
+
+    if (cmd.callback)
+        cmd.callback(result, cmd.context);
+}
+
+/**************************************************************************/
+/*!
+    @brief Wait for a specified sentence from the device
+    @param wait4me Pointer to a string holding the desired response
+    @param timeout How long to wait for a response in milliseconds (optional)
+    @param length How many characters to wait (optional)
+    @return True if we got what we wanted, false otherwise
+*/
+/**************************************************************************/
+bool Serial_Command_Handler::waitForResponse(const char *wait4me, unsigned long timeout, uint8_t length)
+{
+    return waitForResponses(&wait4me, 1, timeout, length) >= 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief Wait for any of several sentences from the device, checking every
+   incoming byte against all of them at once. Unsolicited lines in between
+   are handed on and do not match.
+    @param patterns Array of pointers to the desired responses
+    @param count Number of entries in patterns, at most MAX_RESPONSE_PATTERNS
+    @param timeout How long to wait for a response in milliseconds (optional)
+    @param length How many characters to wait (optional)
+    @return Index of the pattern that matched first, -1 on timeout
+*/
+/**************************************************************************/
+int8_t Serial_Command_Handler::waitForResponses(const char *const *patterns, uint8_t count, unsigned long timeout, uint8_t length)
+{
+    Response_Matcher matcher;
+    matcher.begin(patterns, count);
+    return waitForMatch(matcher, timeout, length);
+}
+
+/**************************************************************************/
+/*!
+    @brief Wait for a specified sentence kept in flash (PROGMEM on AVR)
+    @param wait4me Pointer to the desired response in flash
+    @param timeout How long to wait for a response in milliseconds (optional)
+    @param length How many characters to wait (optional)
+    @return True if we got what we wanted, false otherwise
+*/
+/**************************************************************************/
+bool Serial_Command_Handler::waitForResponse_P(const char *wait4me, unsigned long timeout, uint8_t length)
+{
+    Response_Matcher matcher;
+    (void)matcher.add(wait4me, true);
+    return waitForMatch(matcher, timeout, length) >= 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief Feed received bytes to a matcher until one of its patterns matches
+    @param matcher Matcher holding the desired responses
+    @param timeout How long to wait for a response in milliseconds
+    @param length How many characters to wait
+    @return Index of the pattern that matched first, -1 on timeout
+*/
+/**************************************************************************/
+int8_t Serial_Command_Handler::waitForMatch(Response_Matcher &matcher, unsigned long timeout, uint8_t length)
+{
+    unsigned long startTime = millis();
+    lineidx = 0;
+
+    while (lineidx < length)
+    {
+        if (available())
+        {
+            lineidx++;
+
+            char c = read();
+            if (c == '\n' && wasUnsolicited())
+            {
+                matcher.reset();
+                (void)matcher.feed('\n');
+                continue;
+            }
+
+            int8_t match = matcher.feed(c);
+            if (match >= 0)
+            {
+                urcIdx = 0; ///< The rest of the line belongs to the caller
+                return match;
+            }
+        }
+
+        if (millis() - startTime >= timeout)
+            break;
+    }
+
+    return -1;
+}
+
+/**************************************************************************/
+/*!
+    @brief Wait for a specified sentence from the device
+    @param wait4me String holding the desired response
+    @param timeout How long to wait for a response in milliseconds (optional)
+    @param length How many characters to wait (optional)
+    @return True if we got what we wanted, false otherwise
+*/
+/**************************************************************************/
+bool Serial_Command_Handler::waitForResponse(String wait4me, unsigned long timeout, uint8_t length)
+{
+    return waitForResponse(wait4me.c_str(), timeout, length);
+}
+
+/**************************************************************************/
+/*!
+    @brief Send an user defined command to the device and wait for the response
+    @param cmd Pointer to a string holding the command to send
+    @param response Pointer to a string holding the desired response
+    @param timeout How long to wait for a response in milliseconds (optional)
+    @param length How many characters to wait (optional)
+    @return True if we got the response, false otherwise
+*/
+/**************************************************************************/
+bool Serial_Command_Handler::sendCommandWait(const char *cmd, const char *response, unsigned long timeout, uint8_t length)
+{
+    return sendCommand(cmd, response, timeout, length) == RESULT_OK;
+}
+
+/**************************************************************************/
+/*!
+    @brief Send an user defined command to the device and wait for the response
+    @param cmd String holding the command to send
+    @param response Pointer to a string holding the desired response
+    @param timeout How long to wait for a response in milliseconds (optional)
+    @param length How many characters to wait (optional)
+    @return True if we got the response, false otherwise
+*/
+/**************************************************************************/
+bool Serial_Command_Handler::sendCommandWait(String cmd, const char *response, unsigned long timeout, uint8_t length)
+{
+    return sendCommandWait(cmd.c_str(), response, timeout, length);
+}
+
+/**************************************************************************/
+/*!
+    @brief Send an user defined command to the device and wait for the response
+    @param cmd Pointer to a string holding the command to send
+    @param response String holding the desired response
+    @param timeout How long to wait for a response in milliseconds (optional)
+    @param length How many characters to wait (optional)
+    @return True if we got the response, false otherwise
+*/
+/**************************************************************************/
+bool Serial_Command_Handler::sendCommandWait(const char *cmd, String response, unsigned long timeout, uint8_t length)
 {
     return sendCommandWait(cmd, response.c_str(), timeout, length);
 }
@@ -451,8 +1241,7 @@ bool Serial_Command_Handler::sendCommandWait(String cmd, String response, unsign
 /**************************************************************************/
 bool Serial_Command_Handler::sendCommandWaitOK(const char *cmd, unsigned long timeout)
 {
-    write(cmd);
-    return waitForOK(timeout);
+    return sendCommand(cmd, NULL, timeout) == RESULT_OK;
 }
 
 /**************************************************************************/
@@ -465,28 +1254,191 @@ bool Serial_Command_Handler::sendCommandWaitOK(const char *cmd, unsigned long ti
 /**************************************************************************/
 bool Serial_Command_Handler::sendCommandWaitOK(String cmd, unsigned long timeout)
 {
-    write(cmd.c_str());
-    return waitForOK(timeout);
+    return sendCommandWaitOK(cmd.c_str(), timeout);
 }
 
-void Serial_Command_Handler::ATBypass(void)
+#ifdef USE_COMMAND_STATS
+/**************************************************************************/
+/*!
+    @brief Number of command classes seen so far
+    @return Valid indexes for getCommandStats()
+*/
+/**************************************************************************/
+uint8_t Serial_Command_Handler::getCommandStatsCount(void) { return statsCount; }
+
+/**************************************************************************/
+/*!
+    @brief Get the counters of one command class. A command that completed on
+   its expected response is counted once the caller has waited for its final
+   result, or when the next command starts.
+    @param index Class index, below getCommandStatsCount()
+    @return Pointer to the counters, NULL if the index is out of range
+*/
+/**************************************************************************/
+const command_stats *Serial_Command_Handler::getCommandStats(uint8_t index)
 {
-#if (defined(__AVR__) || defined(ESP8266)) && defined(USE_SW_SERIAL)
-    if (SwSerial)
+    return index < statsCount ? &stats[index] : NULL;
+}
+
+/**************************************************************************/
+/*!
+    @brief Forget all command classes and counters
+*/
+/**************************************************************************/
+void Serial_Command_Handler::resetCommandStats(void)
+{
+    statsCount = 0;
+    statsIdx = -1;
+    statsFailedIdx = -1;
+    statsOpen = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief Find or add the class of a command, named after what follows "AT"
+   up to the first '=', '?' or '\r'. A plain "AT" is counted as "AT" and waits
+   without a command, other than those following up a command, in the "WAIT"
+   class. Once COMMAND_STATS_CLASSES - 1
+   classes exist, new ones are counted in the last slot, named "*".
+    @param cmd Command being sent, may be NULL
+    @param flash True if cmd is in flash
+    @return Class index
+*/
+/**************************************************************************/
+int8_t Serial_Command_Handler::findCommandStats(const char *cmd, bool flash)
+{
+    char name[COMMAND_STATS_NAME_LENGTH];
+    uint8_t length = 0;
+
+    if (cmd == NULL)
+        strcpy(name, "WAIT");
+    else
     {
-        if (SwSerial->available())
-            Serial.write(SwSerial->read());
-        if (Serial.available())
-            SwSerial->write(Serial.read());
+        if (commandChar(cmd, 0, flash) == 'A' && commandChar(cmd, 1, flash) == 'T')
+            cmd += 2;
+        for (; length < COMMAND_STATS_NAME_LENGTH - 1; length++)
+        {
+            char c = commandChar(cmd, length, flash);
+            if (c == '=' || c == '?' || c == '\r' || c == '\0')
+                break;
+            name[length] = c;
+        }
+        name[length] = '\0';
+
+        if (length == 0) ///< Plain "AT"
+            strcpy(name, "AT");
     }
-#endif
-    if (HwSerial)
+
+    for (uint8_t i = 0; i < statsCount; i++)
+        if (strcmp(stats[i].name, name) == 0)
+            return i;
+
+    if (statsCount >= COMMAND_STATS_CLASSES - 1) ///< Full, the last slot is kept for the "*" class collecting everything else
     {
-        if (HwSerial->available())
-            Serial.write(HwSerial->read());
-        if (Serial.available())
-            HwSerial->write(Serial.read());
+        command_stats &other = stats[COMMAND_STATS_CLASSES - 1];
+        if (statsCount < COMMAND_STATS_CLASSES)
+        {
+            memset(&other, 0, sizeof(other));
+            strcpy(other.name, "*");
+            statsCount = COMMAND_STATS_CLASSES;
+        }
+        return COMMAND_STATS_CLASSES - 1;
     }
+
+    command_stats &entry = stats[statsCount];
+    memset(&entry, 0, sizeof(entry));
+    strcpy(entry.name, name);
+    return statsCount++;
+}
+
+/**************************************************************************/
+/*!
+    @brief Count a completed command against its class and close the class,
+   bytes until the next command are URCs or idle traffic
+    @param result Final result of the command
+    @param end When the final result, or the response the caller finished
+   reading, arrived
+*/
+/**************************************************************************/
+void Serial_Command_Handler::recordCommandStats(command_result result, unsigned long end)
+{
+    int8_t idx = statsIdx;
+
+    statsIdx = -1;
+    statsOpen = false;
+    if (idx < 0)
+        return;
+
+    command_stats &entry = stats[idx];
+    unsigned long latency = end - statsStart;
+    uint8_t bucket = 0;
+
+    while (bucket < COMMAND_STATS_BUCKETS - 1 && latency >= (16UL << bucket))
+        bucket++;
+
+    entry.count++;
+    entry.histogram[bucket]++;
+    entry.totalLatency += latency;
+    if (latency > entry.maxLatency)
+        entry.maxLatency = latency > 0xFFFF ? 0xFFFF : latency;
+
+    if (result == RESULT_TIMEOUT)
+        entry.timeouts++;
+    else if (result != RESULT_OK)
+        entry.errors++;
+
+    statsFailedIdx = result == RESULT_OK ? -1 : idx;
+}
+
+#endif
+
+/**************************************************************************/
+/*!
+    @brief Replace the clock used for timeouts and delays, e.g. with a
+   Virtual_Time_Source to run timeout scenarios faster than real time
+    @param source Clock to use, NULL for the Arduino millis() and delay()
+*/
+/**************************************************************************/
+void Serial_Command_Handler::setTimeSource(Time_Source *source)
+{
+    timeSource = source ? source : &ArduinoTime;
+}
+
+/**************************************************************************/
+/*!
+    @brief Total time the blocking API has spent waiting for commands to complete
+    @return Milliseconds, as measured by the current clock
+*/
+/**************************************************************************/
+unsigned long Serial_Command_Handler::getWaitTime(void) { return waitTime; }
+
+/**************************************************************************/
+/*!
+    @brief Current time from the configured clock. Hides the Arduino millis()
+   so every timeout in this class and in derived classes uses the clock.
+    @return Milliseconds since start
+*/
+/**************************************************************************/
+unsigned long Serial_Command_Handler::millis(void) { return timeSource->millis(); }
+
+/**************************************************************************/
+/*!
+    @brief Wait using the configured clock. Hides the Arduino delay() so every
+   delay in this class and in derived classes uses the clock.
+    @param ms How long to wait in milliseconds
+*/
+/**************************************************************************/
+void Serial_Command_Handler::delay(unsigned long ms) { timeSource->delay(ms); }
+
+void Serial_Command_Handler::ATBypass(void)
+{
+    if (transport == NULL)
+        return;
+
+    if (transport->available())
+        Serial.write(transport->read());
+    if (Serial.available())
+        transport->write(Serial.read());
 }
 
 /**************************************************************************/
@@ -500,4 +1452,314 @@ void Serial_Command_Handler::cleanBuffer(char *buffer, int count)
 {
     for (int i = 0; i < count; i++)
         buffer[i] = '\0';
+}
+
+/**************************************************************************/
+/*!
+    @brief Constructor for an empty matcher
+*/
+/**************************************************************************/
+Response_Matcher::Response_Matcher() : count(0) {}
+
+/**************************************************************************/
+/*!
+    @brief Replace the watched patterns
+    @param patterns Array of pointers to the patterns, must outlive the matcher
+    @param count Number of entries in patterns, extra entries are ignored
+*/
+/**************************************************************************/
+void Response_Matcher::begin(const char *const *patterns, uint8_t count)
+{
+    this->count = 0;
+    for (uint8_t i = 0; i < count; i++)
+        (void)add(patterns[i]);
+}
+
+/**************************************************************************/
+/*!
+    @brief Watch for one more pattern
+    @param pattern Null terminated pattern, must outlive the matcher
+    @param flash True if pattern is in flash (PROGMEM on AVR) (optional,
+   default = false)
+    @return True if added, false if the matcher is full or the pattern is empty
+*/
+/**************************************************************************/
+bool Response_Matcher::add(const char *pattern, bool flash)
+{
+    if (count >= MAX_RESPONSE_PATTERNS || pattern == NULL || commandChar(pattern, 0, flash) == '\0')
+        return false;
+
+    uint8_t *table = failure[count];
+    uint8_t matched = 0;
+
+    table[0] = 0;
+    for (uint8_t i = 1; i < AT_RESPONSE_LENGTH; i++) ///< KMP failure function, built the usual way
+    {
+        char c = commandChar(pattern, i, flash);
+        if (c == '\0')
+            break;
+
+        while (matched > 0 && commandChar(pattern, matched, flash) != c)
+            matched = table[matched - 1];
+        if (commandChar(pattern, matched, flash) == c)
+            matched++;
+        table[i] = matched;
+    }
+
+    patterns[count] = pattern;
+    this->flash[count] = flash;
+    states[count++] = 0;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Forget any partial matches
+*/
+/**************************************************************************/
+void Response_Matcher::reset(void)
+{
+    for (uint8_t i = 0; i < count; i++)
+        states[i] = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief Advance all patterns by one received character. Each mismatch
+   follows the failure table, so the work is constant per pattern on average,
+   whatever has been received before.
+    @param c Received character
+    @return Index of the pattern completed by this character, -1 if none
+*/
+/**************************************************************************/
+int8_t Response_Matcher::feed(char c)
+{
+    int8_t match = -1;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const char *pattern = patterns[i];
+        uint8_t state = states[i];
+
+        while (state > 0 && commandChar(pattern, state, flash[i]) != c)
+            state = fallback(i, state);
+
+        if (commandChar(pattern, state, flash[i]) == c)
+            state++;
+
+        if (commandChar(pattern, state, flash[i]) == '\0')
+        {
+            if (match < 0)
+                match = i;
+            state = fallback(i, state);
+        }
+
+        states[i] = state;
+    }
+
+    return match;
+}
+
+/**************************************************************************/
+/*!
+    @brief Find how much of a partial match survives a mismatch, from the
+   table built by add(). Past AT_RESPONSE_LENGTH characters, which only
+   waitForResponse() patterns reach, it is computed on demand.
+    @param index Pattern being matched
+    @param state Number of characters matched so far
+    @return Length of the longest proper prefix that is also a suffix
+*/
+/**************************************************************************/
+uint8_t Response_Matcher::fallback(uint8_t index, uint8_t state)
+{
+    if (state <= AT_RESPONSE_LENGTH)
+        return failure[index][state - 1];
+
+    const char *pattern = patterns[index];
+    for (uint8_t length = state - 1; length > 0; length--)
+    {
+        uint8_t i = 0;
+        while (i < length && commandChar(pattern, i, flash[index]) == commandChar(pattern, state - length + i, flash[index]))
+            i++;
+        if (i == length)
+            return length;
+    }
+
+    return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief Register a handler for unsolicited lines starting with a prefix.
+   Lines without a handler are kept in a queue for readUnsolicited().
+    @param prefix Pointer to the prefix, e.g. "+CMTI:", must stay valid
+    @param callback Function called with each matching line
+    @param context Pointer passed to the callback (optional)
+    @return True if registered, false if MAX_URC_HANDLERS are already in use
+*/
+/**************************************************************************/
+bool Serial_Command_Handler::onUnsolicited(const char *prefix, urc_callback callback, void *context)
+{
+    if (urcHandlerCount >= MAX_URC_HANDLERS || prefix == NULL || callback == NULL)
+        return false;
+
+    urcPrefixes[urcHandlerCount] = prefix;
+    urcCallbacks[urcHandlerCount] = callback;
+    urcContexts[urcHandlerCount++] = context;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief How many unhandled unsolicited lines are queued
+    @return Number of lines readUnsolicited() can return
+*/
+/**************************************************************************/
+uint8_t Serial_Command_Handler::unsolicitedAvailable(void)
+{
+    return urcCount;
+}
+
+/**************************************************************************/
+/*!
+    @brief Take the oldest unhandled unsolicited line from the queue
+    @param dest Buffer to copy the line into, always null terminated
+    @param length Size of dest
+    @return True if a line was copied, false if the queue is empty
+*/
+/**************************************************************************/
+bool Serial_Command_Handler::readUnsolicited(char *dest, uint8_t length)
+{
+    if (urcCount == 0 || length == 0)
+        return false;
+
+    strncpy(dest, urcQueue[urcHead], length - 1);
+    dest[length - 1] = '\0';
+    urcHead = (urcHead + 1) % URC_QUEUE_SIZE;
+    urcCount--;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief How many unsolicited lines were dropped because the queue was full
+    @return Number of dropped lines since startup
+*/
+/**************************************************************************/
+uint16_t Serial_Command_Handler::getUnsolicitedOverflows(void)
+{
+    return urcOverflows;
+}
+
+/**************************************************************************/
+/*!
+    @brief Read whatever is left of a response, keeping unsolicited lines
+*/
+/**************************************************************************/
+void Serial_Command_Handler::drainUnsolicited(void)
+{
+    while (available())
+        collectLine(readByte());
+}
+
+/**************************************************************************/
+/*!
+    @brief Assemble received characters into lines and dispatch the lines
+   that are unsolicited
+    @param c Received character
+*/
+/**************************************************************************/
+void Serial_Command_Handler::collectLine(char c)
+{
+    if (c == '\r')
+        return;
+
+    if (c != '\n')
+    {
+        if (urcIdx < URC_LINE_LENGTH - 1)
+            urcLine[urcIdx++] = c;
+        return;
+    }
+
+    urcTaken = false;
+    if (urcIdx == 0)
+        return;
+
+    urcLine[urcIdx] = '\0';
+    urcIdx = 0;
+
+    if (isSolicited(urcLine))
+        return;
+
+    for (uint8_t i = 0; i < urcHandlerCount; i++)
+        if (strncmp(urcLine, urcPrefixes[i], strlen(urcPrefixes[i])) == 0)
+        {
+            urcTaken = true;
+            urcCallbacks[i](urcLine, urcContexts[i]);
+            return;
+        }
+
+    if (!isKnownUnsolicited(urcLine))
+        return;
+
+    urcTaken = true;
+
+    if (urcCount == URC_QUEUE_SIZE) ///< Drop the oldest line to make room
+    {
+        urcHead = (urcHead + 1) % URC_QUEUE_SIZE;
+        urcCount--;
+        urcOverflows++;
+    }
+
+    strcpy(urcQueue[(urcHead + urcCount++) % URC_QUEUE_SIZE], urcLine);
+}
+
+/**************************************************************************/
+/*!
+    @brief Check if a line is the information response of the running
+   command, which starts with the command name (e.g. "+CREG: " for "AT+CREG?")
+    @param line Complete line
+    @return True if the line belongs to the running command
+*/
+/**************************************************************************/
+bool Serial_Command_Handler::isSolicited(const char *line)
+{
+    if (queueCount == 0 || engineState == ENGINE_IDLE)
+        return false;
+
+    const queued_command &cmd = queue[queueHead];
+    if (cmd.command == NULL || commandChar(cmd.command, 0, cmd.flash) != 'A' || commandChar(cmd.command, 1, cmd.flash) != 'T')
+        return false;
+
+    for (uint8_t i = 2;; i++, line++)
+    {
+        char c = commandChar(cmd.command, i, cmd.flash);
+        if (c == '=' || c == '?' || c == '\r' || c == '\0')
+            break;
+        if (c != *line)
+            return false;
+    }
+
+    return *line == ':';
+}
+
+/**************************************************************************/
+/*!
+    @brief Check if a line is one of the unsolicited result codes of the MC60
+    @param line Complete line
+    @return True if the line is unsolicited
+*/
+/**************************************************************************/
+bool Serial_Command_Handler::isKnownUnsolicited(const char *line)
+{
+    static const char prefixes[][sizeof("NORMAL POWER DOWN")] PROGMEM = {
+        "+CMTI:", "+CMT:", "+CDS:", "+CBM:", "+CREG:", "+CGREG:", "RING", "+CRING:", "+CLIP:", "+CUSD:", "+QGNSS",
+        "+QIURC:", "+PDP DEACT", "NORMAL POWER DOWN", "UNDER-VOLTAGE", "OVER-VOLTAGE", "+CPIN:", "Call Ready",
+        "SMS Ready", "+QNITZ:", "+CTZV:"};
+
+    for (uint8_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); i++)
+        if (strncmp_P(line, prefixes[i], strlen_P(prefixes[i])) == 0)
+            return true;
+
+    return false;
 }
\ No newline at end of file
@@ -5,16 +5,209 @@
 #define SHORT_TIMEOUT 100UL
 
 #define MAXLINELENGTH 120 ///< how long are max lines to parse
+#define MAX_RESPONSE_PATTERNS 6 ///< how many responses can be waited for at once
+
+#ifndef RX_BUFFER_SIZE
+#ifdef __AVR__
+#define RX_BUFFER_SIZE 128 ///< size of the RX ring buffer, must be a power of two
+#else
+#define RX_BUFFER_SIZE 512 ///< size of the RX ring buffer, must be a power of two
+#endif
+#endif
+
+#if RX_BUFFER_SIZE < 2 || RX_BUFFER_SIZE > 32768 || (RX_BUFFER_SIZE & (RX_BUFFER_SIZE - 1)) != 0
+#error "RX_BUFFER_SIZE must be a power of two between 2 and 32768"
+#endif
+
+// Define USE_RX_ISR when an interrupt handler feeds the RX ring buffer with
+// receive(). service() then leaves the transport alone, so the interrupt is
+// the only producer.
+
+#ifndef NO_COMMAND_STATS
+#define USE_COMMAND_STATS
+#endif
+
+#ifndef COMMAND_STATS_CLASSES
+#ifdef __AVR__
+#define COMMAND_STATS_CLASSES 4 ///< how many command classes are tracked, including the "*" class collecting the rest
+#else
+#define COMMAND_STATS_CLASSES 12 ///< how many command classes are tracked, including the "*" class collecting the rest
+#endif
+#endif
+
+#if COMMAND_STATS_CLASSES < 2 || COMMAND_STATS_CLASSES > 127
+#error "COMMAND_STATS_CLASSES must be between 2 and 127"
+#endif
+
+#define COMMAND_STATS_BUCKETS 8   ///< latency histogram buckets, doubling from 16 ms to 1024 ms and above
+#define COMMAND_STATS_NAME_LENGTH 9 ///< longest command class name plus terminator
+
+#ifndef URC_QUEUE_SIZE
+#ifdef __AVR__
+#define URC_QUEUE_SIZE 2 ///< how many unhandled unsolicited lines are kept
+#else
+#define URC_QUEUE_SIZE 8 ///< how many unhandled unsolicited lines are kept
+#endif
+#endif
+
+#ifndef URC_LINE_LENGTH
+#define URC_LINE_LENGTH 64 ///< how long unsolicited lines are kept, longer lines are truncated
+#endif
+
+#ifndef MAX_URC_HANDLERS
+#define MAX_URC_HANDLERS 4 ///< how many unsolicited line handlers can be registered
+#endif
+
+#ifndef COMMAND_QUEUE_SIZE
+#define COMMAND_QUEUE_SIZE 4 ///< how many commands can be queued for poll()
+#endif
+
+#ifndef AT_RESPONSE_LENGTH
+#define AT_RESPONSE_LENGTH 20 ///< longest expected response of an at_command plus terminator
+#endif
 
 #if (defined(__AVR__) || defined(ESP8266)) && !defined(NO_SW_SERIAL)
 #define USE_SW_SERIAL
 #endif
 
 #include <Arduino.h>
+#include "Time_Source.h"
 #ifdef USE_SW_SERIAL
 #include <SoftwareSerial.h>
 #endif
 
+/**************************************************************************/
+/*!
+    @brief  Final result of a command
+*/
+/**************************************************************************/
+typedef enum
+{
+    RESULT_OK = 0,         ///< Got "OK" or the expected response
+    RESULT_ERROR = 1,      ///< Got "ERROR"
+    RESULT_CME_ERROR = 2,  ///< Got "+CME ERROR: <code>"
+    RESULT_CMS_ERROR = 3,  ///< Got "+CMS ERROR: <code>"
+    RESULT_TIMEOUT = 4,    ///< Nothing conclusive before the timeout
+    RESULT_UNEXPECTED = 5, ///< Got "OK" without the expected response
+    RESULT_PENDING = 6     ///< Still queued or in progress
+} command_result;
+
+typedef uint8_t command_handle; ///< Identifies a queued command, 0 is never a valid handle
+
+/**************************************************************************/
+/*!
+    @brief  Called from poll() when a queued command completes
+    @param result Final result of the command
+    @param context Pointer given when the command was queued
+*/
+/**************************************************************************/
+typedef void (*command_callback)(command_result result, void *context);
+
+/**************************************************************************/
+/*!
+    @brief  Called when an unsolicited line with a registered prefix is received
+    @param line Complete line without the line ending
+    @param context Pointer given when the handler was registered
+*/
+/**************************************************************************/
+typedef void (*urc_callback)(const char *line, void *context);
+
+/**************************************************************************/
+/*!
+    @brief  Starts a transport whose begin() is not part of Stream
+    @param transport The port given to the constructor
+    @param baud Baud rate
+*/
+/**************************************************************************/
+typedef void (*transport_begin)(Stream *transport, uint32_t baud);
+
+class Serial_Command_Handler;
+
+/**************************************************************************/
+/*!
+    @brief  Reads what follows the expected response of an at_command, up to
+   and including the final result
+    @param handler Handler that sent the command
+    @param result Pointer given to sendCommand(), the type depends on the parser
+    @returns True if the value was read
+*/
+/**************************************************************************/
+typedef bool (*command_parser)(Serial_Command_Handler *handler, void *result);
+
+/**************************************************************************/
+/*!
+    @brief  A command kept in flash (PROGMEM on AVR), declare it with
+   AT_COMMAND() and send it with sendCommand(). The command is streamed from
+   flash and the expected response is matched in flash, neither takes RAM.
+*/
+/**************************************************************************/
+typedef struct
+{
+    const char *command;   ///< Command without the "\r", in flash
+    const char *response;  ///< Expected response in flash, "" for "OK"
+    uint16_t timeout;      ///< How long to wait in milliseconds
+    command_parser parser; ///< Reads the rest of the response, NULL to leave it to the caller
+} at_command;
+
+/**************************************************************************/
+/*!
+    @brief  Declare an at_command and its strings in flash, e.g.
+   AT_COMMAND(AT_CREG, "AT+CREG?", "+CREG: ", 300, parseRegistration);
+*/
+/**************************************************************************/
+#define AT_COMMAND(name, command, response, timeout, parser)                                                  \
+    static_assert(sizeof(response) <= AT_RESPONSE_LENGTH, #name " response is longer than AT_RESPONSE_LENGTH"); \
+    static constexpr char name##_COMMAND[] PROGMEM = command;                                                  \
+    static constexpr char name##_RESPONSE[] PROGMEM = response;                                                \
+    static constexpr at_command name PROGMEM = {name##_COMMAND, name##_RESPONSE, timeout, parser}
+
+/**************************************************************************/
+/*!
+    @brief  Counters for one command class, e.g. "+CREG" for AT+CREG? and AT+CREG=1
+*/
+/**************************************************************************/
+typedef struct
+{
+    char name[COMMAND_STATS_NAME_LENGTH];         ///< Command name after "AT", "*" for the overflow class
+    uint16_t count;                               ///< Completed commands
+    uint16_t timeouts;                            ///< Commands that ended in RESULT_TIMEOUT
+    uint16_t errors;                              ///< Commands that ended in an error result
+    uint16_t retries;                             ///< Commands sent again right after failing
+    uint32_t bytesTx;                             ///< Bytes written while the class was active
+    uint32_t bytesRx;                             ///< Bytes read while the class was active
+    uint32_t totalLatency;                        ///< Sum of round-trip latencies in milliseconds
+    uint16_t maxLatency;                          ///< Longest round-trip latency in milliseconds
+    uint16_t histogram[COMMAND_STATS_BUCKETS];    ///< Round-trip latencies, bucket i counts < 16 << i ms
+} command_stats;
+
+/**************************************************************************/
+/*!
+    @brief  Incremental matcher watching a byte stream for several patterns at
+   once. The KMP failure table of each pattern is built by add(), for the
+   first AT_RESPONSE_LENGTH characters, so every received byte costs constant
+   work per pattern.
+*/
+/**************************************************************************/
+class Response_Matcher
+{
+public:
+    Response_Matcher();
+
+    void begin(const char *const *patterns, uint8_t count);
+    bool add(const char *pattern, bool flash = false);
+    void reset(void);
+    int8_t feed(char c);
+
+private:
+    uint8_t fallback(uint8_t index, uint8_t state);
+
+    const char *patterns[MAX_RESPONSE_PATTERNS];              ///< Patterns being watched for
+    bool flash[MAX_RESPONSE_PATTERNS];                        ///< The pattern is in flash (PROGMEM on AVR)
+    uint8_t failure[MAX_RESPONSE_PATTERNS][AT_RESPONSE_LENGTH]; ///< Where a partial match of length i + 1 falls back to
+    uint8_t states[MAX_RESPONSE_PATTERNS];       ///< Matched prefix length per pattern
+    uint8_t count;                               ///< Number of patterns in use
+};
+
 /**************************************************************************/
 /*!
     @brief  The Serial_Command_Handler class
@@ -29,16 +222,23 @@ public:
     Serial_Command_Handler(SoftwareSerial *ser);
 #endif
     Serial_Command_Handler(HardwareSerial *ser);
+    Serial_Command_Handler(Stream *ser);
     Serial_Command_Handler();
     virtual ~Serial_Command_Handler();
 
     size_t available(void);
+    void service(void);
+    void receive(uint8_t c);
     size_t write(uint8_t);
+    size_t write(const uint8_t *buffer, size_t size);
     size_t write(const char *cmd);
     size_t write(String cmd);
+    size_t write_P(const char *text);
     void flush(void);
     char read(void);
+    bool wasUnsolicited(void);
     String readline(unsigned long timeout = SHORT_TIMEOUT, uint8_t length = MAXLINELENGTH);
+    size_t readline(char *dest, uint8_t length, unsigned long timeout = SHORT_TIMEOUT);
     char *readbetween(const char first, const char last, unsigned long timeout = SHORT_TIMEOUT, uint8_t length = MAXLINELENGTH);
     void pause(bool b);
 
@@ -48,6 +248,8 @@ public:
     bool waitForOK(unsigned long timeout = DEFAULT_TIMEOUT, uint8_t length = MAXLINELENGTH);
     bool waitForResponse(const char *wait, unsigned long timeout = DEFAULT_TIMEOUT, uint8_t length = MAXLINELENGTH);
     bool waitForResponse(String wait, unsigned long timeout = DEFAULT_TIMEOUT, uint8_t length = MAXLINELENGTH);
+    bool waitForResponse_P(const char *wait, unsigned long timeout = DEFAULT_TIMEOUT, uint8_t length = MAXLINELENGTH);
+    int8_t waitForResponses(const char *const *patterns, uint8_t count, unsigned long timeout = DEFAULT_TIMEOUT, uint8_t length = MAXLINELENGTH);
     bool sendCommandWait(const char *cmd, const char *response, unsigned long timeout = DEFAULT_TIMEOUT, uint8_t length = MAXLINELENGTH);
     bool sendCommandWait(String cmd, const char *response, unsigned long timeout = DEFAULT_TIMEOUT, uint8_t length = MAXLINELENGTH);
     bool sendCommandWait(const char *cmd, String response, unsigned long timeout = DEFAULT_TIMEOUT, uint8_t length = MAXLINELENGTH);
@@ -55,21 +257,159 @@ public:
     bool sendCommandWaitOK(const char *cmd, unsigned long timeout = DEFAULT_TIMEOUT);
     bool sendCommandWaitOK(String cmd, unsigned long timeout = DEFAULT_TIMEOUT);
 
+    command_result waitForResult(const char *response = NULL, unsigned long timeout = DEFAULT_TIMEOUT, uint8_t length = MAXLINELENGTH);
+    command_result sendCommand(const char *cmd, const char *response = NULL, unsigned long timeout = DEFAULT_TIMEOUT, uint8_t length = MAXLINELENGTH);
+    command_result sendCommand(const at_command *cmd, const char *argument = NULL, void *result = NULL);
+    command_result waitForResult_P(const char *response, unsigned long timeout = DEFAULT_TIMEOUT, uint8_t length = MAXLINELENGTH);
+    command_result sendCommand_P(const char *cmd, const char *response = NULL, unsigned long timeout = DEFAULT_TIMEOUT, uint8_t length = MAXLINELENGTH);
+    command_result getLastResult(void);
+    int16_t getLastErrorCode(void);
+
+    command_handle queueCommand(const char *cmd, const char *response = NULL, command_callback callback = NULL, void *context = NULL,
+                                unsigned long timeout = DEFAULT_TIMEOUT, char *capture = NULL, uint8_t captureLength = 0);
+    void poll(void);
+    bool isPending(command_handle handle);
+    command_result getResult(command_handle handle);
+
+    bool onUnsolicited(const char *prefix, urc_callback callback, void *context = NULL);
+    uint8_t unsolicitedAvailable(void);
+    bool readUnsolicited(char *dest, uint8_t length);
+    uint16_t getUnsolicitedOverflows(void);
+
+    uint16_t getRxHighWater(void);
+    uint32_t getRxOverflowBytes(void);
+    uint16_t getRxDroppedLines(void);
+    void resetRxStatistics(void);
+
+#ifdef USE_COMMAND_STATS
+    uint8_t getCommandStatsCount(void);
+    const command_stats *getCommandStats(uint8_t index);
+    void resetCommandStats(void);
+#endif
+
+    void setTimeSource(Time_Source *source);
+    unsigned long getWaitTime(void);
+
     void ATBypass(void);
 
 protected:
     void common_init(void);
+    unsigned long millis(void);
+    void delay(unsigned long ms);
     void cleanBuffer(char *buffer, int count = MAXLINELENGTH);
+    char readByte(void);
 
     bool paused;
     bool noComms = false;
 
-#ifdef USE_SW_SERIAL
-    SoftwareSerial *SwSerial;
-#endif
-    HardwareSerial *HwSerial;
+    command_result lastResult = RESULT_OK; ///< Result of the last waitForResult()
+    int16_t lastErrorCode = -1;            ///< Code of the last +CME/+CMS ERROR, -1 if none
+
+    Stream *transport = NULL;               ///< Port, channel or simulator the device is on
+    transport_begin beginTransport = NULL;  ///< Starts transport at a baud rate, NULL if its owner does
+
+    Time_Source *timeSource = &ArduinoTime; ///< Clock for all timeouts and delays
+    unsigned long waitTime = 0;             ///< Time spent blocked waiting for commands
 
 private:
+#if RX_BUFFER_SIZE <= 128
+    typedef uint8_t rx_index_t; ///< Free running RX ring buffer index, masked on access, one byte so it is atomic on AVR
+#else
+    typedef uint16_t rx_index_t; ///< Free running RX ring buffer index, masked on access
+#endif
+
+    rx_index_t rxCount(void);
+
+    uint8_t rxBuffer[RX_BUFFER_SIZE];      ///< Received bytes not read yet
+    volatile rx_index_t rxHead = 0;        ///< Where the next received byte goes
+    volatile rx_index_t rxTail = 0;        ///< Where the next read byte comes from
+    volatile uint16_t rxHighWater = 0;     ///< Most bytes ever buffered
+    volatile uint32_t rxOverflowBytes = 0; ///< Bytes dropped because the buffer was full
+    volatile uint16_t rxDroppedLines = 0;  ///< Lines that lost bytes to an overflow
+    volatile bool rxLineDamaged = false;   ///< The line being received lost bytes
+
+    /**************************************************************************/
+    /*!
+        @brief  A command waiting in, or running from, the poll() queue
+    */
+    /**************************************************************************/
+    typedef struct
+    {
+        const char *command;       ///< Command to send, NULL to only wait
+        const char *response;      ///< Expected response, NULL to wait for "OK"
+        const char *argument;      ///< Written after a flash command and followed by "\r", NULL if the command ends itself
+        char *capture;             ///< Buffer for the rest of the response line, NULL to stop at the response
+        unsigned long timeout;     ///< How long to wait in milliseconds
+        command_callback callback; ///< Called on completion, may be NULL
+        void *context;             ///< Passed to the callback
+        uint8_t captureLength;     ///< Size of capture
+        uint8_t length;            ///< How many characters to wait, 0 for no limit
+        command_handle handle;     ///< Handle returned to the caller
+        bool flash;                ///< command and response are in flash, see at_command
+    } queued_command;
+
+    typedef enum
+    {
+        ENGINE_IDLE,      ///< Nothing sent yet
+        ENGINE_WAITING,   ///< Waiting for the response or a final result
+        ENGINE_CAPTURING, ///< Copying the response line into capture
+        ENGINE_ERROR_CODE ///< Reading the code of a +CME/+CMS ERROR
+    } engine_state;
+
+    command_handle enqueue(const char *cmd, const char *response, unsigned long timeout, uint8_t length,
+                           command_callback callback, void *context, char *capture, uint8_t captureLength,
+                           const char *argument = NULL, bool flash = false);
+    command_result runUntilDone(command_handle handle);
+    int8_t waitForMatch(Response_Matcher &matcher, unsigned long timeout, uint8_t length);
+    void drainUnsolicited(void);
+    void collectLine(char c);
+    bool isSolicited(const char *line);
+    static bool isKnownUnsolicited(const char *line);
+    void startCommand(void);
+    void processByte(char c);
+    void completeCommand(command_result result);
+
+    queued_command queue[COMMAND_QUEUE_SIZE];               ///< Commands in submission order
+    command_handle completedHandles[COMMAND_QUEUE_SIZE];    ///< Recently completed commands
+    command_result completedResults[COMMAND_QUEUE_SIZE];    ///< Results of completedHandles
+    uint8_t queueHead = 0;                                  ///< Index of the running command
+    uint8_t queueCount = 0;                                 ///< Number of queued commands
+    uint8_t completedIdx = 0;                               ///< Next completedHandles entry to overwrite
+    command_handle nextHandle = 1;                          ///< Handle for the next queued command
+    engine_state engineState = ENGINE_IDLE;                 ///< What the running command is doing
+    Response_Matcher matcher;                               ///< Watches for the response and final results
+    uint8_t responseIdx = 0;                                ///< Matcher index of the first final result
+    bool responseSeen = false;                              ///< The expected response has been received
+    uint8_t received = 0;                                   ///< Characters received for the running command
+    uint8_t captured = 0;                                   ///< Characters stored in capture
+    command_result pendingResult = RESULT_ERROR;            ///< Error being completed in ENGINE_ERROR_CODE
+    unsigned long commandStart = 0;                         ///< When the running command was sent
+
+    const char *urcPrefixes[MAX_URC_HANDLERS];             ///< Prefixes with a registered handler
+    urc_callback urcCallbacks[MAX_URC_HANDLERS];           ///< Handlers for urcPrefixes
+    void *urcContexts[MAX_URC_HANDLERS];                   ///< Passed to urcCallbacks
+    uint8_t urcHandlerCount = 0;                           ///< Number of registered handlers
+    char urcQueue[URC_QUEUE_SIZE][URC_LINE_LENGTH];        ///< Unhandled unsolicited lines, oldest first
+    uint8_t urcHead = 0;                                   ///< Index of the oldest queued line
+    uint8_t urcCount = 0;                                  ///< Number of queued lines
+    uint16_t urcOverflows = 0;                             ///< Lines dropped because the queue was full
+    char urcLine[URC_LINE_LENGTH];                         ///< Line being received
+    uint8_t urcIdx = 0;                                    ///< Characters in urcLine
+    bool urcTaken = false;                                 ///< The last complete line was unsolicited
+
+#ifdef USE_COMMAND_STATS
+    int8_t findCommandStats(const char *cmd, bool flash);
+    void recordCommandStats(command_result result, unsigned long end);
+
+    command_stats stats[COMMAND_STATS_CLASSES];            ///< Counters per command class
+    uint8_t statsCount = 0;                                ///< Classes in use
+    int8_t statsIdx = -1;                                  ///< Class of the last command, bytes are counted against it
+    int8_t statsFailedIdx = -1;                            ///< Class of the last command if it failed
+    bool statsOpen = false;                                ///< The command of statsIdx completed on its response, the caller is still reading
+    unsigned long statsStart = 0;                          ///< When the command of statsIdx was sent
+    unsigned long statsEnd = 0;                            ///< When the response of the open class arrived
+#endif
+
     uint8_t lineidx = 0;        ///< our index into filling the current line
     char buffer[MAXLINELENGTH]; ///< Current line buffer
     String sbuffer = "";        ///< Current line buffer
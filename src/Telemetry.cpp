@@ -0,0 +1,432 @@
+#include "Telemetry.h"
+#include <string.h>
+
+#define FIELD_TIME 0      ///< Seconds since 2000
+#define FIELD_LATITUDE 1  ///< 1e-5 degrees
+#define FIELD_LONGITUDE 2 ///< 1e-5 degrees
+#define FIELD_ALTITUDE 3  ///< Decimeters
+#define FIELD_HDOP 4      ///< Tenths
+#define FIELD_STATUS 5    ///< fix_type << 6 | satellites
+#define FIELD_COUNT 6
+
+#define MASK_TIME 0x01     ///< The interval changed
+#define MASK_POSITION 0x02 ///< The velocity changed, latitude and longitude follow
+#define MASK_ALTITUDE 0x04 ///< The altitude changed
+#define MASK_HDOP 0x08     ///< The hdop changed
+#define MASK_STATUS 0x10   ///< The fix type or the number of satellites changed
+
+/// Which mask bit covers each field
+static const uint8_t fieldMask[FIELD_COUNT] = {MASK_TIME, MASK_POSITION, MASK_POSITION, MASK_ALTITUDE, MASK_HDOP, MASK_STATUS};
+
+/**************************************************************************/
+/*!
+    @brief Divide, rounding halves away from zero
+    @param value Dividend
+    @param divisor Positive divisor
+    @returns Rounded quotient
+*/
+/**************************************************************************/
+static int32_t divideRounded(int32_t value, int32_t divisor)
+{
+    return value >= 0 ? (value + divisor / 2) / divisor : -((divisor / 2 - value) / divisor);
+}
+
+/**************************************************************************/
+/*!
+    @brief Map a signed value to an unsigned one with small magnitudes first
+    @param value Signed value
+    @returns 0, -1, 1, -2, ... become 0, 1, 2, 3, ...
+*/
+/**************************************************************************/
+static uint32_t zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/**************************************************************************/
+/*!
+    @brief Inverse of zigzag()
+    @param value Unsigned value
+    @returns Signed value
+*/
+/**************************************************************************/
+static int32_t unzigzag(uint32_t value)
+{
+    return (int32_t)((value >> 1) ^ (0 - (value & 1)));
+}
+
+/**************************************************************************/
+/*!
+    @brief Base64 character of a 6-bit value
+    @param value 0 to 63
+    @returns 'A'-'Z', 'a'-'z', '0'-'9', '+' or '/'
+*/
+/**************************************************************************/
+static char base64Char(uint8_t value)
+{
+    if (value < 26)
+        return 'A' + value;
+    if (value < 52)
+        return 'a' + value - 26;
+    if (value < 62)
+        return '0' + value - 52;
+    return value == 62 ? '+' : '/';
+}
+
+/**************************************************************************/
+/*!
+    @brief 6-bit value of a base64 character
+    @param c Character
+    @returns 0 to 63, -1 if c is not a base64 character
+*/
+/**************************************************************************/
+static int8_t base64Value(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '+')
+        return 62;
+    if (c == '/')
+        return 63;
+    return -1;
+}
+
+/**************************************************************************/
+/*!
+    @brief Reduce a point to the resolution that is sent
+    @param point Position report
+    @param fields Filled with FIELD_COUNT quantized fields
+*/
+/**************************************************************************/
+static void quantize(const telemetry_point &point, int32_t *fields)
+{
+    fields[FIELD_TIME] = (int32_t)point.time;
+    fields[FIELD_LATITUDE] = divideRounded(point.latitude, 100);
+    fields[FIELD_LONGITUDE] = divideRounded(point.longitude, 100);
+    fields[FIELD_ALTITUDE] = divideRounded(point.altitude, 10);
+    fields[FIELD_HDOP] = (point.hdop + 5) / 10;
+    fields[FIELD_STATUS] = (point.fix_type & 0x0F) << 6 | (point.satellites > 63 ? 63 : point.satellites);
+}
+
+/**************************************************************************/
+/*!
+    @brief Forget every point, the next one is sent in full
+*/
+/**************************************************************************/
+void Telemetry_Predictor::clear(void)
+{
+    count = 0;
+    memset(last, 0, sizeof(last));
+    memset(step, 0, sizeof(step));
+}
+
+/**************************************************************************/
+/*!
+    @brief Expected value of a field in the next point
+    @param field FIELD_* index
+    @returns Last value, plus the last change for time and position
+*/
+/**************************************************************************/
+int32_t Telemetry_Predictor::predict(uint8_t field)
+{
+    return field <= FIELD_LONGITUDE ? (int32_t)((uint32_t)last[field] + (uint32_t)step[field]) : last[field];
+}
+
+/**************************************************************************/
+/*!
+    @brief Make a point the base of the next prediction
+    @param fields FIELD_COUNT quantized fields of the point
+*/
+/**************************************************************************/
+void Telemetry_Predictor::advance(const int32_t *fields)
+{
+    for (uint8_t i = 0; i <= FIELD_LONGITUDE; i++) ///< The first point has no change to repeat
+        step[i] = count ? (int32_t)((uint32_t)fields[i] - (uint32_t)last[i]) : 0;
+
+    memcpy(last, fields, sizeof(last));
+    if (count < 255)
+        count++;
+}
+
+/**************************************************************************/
+/*!
+    @brief Start a new message
+*/
+/**************************************************************************/
+void Telemetry_Encoder::clear(void)
+{
+    Telemetry_Predictor::clear();
+    length = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief Append a point to the message
+    @param point Position report
+    @returns True if it was added, False if the message is full, send it and
+   clear() to start the next one
+*/
+/**************************************************************************/
+bool Telemetry_Encoder::add(const telemetry_point &point)
+{
+    int32_t fields[FIELD_COUNT];
+    uint8_t packed[1 + FIELD_COUNT * 5]; ///< Mask and up to five bytes per varint
+    uint8_t size = 1;
+    uint8_t mask = 0;
+
+    quantize(point, fields);
+
+    for (uint8_t i = 0; i < FIELD_COUNT; i++)
+        if (fields[i] != predict(i))
+            mask |= fieldMask[i];
+
+    packed[0] = mask;
+    for (uint8_t i = 0; i < FIELD_COUNT; i++)
+    {
+        if (!(mask & fieldMask[i]))
+            continue;
+
+        uint32_t value = zigzag((int32_t)((uint32_t)fields[i] - (uint32_t)predict(i)));
+        while (value >= 0x80)
+        {
+            packed[size++] = (value & 0x7F) | 0x80;
+            value >>= 7;
+        }
+        packed[size++] = value;
+    }
+
+    if (length + (length == 0) + size > TELEMETRY_PAYLOAD_SIZE)
+        return false;
+
+    if (length == 0)
+        payload[length++] = TELEMETRY_VERSION;
+    memcpy(payload + length, packed, size);
+    length += size;
+
+    advance(fields);
+    return true;
+}
+
+#ifdef ARDUINO
+/**************************************************************************/
+/*!
+    @brief Append a GNSS fix to the message
+    @param fix Fix with at least GNSS_HAS_TIME, GNSS_HAS_DATE and
+   GNSS_HAS_POSITION
+    @returns True if it was added, False if the fix is incomplete or the
+   message is full
+*/
+/**************************************************************************/
+bool Telemetry_Encoder::add(const gnss_fix &fix)
+{
+    static const uint16_t monthDays[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+    const uint8_t needed = GNSS_HAS_TIME | GNSS_HAS_DATE | GNSS_HAS_POSITION;
+
+    if ((fix.flags & needed) != needed || fix.month < 1 || fix.month > 12)
+        return false;
+
+    uint32_t days = 365UL * fix.year + (fix.year + 3) / 4 + monthDays[fix.month - 1] + fix.day - 1;
+    if (fix.year % 4 == 0 && fix.month > 2)
+        days++;
+
+    telemetry_point point;
+    point.time = days * 86400UL + fix.hour * 3600UL + fix.minute * 60U + fix.second;
+    point.latitude = fix.latitude;
+    point.longitude = fix.longitude;
+    point.altitude = fix.flags & GNSS_HAS_ALTITUDE ? fix.altitude : 0;
+    point.hdop = fix.flags & GNSS_HAS_HDOP ? fix.hdop : 0;
+    point.satellites = fix.satellites;
+    point.fix_type = fix.fix_type;
+
+    return add(point);
+}
+#endif
+
+/**************************************************************************/
+/*!
+    @brief Number of points in the message
+    @returns Point count
+*/
+/**************************************************************************/
+uint8_t Telemetry_Encoder::getCount(void) { return count; }
+
+/**************************************************************************/
+/*!
+    @brief Size of the packed message before base64
+    @returns Bytes, at most TELEMETRY_PAYLOAD_SIZE
+*/
+/**************************************************************************/
+uint8_t Telemetry_Encoder::getLength(void) { return length; }
+
+/**************************************************************************/
+/*!
+    @brief Write the message as base64 text without padding
+    @param text Buffer, TELEMETRY_TEXT_SIZE is always enough
+    @param size Size of text
+    @returns Number of characters written, 0 if text is too small
+*/
+/**************************************************************************/
+size_t Telemetry_Encoder::getText(char *text, size_t size)
+{
+    size_t chars = (length * 4 + 2) / 3;
+    uint32_t bits = 0;
+    uint8_t bitCount = 0;
+    size_t idx = 0;
+
+    if (size < chars + 1)
+        return 0;
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        bits = bits << 8 | payload[i];
+        bitCount += 8;
+        while (bitCount >= 6)
+        {
+            bitCount -= 6;
+            text[idx++] = base64Char((bits >> bitCount) & 0x3F);
+        }
+    }
+    if (bitCount)
+        text[idx++] = base64Char((bits << (6 - bitCount)) & 0x3F);
+
+    text[idx] = '\0';
+    return idx;
+}
+
+/**************************************************************************/
+/*!
+    @brief Start decoding a message
+    @param text Base64 text made by Telemetry_Encoder::getText(), must stay
+   valid until the last next()
+    @returns True if the message has a known version, False otherwise
+*/
+/**************************************************************************/
+bool Telemetry_Decoder::begin(const char *text)
+{
+    clear();
+    this->text = text;
+    bits = 0;
+    bitCount = 0;
+    error = false;
+
+    if (readByte() != TELEMETRY_VERSION)
+        error = true;
+
+    return !error;
+}
+
+/**************************************************************************/
+/*!
+    @brief Decode the next point
+    @param point Filled with the point
+    @returns True if a point was decoded, False at the end of the message or
+   on an error, see hasError()
+*/
+/**************************************************************************/
+bool Telemetry_Decoder::next(telemetry_point &point)
+{
+    if (error || text == NULL)
+        return false;
+
+    int16_t mask = readByte();
+    if (mask < 0) ///< End of the message, unless readByte() found a bad character
+        return false;
+
+    if (mask & ~(MASK_TIME | MASK_POSITION | MASK_ALTITUDE | MASK_HDOP | MASK_STATUS))
+    {
+        error = true;
+        return false;
+    }
+
+    int32_t fields[FIELD_COUNT];
+    for (uint8_t i = 0; i < FIELD_COUNT; i++)
+    {
+        uint32_t value = 0;
+
+        if ((mask & fieldMask[i]) && !readVarint(value))
+        {
+            error = true;
+            return false;
+        }
+        fields[i] = (int32_t)((uint32_t)predict(i) + (uint32_t)unzigzag(value));
+    }
+
+    advance(fields);
+
+    point.time = (uint32_t)fields[FIELD_TIME];
+    point.latitude = fields[FIELD_LATITUDE] * 100;
+    point.longitude = fields[FIELD_LONGITUDE] * 100;
+    point.altitude = fields[FIELD_ALTITUDE] * 10;
+    point.hdop = fields[FIELD_HDOP] * 10;
+    point.satellites = fields[FIELD_STATUS] & 0x3F;
+    point.fix_type = (fields[FIELD_STATUS] >> 6) & 0x0F;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Check if decoding stopped on a malformed or truncated message
+    @returns True if the message was bad
+*/
+/**************************************************************************/
+bool Telemetry_Decoder::hasError(void) { return error; }
+
+/**************************************************************************/
+/*!
+    @brief Decode the next byte from the base64 text. Leftover bits at the
+   end of the text are padding.
+    @returns The byte, -1 at the end of the text or on a bad character
+*/
+/**************************************************************************/
+int16_t Telemetry_Decoder::readByte(void)
+{
+    while (bitCount < 8)
+    {
+        if (*text == '\0' || *text == '=')
+            return -1;
+
+        int8_t value = base64Value(*text++);
+        if (value < 0)
+        {
+            error = true;
+            return -1;
+        }
+
+        bits = bits << 6 | value;
+        bitCount += 6;
+    }
+
+    bitCount -= 8;
+    uint8_t c = bits >> bitCount;
+    bits &= (1 << bitCount) - 1;
+    return c;
+}
+
+/**************************************************************************/
+/*!
+    @brief Decode a varint
+    @param value Filled with the value
+    @returns True on success, False if the text ended or the varint is too long
+*/
+/**************************************************************************/
+bool Telemetry_Decoder::readVarint(uint32_t &value)
+{
+    value = 0;
+
+    for (uint8_t shift = 0; shift < 35; shift += 7)
+    {
+        int16_t c = readByte();
+        if (c < 0)
+            return false;
+
+        value |= (uint32_t)(c & 0x7F) << shift;
+        if (!(c & 0x80))
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,115 @@
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#ifdef ARDUINO
+#include "NMEA_Parser.h"
+#else ///< The decoder also builds on a host, e.g. for the server receiving the SMS
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#ifndef TELEMETRY_PAYLOAD_SIZE
+#define TELEMETRY_PAYLOAD_SIZE 120 ///< packed bytes per message, 120 fill the 160 characters of one SMS
+#endif
+
+#if TELEMETRY_PAYLOAD_SIZE < 8 || TELEMETRY_PAYLOAD_SIZE > 255
+#error "TELEMETRY_PAYLOAD_SIZE must be between 8 and 255"
+#endif
+
+#define TELEMETRY_VERSION 1 ///< format written in the first byte of every message
+
+#define TELEMETRY_TEXT_SIZE ((TELEMETRY_PAYLOAD_SIZE * 4 + 2) / 3 + 1) ///< base64 text of a full payload plus terminator
+
+#define TELEMETRY_UNIX_OFFSET 946684800UL ///< add to telemetry_point.time for a Unix time stamp
+
+/**************************************************************************/
+/*!
+    @brief One position report. The units match gnss_fix, but the encoder
+   keeps latitude and longitude to 1e-5 degrees (about 1 m), altitude to
+   decimeters and hdop to tenths.
+*/
+/**************************************************************************/
+typedef struct
+{
+    uint32_t time;      ///< Seconds since 2000-01-01 00:00:00 UTC
+    int32_t latitude;   ///< Latitude in 1e-7 degrees, north positive
+    int32_t longitude;  ///< Longitude in 1e-7 degrees, east positive
+    int32_t altitude;   ///< Altitude above mean sea level in centimeters
+    uint16_t hdop;      ///< Horizontal dilution of precision x100
+    uint8_t satellites; ///< Number of satellites used, up to 63
+    uint8_t fix_type;   ///< GGA fix quality, up to 15
+} telemetry_point;
+
+/**************************************************************************/
+/*!
+    @brief State shared by the encoder and the decoder. Every point is stored
+   as the difference to what the previous points predict: the same interval,
+   the same velocity, the same altitude, hdop and satellites. Each point
+   starts with a byte telling which fields differ, followed by those
+   differences as zigzag varints, so a vehicle at steady speed costs about
+   three bytes per point and a parked one a single byte.
+*/
+/**************************************************************************/
+class Telemetry_Predictor
+{
+public:
+    void clear(void);
+
+protected:
+    int32_t predict(uint8_t field);
+    void advance(const int32_t *fields);
+
+    uint8_t count = 0;    ///< Points encoded or decoded so far
+    int32_t last[6] = {}; ///< Quantized time, latitude, longitude, altitude, hdop and status of the last point
+    int32_t step[3] = {}; ///< Last change of time, latitude and longitude
+};
+
+/**************************************************************************/
+/*!
+    @brief Packs position reports into one SMS worth of base64 text. Only
+   characters of the GSM 7-bit default alphabet are used, so the text can be
+   sent with MC60::sendSMS() as it is.
+*/
+/**************************************************************************/
+class Telemetry_Encoder : public Telemetry_Predictor
+{
+public:
+    void clear(void);
+    bool add(const telemetry_point &point);
+#ifdef ARDUINO
+    bool add(const gnss_fix &fix);
+#endif
+
+    uint8_t getCount(void);
+    uint8_t getLength(void);
+    size_t getText(char *text, size_t size);
+
+private:
+    uint8_t payload[TELEMETRY_PAYLOAD_SIZE]; ///< Version byte followed by the packed points
+    uint8_t length = 0;                      ///< Bytes used in payload
+};
+
+/**************************************************************************/
+/*!
+    @brief Unpacks the text made by Telemetry_Encoder. Decodes straight from
+   the text, so it needs no buffer and accepts any payload size.
+*/
+/**************************************************************************/
+class Telemetry_Decoder : public Telemetry_Predictor
+{
+public:
+    bool begin(const char *text);
+    bool next(telemetry_point &point);
+    bool hasError(void);
+
+private:
+    int16_t readByte(void);
+    bool readVarint(uint32_t &value);
+
+    const char *text = NULL; ///< Next base64 character
+    uint16_t bits = 0;       ///< Decoded bits not returned yet
+    uint8_t bitCount = 0;    ///< Number of bits in bits
+    bool error = false;      ///< The text is malformed or truncated
+};
+
+#endif
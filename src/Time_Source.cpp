@@ -0,0 +1,71 @@
+#include "Time_Source.h"
+
+Time_Source ArduinoTime;
+
+Time_Source::~Time_Source() = default;
+
+/**************************************************************************/
+/*!
+    @brief Current time
+    @return Milliseconds since start
+*/
+/**************************************************************************/
+unsigned long Time_Source::millis(void) { return ::millis(); }
+
+/**************************************************************************/
+/*!
+    @brief Wait
+    @param ms How long to wait in milliseconds
+*/
+/**************************************************************************/
+void Time_Source::delay(unsigned long ms) { ::delay(ms); }
+
+/**************************************************************************/
+/*!
+    @brief Constructor
+    @param step How many milliseconds pass on every millis() call, so that
+   busy-wait loops reach their timeouts (optional, default = 1)
+*/
+/**************************************************************************/
+Virtual_Time_Source::Virtual_Time_Source(unsigned long step) : step(step) {}
+
+/**************************************************************************/
+/*!
+    @brief Current simulated time, moving the clock forward by one step
+    @return Simulated milliseconds since start
+*/
+/**************************************************************************/
+unsigned long Virtual_Time_Source::millis(void)
+{
+    unsigned long current = now;
+    now += step;
+    return current;
+}
+
+/**************************************************************************/
+/*!
+    @brief Move the clock forward instead of waiting
+    @param ms How long to wait in simulated milliseconds
+*/
+/**************************************************************************/
+void Virtual_Time_Source::delay(unsigned long ms)
+{
+    now += ms;
+    delayed += ms;
+}
+
+/**************************************************************************/
+/*!
+    @brief Move the clock forward, e.g. to let a simulated response arrive
+    @param ms Simulated milliseconds to add
+*/
+/**************************************************************************/
+void Virtual_Time_Source::advance(unsigned long ms) { now += ms; }
+
+/**************************************************************************/
+/*!
+    @brief Total time spent in delay()
+    @return Simulated milliseconds
+*/
+/**************************************************************************/
+unsigned long Virtual_Time_Source::getDelayed(void) { return delayed; }
@@ -0,0 +1,47 @@
+#ifndef __TIME_SOURCE_H__
+#define __TIME_SOURCE_H__
+
+#include <Arduino.h>
+
+/**************************************************************************/
+/*!
+    @brief  Clock used for every timeout and delay in this library. The base
+   class uses the Arduino millis() and delay().
+*/
+/**************************************************************************/
+class Time_Source
+{
+public:
+    virtual ~Time_Source();
+
+    virtual unsigned long millis(void);
+    virtual void delay(unsigned long ms);
+};
+
+/**************************************************************************/
+/*!
+    @brief  Simulated clock for running timeouts faster than real time. Time
+   only moves when it is read, delayed or advanced, so thousands of timeout
+   scenarios finish in well under a second.
+*/
+/**************************************************************************/
+class Virtual_Time_Source : public Time_Source
+{
+public:
+    Virtual_Time_Source(unsigned long step = 1);
+
+    unsigned long millis(void);
+    void delay(unsigned long ms);
+
+    void advance(unsigned long ms);
+    unsigned long getDelayed(void);
+
+private:
+    unsigned long now = 0;     ///< Current simulated time in milliseconds
+    unsigned long step;        ///< How far every millis() call moves the clock
+    unsigned long delayed = 0; ///< Total time spent in delay()
+};
+
+extern Time_Source ArduinoTime; ///< Default clock, backed by millis() and delay()
+
+#endif
@@ -0,0 +1,38 @@
+#include <Arduino.h>
+
+#include <chrono>
+#include <thread>
+
+static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+unsigned long millis(void)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+unsigned long micros(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+void yield(void) { std::this_thread::yield(); }
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    (void)pin;
+    (void)value;
+}
+
+void noInterrupts(void) {}
+
+void interrupts(void) {}
+
+HardwareSerial Serial;
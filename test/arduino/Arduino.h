@@ -0,0 +1,197 @@
+#ifndef __ARDUINO_SHIM_H__
+#define __ARDUINO_SHIM_H__
+
+/**************************************************************************/
+/*!
+    @brief  The parts of the Arduino core this library uses, for building and
+   testing it on a host. Serial ports are not emulated, pass MC60_Simulator,
+   Posix_Serial or any other Stream to the constructors.
+*/
+/**************************************************************************/
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+#ifdef __ELF__
+#define PROGMEM __attribute__((section(".progmem.data"))) ///< Same section as avr-gcc, so size -A shows what would stay in flash
+#else
+#define PROGMEM
+#endif
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_ptr(p) (*(void *const *)(p))
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define memcpy_P memcpy
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void yield(void);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+void noInterrupts(void);
+void interrupts(void);
+
+/**************************************************************************/
+/*!
+    @brief  Arduino String on top of std::string
+*/
+/**************************************************************************/
+class String
+{
+public:
+    String() {}
+    String(const char *c) : s(c ? c : "") {}
+    String(char c) : s(1, c) {}
+    String(int v) : s(std::to_string(v)) {}
+    String(unsigned v) : s(std::to_string(v)) {}
+    String(long v) : s(std::to_string(v)) {}
+    String(unsigned long v) : s(std::to_string(v)) {}
+
+    const char *c_str() const { return s.c_str(); }
+    unsigned length() const { return s.size(); }
+    bool reserve(unsigned size)
+    {
+        s.reserve(size);
+        return true;
+    }
+    char charAt(unsigned i) const { return (*this)[i]; }
+    char operator[](unsigned i) const { return i < s.size() ? s[i] : 0; }
+    String substring(unsigned from, unsigned to) const
+    {
+        String r;
+        if (from < s.size())
+            r.s = s.substr(from, to - from);
+        return r;
+    }
+    long toInt() const { return atol(s.c_str()); }
+    float toFloat() const { return atof(s.c_str()); }
+    double toDouble() const { return atof(s.c_str()); }
+
+    String &operator+=(char c)
+    {
+        s += c;
+        return *this;
+    }
+    String &operator+=(const char *c)
+    {
+        s += c;
+        return *this;
+    }
+    String &operator+=(const String &c)
+    {
+        s += c.s;
+        return *this;
+    }
+    bool operator==(const char *c) const { return s == c; }
+
+private:
+    std::string s;
+};
+
+inline String operator+(const String &a, const String &b)
+{
+    String r = a;
+    r += b;
+    return r;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Arduino Print, only the members used by this library
+*/
+/**************************************************************************/
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        size_t n = 0;
+        while (size--)
+            n += write(*buffer++);
+        return n;
+    }
+    size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+    virtual void flush() {}
+
+    size_t print(const char *s) { return write(s); }
+    size_t print(const __FlashStringHelper *s) { return write((const char *)s); }
+    size_t print(const String &s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned long v, int base = 10)
+    {
+        char b[24];
+        snprintf(b, sizeof(b), base == 16 ? "%lX" : "%lu", v);
+        return write(b);
+    }
+    size_t print(long v, int base = 10)
+    {
+        (void)base;
+        char b[24];
+        snprintf(b, sizeof(b), "%ld", v);
+        return write(b);
+    }
+    size_t print(unsigned v, int base = 10) { return print((unsigned long)v, base); }
+    size_t print(int v, int base = 10) { return print((long)v, base); }
+    size_t print(uint8_t v, int base = 10) { return print((unsigned long)v, base); }
+    size_t println(const char *s = "") { return write(s) + write("\r\n"); }
+};
+
+/**************************************************************************/
+/*!
+    @brief  Arduino Stream, only the members used by this library
+*/
+/**************************************************************************/
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Serial port that is never connected
+*/
+/**************************************************************************/
+class HardwareSerial : public Stream
+{
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    size_t write(uint8_t c)
+    {
+        (void)c;
+        return 1;
+    }
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles" ///< Unit of benchTicks()
+#else
+#define BENCH_UNIT "ns" ///< Unit of benchTicks()
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Timestamp for the host benchmarks, the time stamp counter on x86
+   and nanoseconds elsewhere
+    @returns Ticks in BENCH_UNIT
+*/
+/**************************************************************************/
+static inline uint64_t benchTicks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief  Wall clock for rates, in microseconds
+    @returns Microseconds since an arbitrary start
+*/
+/**************************************************************************/
+static inline uint64_t benchMicros(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/// Keeps the compiler from optimizing a benchmarked result away
+#define BENCH_KEEP(value) __asm__ __volatile__("" : : "g"(&(value)) : "memory")
+
+#endif
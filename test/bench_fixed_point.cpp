@@ -0,0 +1,71 @@
+#include "NMEA_Parser.h"
+#include "bench.h"
+#include "legacy/gga_float.h"
+
+// GGA parse cost of the integer fixed-point NMEA_Parser against the floating
+// point parser it replaced, see the size_gnss target for the code size.
+
+int main()
+{
+    static const char gga[] = "$GNGGA,123519.000,4807.0380,N,01131.0000,E,1,08,0.9,545.4,M,46.9,M,,*47";
+    const uint32_t rounds = 50000;
+
+    float_fix old;
+    uint64_t start = benchTicks();
+    for (uint32_t i = 0; i < rounds; i++)
+    {
+        floatParseGGA(gga, old);
+        BENCH_KEEP(old);
+    }
+    uint64_t floatTicks = (benchTicks() - start) / rounds;
+
+    NMEA_Parser parser;
+    bool accepted = true;
+    start = benchTicks();
+    for (uint32_t i = 0; i < rounds; i++)
+    {
+        accepted &= parser.parse(gga);
+        BENCH_KEEP(parser.getFix());
+    }
+    uint64_t fixedTicks = (benchTicks() - start) / rounds;
+    const gnss_fix &fix = parser.getFix();
+
+    // The same bytes as an unsupported type, to take framing and checksum out
+    char other[sizeof(gga)];
+    memcpy(other, gga, sizeof(gga));
+    memcpy(other + 3, "ZZZ", 3);
+    uint8_t checksum = 0;
+    for (const char *p = other + 1; *p != '*'; p++)
+        checksum ^= *p;
+    snprintf(strchr(other, '*') + 1, 3, "%02X", checksum);
+
+    NMEA_Parser framing;
+    start = benchTicks();
+    for (uint32_t i = 0; i < rounds; i++)
+    {
+        accepted &= !framing.parse(other);
+        BENCH_KEEP(framing);
+    }
+    uint64_t framingTicks = (benchTicks() - start) / rounds;
+    uint64_t fieldTicks = fixedTicks > framingTicks ? fixedTicks - framingTicks : 0;
+
+    printf("GGA parse, %lu rounds, on a host with an FPU (AVR has none, float is soft-float there)\n",
+           (unsigned long)rounds);
+    printf("  float:       %5llu %s, %u bytes of fields\n", (unsigned long long)floatTicks, BENCH_UNIT,
+           (unsigned)sizeof(float_fix));
+    printf("  fixed-point: %5llu %s, %u bytes of fields, plus %llu %s framing and checksum\n",
+           (unsigned long long)fieldTicks, BENCH_UNIT, (unsigned)sizeof(gnss_fix),
+           (unsigned long long)framingTicks, BENCH_UNIT);
+
+    // Both describe the same position, to within the float's resolution
+    double floatLatitude = old.latitude_degrees + old.latitude_minutes / 60.0 + old.latitude_seconds / 3600.0;
+    double fixedLatitude = fix.latitude / 1e7;
+    printf("  latitude:    %.7f float, %.7f fixed-point\n", floatLatitude, fixedLatitude);
+
+    bool same = accepted && fabs(floatLatitude - fixedLatitude) < 1e-6 &&
+                fix.altitude == (int32_t)lround(old.altitude * 100) &&
+                fix.hdop == (uint16_t)lround(old.horizontal_dilution * 100);
+    if (!same)
+        printf("Results differ\n");
+    return same ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#include "MC60_Fleet.h"
+#include "MC60_Simulator.h"
+#include "bench.h"
+
+// Throughput of one MC60_Fleet loop driving 1 to 64 simulated modems, each
+// sending an SMS and reading its position and status every round.
+
+#define ROUNDS 10
+
+static uint32_t finished = 0; ///< Work finished with RESULT_OK
+static uint32_t failed = 0;   ///< Work finished with anything else
+
+static void onWork(uint8_t modem, fleet_work work, command_result result, void *context)
+{
+    (void)modem;
+    (void)work;
+    (void)context;
+    if (result == RESULT_OK)
+        finished++;
+    else
+        failed++;
+}
+
+int main()
+{
+    static const uint8_t sizes[] = {1, 2, 4, 8, 16, 32, 64};
+    bool ok = true;
+
+    printf("Fleet of simulated modems at 115200 baud with 20 ms latency, %u rounds\n", ROUNDS);
+    for (uint8_t run = 0; run < sizeof(sizes) / sizeof(sizes[0]); run++)
+    {
+        uint8_t modems = sizes[run];
+        if (modems > FLEET_MAX_MODEMS)
+            break;
+
+        Virtual_Time_Source time(0);
+        MC60_Simulator *sims[FLEET_MAX_MODEMS];
+        MC60 *mc60s[FLEET_MAX_MODEMS];
+        MC60_Fleet *fleet = new MC60_Fleet();
+        fleet->onComplete(onWork);
+
+        for (uint8_t i = 0; i < modems; i++)
+        {
+            sims[i] = new MC60_Simulator(115200);
+            sims[i]->setTimeSource(&time);
+            sims[i]->setLatency(20);
+            mc60s[i] = new MC60(sims[i]);
+            mc60s[i]->setTimeSource(&time);
+            (void)fleet->add(mc60s[i]);
+        }
+
+        finished = failed = 0;
+        uint64_t start = benchMicros();
+        unsigned long simulated = time.millis();
+        for (uint8_t round = 0; round < ROUNDS; round++)
+        {
+            for (uint8_t i = 0; i < modems; i++)
+                (void)fleet->queueSMS(i, "+905551234567", "fleet alert");
+            (void)fleet->requestGNSS();
+            (void)fleet->requestStatus();
+
+            while (!fleet->isIdle())
+            {
+                fleet->poll();
+                time.advance(1);
+            }
+        }
+        uint64_t cpu = benchMicros() - start;
+        simulated = time.millis() - simulated;
+        uint32_t commands = fleet->getCommandCount();
+
+        printf("  %2u modems: %5lu commands in %5lu simulated ms, %6.0f commands/s, %5.2f us CPU per command\n",
+               modems, (unsigned long)commands, simulated, commands * 1000.0 / simulated, (double)cpu / commands);
+        ok &= failed == 0 && finished == 3UL * ROUNDS * modems;
+
+        for (uint8_t i = 0; i < modems; i++)
+        {
+            delete mc60s[i];
+            delete sims[i];
+        }
+        delete fleet;
+    }
+
+    return ok ? 0 : 1;
+}
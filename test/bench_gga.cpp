@@ -0,0 +1,152 @@
+#include "NMEA_Parser.h"
+#include "bench.h"
+
+#include <new>
+
+// GGA parse cost of the single-pass NMEA_Parser against the String and
+// getValue() code readGPS() used before, which is copied below.
+
+static uint32_t heapAllocations = 0; ///< operator new calls
+static uint32_t heapBytes = 0;       ///< Bytes currently allocated
+static uint32_t heapPeak = 0;        ///< Most bytes allocated at once
+
+void *operator new(size_t size)
+{
+    size_t *block = (size_t *)malloc(size + sizeof(max_align_t));
+    if (!block)
+        throw std::bad_alloc();
+    *block = size;
+    heapAllocations++;
+    heapBytes += size;
+    if (heapBytes > heapPeak)
+        heapPeak = heapBytes;
+    return (char *)block + sizeof(max_align_t);
+}
+
+void operator delete(void *p) noexcept
+{
+    if (!p)
+        return;
+    size_t *block = (size_t *)((char *)p - sizeof(max_align_t));
+    heapBytes -= *block;
+    free(block);
+}
+
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+
+/// The GPS fields of the old MC60 class
+typedef struct
+{
+    uint8_t hour, minute, second, millisecond;
+    double latitude_degrees, latitude_seconds;
+    uint32_t latitude_minutes;
+    char latitude_direction;
+    double longitude_degrees, longitude_seconds;
+    uint32_t longitude_minutes;
+    char longitude_direction;
+    uint8_t fix_type, number_of_satellites;
+    float horizontal_dilution, altitude, geoidal_separation;
+    uint16_t age_of_differential, differential_reference_station_id;
+} legacy_fix;
+
+/// MC60::getValue() of the original library
+static String getValue(String data, char separator, int index)
+{
+    int found = 0;
+    int strIndex[] = {0, -1};
+    int maxIndex = data.length() - 1;
+
+    for (int i = 0; i <= maxIndex && found <= index; i++)
+    {
+        if (data.charAt(i) == separator || i == maxIndex)
+        {
+            found++;
+            strIndex[0] = strIndex[1] + 1;
+            strIndex[1] = (i == maxIndex) ? i + 1 : i;
+        }
+    }
+
+    return found > index ? data.substring(strIndex[0], strIndex[1]) : "";
+}
+
+/// The body of the original MC60::readGPS() after readline()
+static void legacyParse(const String &ggaString, legacy_fix &f)
+{
+    f.hour = getValue(ggaString, ',', 1).substring(0, 2).toInt();
+    f.minute = getValue(ggaString, ',', 1).substring(2, 4).toInt();
+    f.second = getValue(ggaString, ',', 1).substring(4, 6).toInt();
+    f.millisecond = getValue(ggaString, ',', 1).substring(7, 9).toInt();
+
+    double decimalDegreeMinuteLat = getValue(ggaString, ',', 2).toDouble();
+    f.latitude_direction = getValue(ggaString, ',', 3)[0];
+    f.latitude_degrees = decimalDegreeMinuteLat / 100;
+    f.latitude_degrees *= f.latitude_direction == 'N' ? 1 : -1;
+    f.latitude_minutes = (uint32_t)decimalDegreeMinuteLat % 100;
+    f.latitude_seconds = fmod(decimalDegreeMinuteLat, 1) * 60;
+
+    double decimalDegreeMinuteLon = getValue(ggaString, ',', 4).toDouble();
+    f.longitude_direction = getValue(ggaString, ',', 5)[0];
+    f.longitude_degrees = decimalDegreeMinuteLon / 100;
+    f.longitude_degrees *= f.longitude_direction == 'E' ? 1 : -1;
+    f.longitude_minutes = (uint32_t)decimalDegreeMinuteLon % 100;
+    f.longitude_seconds = fmod(decimalDegreeMinuteLon, 1) * 60;
+
+    f.fix_type = getValue(ggaString, ',', 6).toInt();
+    f.number_of_satellites = getValue(ggaString, ',', 7).toInt();
+    f.horizontal_dilution = getValue(ggaString, ',', 8).toFloat();
+    f.altitude = getValue(ggaString, ',', 9).toFloat();
+    f.geoidal_separation = getValue(ggaString, ',', 11).toFloat();
+    f.age_of_differential = getValue(ggaString, ',', 13).toInt();
+    f.differential_reference_station_id = getValue(ggaString, ',', 14).toInt();
+}
+
+int main()
+{
+    static const char gga[] = "$GNGGA,123519.000,4807.0380,N,01131.0000,E,1,08,0.9,545.4,M,46.9,M,,*47";
+    const uint32_t rounds = 20000;
+
+    String sentence(gga);
+    legacy_fix old;
+    heapAllocations = 0;
+    heapPeak = heapBytes;
+    uint32_t heapBase = heapBytes;
+    uint64_t start = benchTicks();
+    for (uint32_t i = 0; i < rounds; i++)
+    {
+        legacyParse(sentence, old);
+        BENCH_KEEP(old);
+    }
+    uint64_t legacyTicks = (benchTicks() - start) / rounds;
+    uint32_t legacyAllocations = heapAllocations / rounds;
+    uint32_t legacyPeak = heapPeak - heapBase;
+
+    NMEA_Parser parser;
+    bool accepted = true;
+    heapAllocations = 0;
+    heapPeak = heapBytes;
+    heapBase = heapBytes;
+    start = benchTicks();
+    for (uint32_t i = 0; i < rounds; i++)
+    {
+        accepted &= parser.parse(gga);
+        BENCH_KEEP(parser.getFix());
+    }
+    uint64_t parserTicks = (benchTicks() - start) / rounds;
+    uint32_t parserAllocations = heapAllocations / rounds;
+    uint32_t parserPeak = heapPeak - heapBase;
+
+    printf("GGA parse, %lu rounds\n", (unsigned long)rounds);
+    printf("  getValue():  %6llu %s, %2lu heap allocations, %4lu bytes peak heap\n",
+           (unsigned long long)legacyTicks, BENCH_UNIT, (unsigned long)legacyAllocations,
+           (unsigned long)legacyPeak);
+    printf("  NMEA_Parser: %6llu %s, %2lu heap allocations, %4lu bytes peak heap (checksum checked)\n",
+           (unsigned long long)parserTicks, BENCH_UNIT, (unsigned long)parserAllocations,
+           (unsigned long)parserPeak);
+    printf("  Substrings up to 15 characters fit std::string's inline buffer here, Arduino String allocates them too\n");
+
+    bool same = accepted && parser.getFix().satellites == old.number_of_satellites &&
+                parser.getFix().hour == old.hour && parser.getFix().altitude == (int32_t)lround(old.altitude * 100);
+    if (!same)
+        printf("Results differ\n");
+    return same && parserAllocations == 0 ? 0 : 1;
+}
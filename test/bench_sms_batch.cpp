@@ -0,0 +1,53 @@
+#include "MC60.h"
+#include "MC60_Simulator.h"
+#include "bench.h"
+
+// Messages per minute of sendSMSBatch() against one sendSMS() per message,
+// with a simulated network that takes LINK_SETUP ms to set up the relay link
+
+#define LINK_SETUP 2000
+#define MESSAGES 10
+
+int main()
+{
+    static const char *const recipients[MESSAGES] = {
+        "+905550000001", "+905550000002", "+905550000003", "+905550000004", "+905550000005",
+        "+905550000006", "+905550000007", "+905550000008", "+905550000009", "+905550000010"};
+    bool ok = true;
+
+    printf("SMS throughput, %u messages, %u ms relay link setup, 20 ms latency\n", MESSAGES, LINK_SETUP);
+    for (uint8_t batched = 0; batched < 2; batched++)
+    {
+        Virtual_Time_Source time;
+        MC60_Simulator sim(115200);
+        sim.setTimeSource(&time);
+        sim.setLatency(20);
+        sim.setSMSLinkSetup(LINK_SETUP);
+        MC60 mc60(&sim);
+        mc60.setTimeSource(&time);
+        ok &= mc60.sendAT(); ///< Keep the first command out of the measurement
+
+        unsigned long start = time.millis();
+        uint8_t sent = 0;
+        if (batched)
+        {
+            sms_message batch[MESSAGES];
+            for (uint8_t i = 0; i < MESSAGES; i++)
+            {
+                batch[i].number = recipients[i];
+                batch[i].message = "Batch benchmark";
+            }
+            sent = mc60.sendSMSBatch(batch, MESSAGES);
+        }
+        else
+            for (uint8_t i = 0; i < MESSAGES; i++)
+                sent += mc60.sendSMS(recipients[i], "Batch benchmark");
+        unsigned long elapsed = time.millis() - start;
+
+        printf("  %-15s %2u sent in %6lu simulated ms, %5.1f messages per minute\n",
+               batched ? "sendSMSBatch():" : "sendSMS():", sent, elapsed, sent * 60000.0 / elapsed);
+        ok &= sent == MESSAGES && sim.getSentSMSCount() == MESSAGES;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+#include "Telemetry.h"
+#include "bench.h"
+#include "track.h"
+
+// Points per SMS and encode time of Telemetry_Encoder on a synthetic drive
+// at a few report intervals, against plain text reports.
+
+#define TRACK_POINTS 2000
+
+int main()
+{
+    static telemetry_point track[TRACK_POINTS];
+    static const uint16_t intervals[] = {1, 10, 30, 60};
+    bool ok = true;
+
+    printf("Telemetry packing, %u points per run, %u byte payload\n", TRACK_POINTS, TELEMETRY_PAYLOAD_SIZE);
+    for (uint8_t run = 0; run < sizeof(intervals) / sizeof(intervals[0]); run++)
+    {
+        makeTrack(track, TRACK_POINTS, intervals[run]);
+
+        Telemetry_Encoder encoder;
+        char text[TELEMETRY_TEXT_SIZE];
+        uint16_t messages = 0;
+        uint16_t sent = 0;
+        uint64_t ticks = 0;
+
+        while (sent < TRACK_POINTS)
+        {
+            encoder.clear();
+            uint16_t first = sent;
+            uint64_t start = benchTicks();
+            while (sent < TRACK_POINTS && encoder.add(track[sent]))
+                sent++;
+            (void)encoder.getText(text, sizeof(text));
+            ticks += benchTicks() - start;
+            BENCH_KEEP(text);
+            messages++;
+            ok &= sent > first;
+        }
+
+        printf("  every %2us: %5.1f points per SMS, %3llu %s per point\n", intervals[run],
+               (double)TRACK_POINTS / messages, (unsigned long long)(ticks / TRACK_POINTS), BENCH_UNIT);
+    }
+
+    // The same fields as a line of text
+    static const char line[] = "845208010,41.00820,28.97840,42.0,0.9,8;";
+    printf("  plain text: %5.1f points per SMS\n", 160.0 / (sizeof(line) - 1));
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,32 @@
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+#include <stdio.h>
+
+/**************************************************************************/
+/*!
+    @brief  Minimal assertions for the host tests. A failed CHECK() is printed
+   and counted, CHECK_DONE() turns the count into the exit status for ctest.
+*/
+/**************************************************************************/
+
+static int checkFailures = 0; ///< Failed CHECK()s in this test program
+
+#define CHECK(condition)                                                           \
+    do                                                                             \
+    {                                                                              \
+        if (!(condition))                                                          \
+        {                                                                          \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            checkFailures++;                                                       \
+        }                                                                          \
+    } while (0)
+
+#define CHECK_DONE()                                                    \
+    do                                                                  \
+    {                                                                   \
+        printf("%s\n", checkFailures ? "FAILED" : "passed");            \
+        return checkFailures ? 1 : 0;                                   \
+    } while (0)
+
+#endif
@@ -0,0 +1,155 @@
+#include "gga_float.h"
+
+#include <stddef.h>
+
+// The single-pass GGA parser MC60 had before the fix moved to integer
+// fixed-point, kept to measure what the move saved.
+
+/**************************************************************************/
+/*!
+    @brief Check if a character terminates an NMEA field
+    @param c Character to check
+    @returns True on ',', '*' or the end of the string
+*/
+/**************************************************************************/
+static inline bool isFieldEnd(char c)
+{
+    return c == ',' || c == '*' || c == '\0';
+}
+
+/**************************************************************************/
+/*!
+    @brief Parse an unsigned integer from the start of a field
+    @param p Pointer to the field, advanced past the digits
+    @param maxDigits Maximum number of digits to consume (optional)
+    @returns Parsed value, 0 if the field is empty
+*/
+/**************************************************************************/
+static uint32_t parseUnsigned(const char *&p, uint8_t maxDigits = 10)
+{
+    uint32_t value = 0;
+
+    while (maxDigits-- && *p >= '0' && *p <= '9')
+        value = value * 10 + (*p++ - '0');
+
+    return value;
+}
+
+/**************************************************************************/
+/*!
+    @brief Parse a signed decimal number from the start of a field
+    @param p Pointer to the field, advanced past the number
+    @param fraction Set to the fractional part of the number (optional)
+    @returns Parsed value, 0 if the field is empty
+*/
+/**************************************************************************/
+static double parseDecimal(const char *&p, double *fraction = NULL)
+{
+    bool negative = *p == '-';
+    if (negative || *p == '+')
+        p++;
+
+    uint32_t integer = parseUnsigned(p);
+    uint32_t decimals = 0;
+    uint32_t scale = 1;
+
+    if (*p == '.')
+        for (p++; *p >= '0' && *p <= '9'; p++)
+            if (scale < 100000000UL) ///< Ignore digits that would overflow
+            {
+                decimals = decimals * 10 + (*p - '0');
+                scale *= 10;
+            }
+
+    double frac = (double)decimals / scale;
+    if (fraction)
+        *fraction = frac;
+
+    double value = integer + frac;
+    return negative ? -value : value;
+}
+
+/**************************************************************************/
+/*!
+    @brief Parse a GGA sentence into the fields in a single pass
+    @param sentence Null terminated GGA sentence, starting with the "$--GGA" field
+    @param f Fields to fill
+*/
+/**************************************************************************/
+void floatParseGGA(const char *sentence, float_fix &f)
+{
+    const char *p = sentence;
+    double fraction = 0;
+    uint32_t degreeMinutes = 0;
+
+    f.hour = f.minute = f.second = f.millisecond = 0;
+    f.latitude_degrees = f.latitude_minutes = 0;
+    f.longitude_degrees = f.longitude_minutes = 0;
+    f.latitude_seconds = f.longitude_seconds = 0;
+    f.latitude_direction = f.longitude_direction = '\0';
+    f.fix_type = f.number_of_satellites = 0;
+    f.horizontal_dilution = f.altitude = f.geoidal_separation = 0;
+    f.age_of_differential = f.differential_reference_station_id = 0;
+
+    for (uint8_t field = 0;; field++)
+    {
+        switch (field)
+        {
+        case 1: ///< hhmmss.ss
+            f.hour = parseUnsigned(p, 2);
+            f.minute = parseUnsigned(p, 2);
+            f.second = parseUnsigned(p, 2);
+            if (*p == '.')
+                f.millisecond = parseUnsigned(++p, 2);
+            break;
+        case 2: ///< ddmm.mmmm
+            degreeMinutes = (uint32_t)parseDecimal(p, &fraction);
+            f.latitude_degrees = degreeMinutes / 100;
+            f.latitude_minutes = degreeMinutes % 100;
+            f.latitude_seconds = fraction * 60;
+            break;
+        case 3: ///< N/S
+            f.latitude_direction = isFieldEnd(*p) ? '\0' : *p;
+            f.latitude_degrees *= f.latitude_direction == 'N' ? 1 : -1;
+            break;
+        case 4: ///< dddmm.mmmm
+            degreeMinutes = (uint32_t)parseDecimal(p, &fraction);
+            f.longitude_degrees = degreeMinutes / 100;
+            f.longitude_minutes = degreeMinutes % 100;
+            f.longitude_seconds = fraction * 60;
+            break;
+        case 5: ///< E/W
+            f.longitude_direction = isFieldEnd(*p) ? '\0' : *p;
+            f.longitude_degrees *= f.longitude_direction == 'E' ? 1 : -1;
+            break;
+        case 6:
+            f.fix_type = parseUnsigned(p);
+            break;
+        case 7:
+            f.number_of_satellites = parseUnsigned(p);
+            break;
+        case 8:
+            f.horizontal_dilution = parseDecimal(p);
+            break;
+        case 9:
+            f.altitude = parseDecimal(p);
+            break;
+        case 11:
+            f.geoidal_separation = parseDecimal(p);
+            break;
+        case 13:
+            f.age_of_differential = parseUnsigned(p);
+            break;
+        case 14:
+            f.differential_reference_station_id = parseUnsigned(p);
+            break;
+        }
+
+        while (!isFieldEnd(*p)) ///< Skip whatever is left of the field
+            p++;
+
+        if (*p != ',')
+            return;
+        p++;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef __GGA_FLOAT_H__
+#define __GGA_FLOAT_H__
+
+#include <stdint.h>
+
+/**************************************************************************/
+/*!
+    @brief  The floating point GPS fields MC60 kept before gnss_fix, for
+   comparing against NMEA_Parser
+*/
+/**************************************************************************/
+typedef struct
+{
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t millisecond;
+    int8_t latitude_degrees;
+    uint8_t latitude_minutes;
+    double latitude_seconds;
+    char latitude_direction;
+    int16_t longitude_degrees;
+    uint8_t longitude_minutes;
+    double longitude_seconds;
+    char longitude_direction;
+    uint8_t fix_type;
+    uint8_t number_of_satellites;
+    float horizontal_dilution;
+    float altitude;
+    float geoidal_separation;
+    uint32_t age_of_differential;
+    uint32_t differential_reference_station_id;
+} float_fix;
+
+void floatParseGGA(const char *sentence, float_fix &fix);
+
+#endif
@@ -0,0 +1,21 @@
+#!/bin/sh
+# Section sizes of object files grouped the way avr-gcc places them: .text
+# stays in flash, .data, .rodata and .bss take SRAM, .progmem stays in flash
+# and is read with pgm_read_*(). Objects built for another host only
+# approximate an AVR build, pointers and code are larger, but the split
+# between SRAM and flash holds.
+# Usage: section_report.sh SIZE TITLE OBJECT...
+
+SIZE=$1
+TITLE=$2
+shift 2
+
+echo "$TITLE"
+printf "%8s %8s %8s  %s\n" code sram progmem object
+for object in "$@"; do
+    "$SIZE" -A "$object" | awk -v name="$(echo "$object" | sed 's|.*/\([^/]*/[^/]*\)$|\1|')" '
+        $1 ~ /^\.text/ { code += $2 }
+        $1 ~ /^\.(data|rodata|bss)/ { sram += $2 }
+        $1 ~ /^\.progmem/ { progmem += $2 }
+        END { printf "%8d %8d %8d  %s\n", code, sram, progmem, name }'
+done
@@ -0,0 +1,18 @@
+#!/bin/sh
+# Section sizes of object files and the sizes of their symbols matching a
+# pattern, for comparing two builds of the same code.
+# Usage: size_report.sh SIZE NM PATTERN OBJECT...
+
+SIZE=$1
+NM=$2
+PATTERN=$3
+shift 3
+
+"$SIZE" "$@"
+
+for object in "$@"; do
+    echo
+    echo "$(basename "$object"):"
+    "$NM" -S -C -t d --size-sort "$object" | grep -E "$PATTERN" |
+        awk '{ printf "  %6d  %s\n", $2, substr($0, index($0, $4)) }'
+done
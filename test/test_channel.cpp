@@ -0,0 +1,120 @@
+#include "Command_Channel.h"
+#include "MC60.h"
+#include "MC60_Simulator.h"
+#include "check.h"
+
+#include <atomic>
+#include <pthread.h>
+#include <unistd.h>
+
+// Many threads sharing one simulated modem through a Command_Channel. Build
+// with -DMC60_SANITIZE_THREAD=ON to run it under ThreadSanitizer.
+
+#define THREADS 8
+#define COMMANDS 50
+
+static Command_Channel *channel;
+static pthread_mutex_t countLock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t good = 0;
+static uint32_t bad = 0;
+static std::atomic<int> urcResult(RESULT_PENDING);
+
+/// One thread's mix of commands, each checked against the simulator's answer
+static void *worker(void *arg)
+{
+    uintptr_t id = (uintptr_t)arg;
+    char capture[32];
+    uint32_t ok = 0, wrong = 0;
+
+    for (uint32_t i = 0; i < COMMANDS; i++)
+    {
+        int16_t code = 0;
+        capture[0] = '\0';
+
+        switch ((id + i) % 4)
+        {
+        case 0:
+            ok += channel->execute("AT\r") == RESULT_OK;
+            break;
+        case 1:
+            ok += channel->execute("AT+CSQ\r", "+CSQ: ", DEFAULT_TIMEOUT, capture, sizeof(capture)) == RESULT_OK &&
+                  strcmp(capture, "17,0") == 0;
+            break;
+        case 2:
+            ok += channel->execute("AT+CREG?\r", "+CREG: ", DEFAULT_TIMEOUT, capture, sizeof(capture)) == RESULT_OK &&
+                  strcmp(capture, "0,1") == 0;
+            break;
+        default:
+            ok += channel->execute("AT+BOGUS\r", NULL, DEFAULT_TIMEOUT, NULL, 0, &code) == RESULT_ERROR && code == -1;
+            break;
+        }
+    }
+    wrong = COMMANDS - ok;
+
+    pthread_mutex_lock(&countLock);
+    good += ok;
+    bad += wrong;
+    pthread_mutex_unlock(&countLock);
+    return NULL;
+}
+
+/// Runs in the reader, where execute() must refuse instead of waiting for itself
+static void onRing(const char *line, void *context)
+{
+    (void)line;
+    (void)context;
+    urcResult = channel->execute("AT\r");
+}
+
+/// A request submitted while no reader runs
+static void *late(void *arg)
+{
+    *(command_result *)arg = channel->execute("AT\r");
+    return NULL;
+}
+
+int main()
+{
+    MC60_Simulator sim(115200);
+    sim.setSignalQuality(17);
+    MC60 mc60(&sim);
+    CHECK(mc60.onUnsolicited("RING", onRing));
+
+    Command_Channel shared(&mc60);
+    channel = &shared;
+    CHECK(shared.start());
+    CHECK(!shared.start()); ///< Only one reader
+
+    pthread_t threads[THREADS];
+    for (uintptr_t i = 0; i < THREADS; i++)
+        CHECK(pthread_create(&threads[i], NULL, worker, (void *)i) == 0);
+    for (uint8_t i = 0; i < THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    CHECK(good == THREADS * COMMANDS);
+    CHECK(bad == 0);
+    CHECK(shared.getCompleted() == THREADS * COMMANDS);
+    CHECK(shared.getMaxWaiting() > 1);
+
+    // URC handlers run in the reader. Only the reader may touch the port, so
+    // the line goes in while it is stopped.
+    shared.stop();
+    sim.injectUnsolicited("RING");
+    CHECK(shared.start());
+    for (uint16_t i = 0; i < 1000 && urcResult == RESULT_PENDING; i++)
+        usleep(1000);
+    CHECK(urcResult == RESULT_ERROR);
+
+    // Requests wait for a reader across stop() and start()
+    shared.stop();
+    command_result lateResult = RESULT_PENDING;
+    pthread_t waiter;
+    CHECK(pthread_create(&waiter, NULL, late, &lateResult) == 0);
+    usleep(20000);
+    CHECK(shared.start());
+    pthread_join(waiter, NULL);
+    CHECK(lateResult == RESULT_OK);
+    shared.stop();
+
+    CHECK_DONE();
+}
@@ -0,0 +1,73 @@
+#include "CMUX.h"
+#include "MC60.h"
+#include "MC60_Simulator.h"
+#include "check.h"
+
+int main()
+{
+    Virtual_Time_Source time;
+    MC60_Simulator sim(115200);
+    sim.setTimeSource(&time);
+    CMUX_Multiplexer mux(&sim);
+    mux.setTimeSource(&time);
+
+    // AT+CMUX=0, then SABM/UA on the control channel and every virtual channel
+    CHECK(mux.start());
+    CHECK(mux.isStarted());
+    CHECK(sim.isMultiplexed());
+    for (uint8_t dlci = 1; dlci <= CMUX_CHANNELS; dlci++)
+        CHECK(mux.getChannel(dlci)->isOpen());
+    CHECK(mux.getChannel(0) == NULL);
+    CHECK(mux.getChannel(CMUX_CHANNELS + 1) == NULL);
+
+    // An MC60 talks to the modem through UIH frames on DLCI 1
+    CMUX_Channel *channel = mux.getChannel(1);
+    MC60 mc60(channel);
+    mc60.setTimeSource(&time);
+    CHECK(mc60.getOperatorName() == "Simulated");
+    CHECK(mc60.getNetworkRegistration() == 1);
+    CHECK(mux.getFrameErrors() == 0);
+
+    // A frame with a bad FCS is counted and its data never reaches the channel
+    const uint8_t ring[] = "\r\nRING\r\n";
+    sim.injectCMUXFrame(1, ring, sizeof(ring) - 1, true);
+    time.delay(10);
+    CHECK(channel->available() == 0);
+    CHECK(mux.getFrameErrors() == 1);
+
+    // So is a frame longer than CMUX_FRAME_SIZE, the next good one gets through
+    uint8_t large[CMUX_FRAME_SIZE + 20];
+    memset(large, 'x', sizeof(large));
+    sim.injectCMUXFrame(1, large, sizeof(large));
+    time.delay(10);
+    CHECK(channel->available() == 0);
+    CHECK(mux.getDroppedFrames() == 1);
+    sim.injectCMUXFrame(1, ring, sizeof(ring) - 1);
+    time.delay(10);
+    CHECK(channel->available() == sizeof(ring) - 1);
+    while (channel->read() >= 0)
+        ;
+
+    // CLD closes the multiplexer and the modem takes AT commands again
+    mux.stop();
+    CHECK(!mux.isStarted());
+    CHECK(!sim.isMultiplexed());
+    CHECK(!channel->isOpen());
+    CHECK(mux.sendAT());
+
+    // A modem with fewer channels refuses the rest with DM
+    MC60_Simulator small(115200);
+    small.setTimeSource(&time);
+    small.setCMUXChannels(1);
+    CMUX_Multiplexer limited(&small);
+    limited.setTimeSource(&time);
+    CHECK(!limited.start());
+    CHECK(limited.isStarted());
+    CHECK(limited.getChannel(1)->isOpen());
+    for (uint8_t dlci = 2; dlci <= CMUX_CHANNELS; dlci++)
+        CHECK(!limited.getChannel(dlci)->isOpen());
+    limited.stop();
+    CHECK(!small.isMultiplexed());
+
+    CHECK_DONE();
+}
@@ -0,0 +1,106 @@
+#include "MC60_Fleet.h"
+#include "MC60_Simulator.h"
+#include "check.h"
+
+#define MODEMS 3
+
+static uint8_t finished[MODEMS][3];     ///< Work finished per modem and fleet_work
+static command_result lastResult[MODEMS]; ///< Result of the last SMS per modem
+
+static void onWork(uint8_t modem, fleet_work work, command_result result, void *context)
+{
+    (void)context;
+    finished[modem][work]++;
+    if (work == FLEET_SMS)
+        lastResult[modem] = result;
+}
+
+/// Poll the fleet until every modem is idle, or give up after a simulated minute
+static bool runFleet(MC60_Fleet &fleet, Virtual_Time_Source &time)
+{
+    for (uint32_t i = 0; i < 60000 && !fleet.isIdle(); i++)
+    {
+        fleet.poll();
+        time.advance(1);
+    }
+    return fleet.isIdle();
+}
+
+int main()
+{
+    Virtual_Time_Source time(0);
+    MC60_Simulator *sims[MODEMS];
+    MC60 *modems[MODEMS];
+    MC60_Fleet fleet;
+    fleet.onComplete(onWork);
+
+    for (uint8_t i = 0; i < MODEMS; i++)
+    {
+        sims[i] = new MC60_Simulator(115200);
+        sims[i]->setTimeSource(&time);
+        sims[i]->setLatency(20);
+        modems[i] = new MC60(sims[i]);
+        modems[i]->setTimeSource(&time);
+        CHECK(fleet.add(modems[i]) == i);
+    }
+    CHECK(fleet.getCount() == MODEMS);
+
+    // Every modem sends, reads its position and its status
+    for (uint8_t i = 0; i < MODEMS; i++)
+        CHECK(fleet.queueSMS(i, "+905551234567", "fleet alert"));
+    CHECK(fleet.requestGNSS());
+    CHECK(fleet.requestStatus());
+    CHECK(runFleet(fleet, time));
+
+    for (uint8_t i = 0; i < MODEMS; i++)
+    {
+        CHECK(finished[i][FLEET_SMS] == 1 && lastResult[i] == RESULT_OK);
+        CHECK(finished[i][FLEET_GNSS] == 1 && finished[i][FLEET_STATUS] == 1);
+        CHECK(sims[i]->getSentSMSCount() == 1);
+        CHECK(fleet.getSMSReference(i) >= 0);
+        CHECK(fleet.getFix(i).latitude == 481173000);
+        CHECK(fleet.getRegistration(i) == 1);
+        CHECK(fleet.getSignalQuality(i) == 20);
+    }
+
+    // A rejected submission is cancelled and reported, the next SMS still goes out
+    sims[1]->failNext("AT+CMGS", "+CMS ERROR: 500");
+    CHECK(fleet.queueSMS(1, "+905551234567", "rejected"));
+    CHECK(fleet.queueSMS(1, "+905551234567", "accepted"));
+    CHECK(fleet.requestStatus(1));
+    CHECK(runFleet(fleet, time));
+    CHECK(finished[1][FLEET_SMS] == 3);
+    CHECK(lastResult[1] == RESULT_OK);
+    CHECK(finished[1][FLEET_STATUS] == 2);
+    CHECK(sims[1]->getSentSMSCount() == 2);
+    CHECK(strcmp(sims[1]->getLastSMSText(), "accepted") == 0);
+
+    // A prompt that comes too late leaves the modem in text entry, ESC gets it out
+    sims[2]->setLatency(DEFAULT_TIMEOUT + 500);
+    CHECK(fleet.queueSMS(2, "+905551234567", "late"));
+    uint32_t commands = sims[2]->getCommandCount();
+    while (sims[2]->getCommandCount() == commands)
+    {
+        fleet.poll();
+        time.advance(1);
+    }
+    sims[2]->setLatency(20);
+    CHECK(fleet.requestStatus(2));
+    CHECK(runFleet(fleet, time));
+    CHECK(finished[2][FLEET_SMS] == 2);
+    CHECK(lastResult[2] == RESULT_TIMEOUT);
+    CHECK(finished[2][FLEET_STATUS] == 2);
+    CHECK(sims[2]->getSentSMSCount() == 1);
+    CHECK(fleet.queueSMS(2, "+905551234567", "after"));
+    CHECK(runFleet(fleet, time));
+    CHECK(lastResult[2] == RESULT_OK);
+    CHECK(strcmp(sims[2]->getLastSMSText(), "after") == 0);
+
+    for (uint8_t i = 0; i < MODEMS; i++)
+    {
+        delete modems[i];
+        delete sims[i];
+    }
+
+    CHECK_DONE();
+}
@@ -0,0 +1,50 @@
+#include "MC60.h"
+#include "MC60_Simulator.h"
+#include "check.h"
+
+int main()
+{
+    Virtual_Time_Source time;
+    MC60_Simulator sim(115200);
+    sim.setTimeSource(&time);
+    sim.setLatency(20);
+    MC60 mc60(&sim);
+    mc60.setTimeSource(&time);
+
+    // One GGA sentence with AT+QGNSSRD="NMEA/GGA"
+    CHECK(mc60.readGPS());
+    const gnss_fix &fix = mc60.getFix();
+    CHECK(fix.hour == 12 && fix.minute == 35 && fix.second == 19);
+    CHECK(fix.latitude == 481173000);  ///< 48 deg 07.0380 min
+    CHECK(fix.longitude == 115166666 || fix.longitude == 115166667);
+    CHECK(fix.altitude == 54540);
+    CHECK(fix.hdop == 90);
+    CHECK(fix.satellites == 8);
+    CHECK(mc60.gpsFix());
+
+    // A whole epoch with AT+QGNSSRD?
+    CHECK(mc60.readGNSS());
+    CHECK(mc60.getFix().speed == 13);
+    CHECK(mc60.getFix().course == 30962);
+    CHECK(mc60.getFix().fix_mode == 3);
+    CHECK(mc60.getSatellites().count == 8);
+    CHECK(mc60.getNMEAStatistics().checksum_errors == 0);
+
+    // At 2400 baud the epoch takes longer than DEFAULT_TIMEOUT to arrive
+    sim.setBaud(2400);
+    CHECK(mc60.readGNSS());
+    CHECK(mc60.getSatellites().count == 8);
+    sim.setBaud(115200);
+
+    // A corrupted sentence is rejected and the previous fix is kept
+    sim.setGGASentence("$GNGGA,123520.000,4807.0380,N,01131.0000,E,1,08,0.9,545.4,M,46.9,M,,*00");
+    CHECK(!mc60.readGPS());
+    CHECK(mc60.getFix().second == 19);
+
+    // No fix yet
+    sim.setGGASentence("$GNGGA,,,,,,0,00,,,M,,M,,*78");
+    (void)mc60.readGPS();
+    CHECK(!mc60.gpsFix());
+
+    CHECK_DONE();
+}
@@ -0,0 +1,101 @@
+#include "MC60_GNSS.h"
+#include "MC60_Simulator.h"
+#include "check.h"
+
+static uint8_t fixCount = 0;
+static uint8_t fixSecond = 0;
+
+static void onFix(const gnss_fix &fix, const gnss_satellites &satellites, void *context)
+{
+    (void)satellites;
+    (void)context;
+    fixCount++;
+    fixSecond = fix.second;
+}
+
+/// Append a sentence with its checksum and line ending to an epoch
+static void addSentence(char *epoch, const char *body, bool corrupt = false)
+{
+    uint8_t checksum = 0;
+    for (const char *p = body + 1; *p; p++)
+        checksum ^= *p;
+    if (corrupt)
+        checksum ^= 0xFF;
+
+    if (*epoch)
+        strcat(epoch, "\r\n");
+    sprintf(epoch + strlen(epoch), "%s*%02X", body, checksum);
+}
+
+/// Run update() for a while of simulated time, counting the calls that saw
+/// sentences of an epoch that was not published yet
+static uint16_t run(MC60_GNSS &gnss, Virtual_Time_Source &time, unsigned long ms, uint8_t second)
+{
+    uint16_t partial = 0;
+    unsigned long start = time.millis();
+    uint16_t epochs = gnss.getEpochCount();
+    uint16_t sentences = gnss.getStatistics().sentences;
+
+    while (time.millis() - start < ms)
+    {
+        gnss.update();
+        if (gnss.getEpochCount() == epochs && gnss.getStatistics().sentences != sentences)
+        {
+            partial++;
+            CHECK(gnss.getFix().second == second); ///< Still the last published epoch
+        }
+    }
+    return partial;
+}
+
+int main()
+{
+    Virtual_Time_Source time;
+    MC60_Simulator sim(4800); ///< Slow enough for update() to return in the middle of a burst
+    sim.setTimeSource(&time);
+    MC60_GNSS gnss(&sim);
+    gnss.setTimeSource(&time);
+    gnss.onFix(onFix);
+
+    // Nothing is published before a burst ends
+    CHECK(!gnss.update());
+    CHECK(gnss.getEpochCount() == 0);
+
+    // The default burst is published once, GNSS_EPOCH_GAP after its last byte
+    sim.streamNMEAEpoch();
+    CHECK(run(gnss, time, 3000, 0) > 0);
+    CHECK(fixCount == 1);
+    CHECK(gnss.getEpochCount() == 1);
+    CHECK(gnss.getFix().second == 19 && (gnss.getFix().flags & GNSS_HAS_ALTITUDE));
+    CHECK(gnss.getSatellites().count == 8);
+    CHECK(gnss.getStatistics().checksum_errors == 0);
+
+    // While the next epoch streams in, getFix() keeps the previous one
+    char epoch[400] = "";
+    addSentence(epoch, "$GNRMC,123520.000,A,4807.0380,N,01131.0000,E,0.13,309.62,130624,,,A");
+    addSentence(epoch, "$GNGGA,123520.000,4807.0380,N,01131.0000,E,1,08,0.9,545.4,M,46.9,M,,");
+    sim.setNMEAEpoch(epoch);
+    sim.streamNMEAEpoch();
+    CHECK(run(gnss, time, 3000, 19) > 0);
+    CHECK(fixCount == 2 && fixSecond == 20);
+    CHECK(gnss.getEpochCount() == 2);
+
+    // A sentence with a bad checksum never reaches the published fix
+    char bad[400] = "";
+    addSentence(bad, "$GNRMC,123521.000,A,4807.0380,N,01131.0000,E,0.13,309.62,130624,,,A");
+    addSentence(bad, "$GNGGA,123521.000,4807.0380,N,01131.0000,E,1,08,0.9,999.9,M,46.9,M,,", true);
+    sim.setNMEAEpoch(bad);
+    sim.streamNMEAEpoch();
+    run(gnss, time, 3000, 20);
+    CHECK(fixCount == 3 && fixSecond == 21);
+    CHECK(gnss.getEpochCount() == 3);
+    CHECK(!(gnss.getFix().flags & GNSS_HAS_ALTITUDE));
+    CHECK(gnss.getFix().altitude != 99990);
+    CHECK(gnss.getStatistics().checksum_errors == 1);
+
+    // Silence publishes nothing
+    run(gnss, time, 3000, 21);
+    CHECK(fixCount == 3);
+
+    CHECK_DONE();
+}
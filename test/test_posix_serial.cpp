@@ -0,0 +1,113 @@
+#include "MC60.h"
+#include "MC60_Simulator.h"
+#include "Posix_Serial.h"
+#include "check.h"
+
+#include <atomic>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <unistd.h>
+
+// A pty pair standing in for the modem's UART: the MC60 talks to the slave
+// side through Posix_Serial, a bridge thread carries the master side to and
+// from an MC60_Simulator.
+
+static int master = -1;
+static MC60_Simulator sim(115200);
+static std::atomic<bool> bridging(true);
+
+/// Move bytes between the pty master and the simulator until told to stop
+static void *bridge(void *arg)
+{
+    (void)arg;
+    uint8_t buffer[256];
+
+    while (bridging)
+    {
+        struct pollfd pfd = {master, POLLIN, 0};
+        if (poll(&pfd, 1, 1) > 0)
+        {
+            ssize_t count = read(master, buffer, sizeof(buffer));
+            for (ssize_t i = 0; i < count; i++)
+                sim.write(buffer[i]);
+        }
+
+        size_t length = 0;
+        while (length < sizeof(buffer) && sim.available())
+            buffer[length++] = sim.read();
+        if (length)
+            CHECK(write(master, buffer, length) == (ssize_t)length);
+    }
+    return NULL;
+}
+
+/// Wait up to a second for bytes on a descriptor
+static bool readable(int fd, int timeout = 1000)
+{
+    struct pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, timeout) > 0;
+}
+
+int main()
+{
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    CHECK(master >= 0);
+    CHECK(grantpt(master) == 0 && unlockpt(master) == 0);
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    CHECK(slave >= 0);
+
+    Posix_Serial port;
+    CHECK(port.attach(slave, 115200));
+    CHECK(port.isOpen() && port.getFD() == slave);
+    CHECK(port.getError() == 0);
+
+    // Raw mode: no line editing, echo or CR/LF translation in either direction
+    struct termios tio;
+    CHECK(tcgetattr(slave, &tio) == 0);
+    CHECK(!(tio.c_lflag & (ICANON | ECHO | ISIG)));
+    CHECK(!(tio.c_iflag & (ICRNL | INLCR | IGNCR | IXON)));
+    CHECK(!(tio.c_oflag & OPOST));
+    CHECK(cfgetospeed(&tio) == B115200);
+    CHECK(!port.begin(12345) && port.getError() == EINVAL);
+
+    // A command is held until flush() and then leaves in one write()
+    const char command[] = "AT+COPS?\r\n";
+    port.print(command);
+    CHECK(!readable(master, 50));
+    port.flush();
+    CHECK(readable(master));
+    char received[64];
+    ssize_t count = read(master, received, sizeof(received));
+    CHECK(count == (ssize_t)strlen(command) && memcmp(received, command, count) == 0);
+
+    const char answer[] = "\r\nOK\r\n\n";
+    CHECK(write(master, answer, strlen(answer)) == (ssize_t)strlen(answer));
+    CHECK(readable(slave));
+    size_t length = 0;
+    while (length < sizeof(received) && port.available())
+        received[length++] = port.read();
+    CHECK(length == strlen(answer) && memcmp(received, answer, length) == 0);
+    CHECK(port.read() == -1);
+
+    // The library runs through the pty as it would through a real modem
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, bridge, NULL) == 0);
+
+    MC60 mc60(&port);
+    CHECK(mc60.initialize(115200));
+    CHECK(mc60.getOperatorName() == "Simulated");
+    CHECK(mc60.sendSMS("+38640123456", "Sent over a pty"));
+
+    bridging = false;
+    pthread_join(thread, NULL);
+    CHECK(sim.getSentSMSCount() == 1);
+    CHECK(strcmp(sim.getLastSMSText(), "Sent over a pty") == 0);
+
+    port.close();
+    CHECK(!port.isOpen());
+    close(master);
+
+    CHECK_DONE();
+}
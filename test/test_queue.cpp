@@ -0,0 +1,125 @@
+#include "MC60.h"
+#include "MC60_Simulator.h"
+#include "check.h"
+
+/// Completion record of one queued command
+typedef struct
+{
+    int calls;
+    command_result result;
+} completion;
+
+static void onDone(command_result result, void *context)
+{
+    completion *done = (completion *)context;
+    done->calls++;
+    done->result = result;
+}
+
+/// Feed a string to a matcher, returning the offset just past the first match
+static int feedAll(Response_Matcher &matcher, const char *text, int8_t *match)
+{
+    for (int i = 0; text[i]; i++)
+        if ((*match = matcher.feed(text[i])) >= 0)
+            return i + 1;
+    return -1;
+}
+
+static const char flashPattern[] PROGMEM = "abab";
+
+int main()
+{
+    Virtual_Time_Source time;
+    MC60_Simulator sim(115200);
+    sim.setTimeSource(&time);
+    sim.setLatency(20);
+    MC60 mc60(&sim);
+    mc60.setTimeSource(&time);
+
+    // Commands run in order from poll(), each with its own completion
+    completion done[COMMAND_QUEUE_SIZE] = {};
+    char creg[16] = "";
+    char csq[16] = "";
+    command_handle at = mc60.queueCommand("AT\r", NULL, onDone, &done[0]);
+    command_handle registration = mc60.queueCommand("AT+CREG?\r", "+CREG: ", onDone, &done[1], DEFAULT_TIMEOUT, creg,
+                                                    sizeof(creg));
+    command_handle signal = mc60.queueCommand("AT+CSQ\r", "+CSQ: ", onDone, &done[2], DEFAULT_TIMEOUT, csq, sizeof(csq));
+    command_handle full = mc60.queueCommand("AT\r", NULL, onDone, &done[3]);
+    CHECK(at && registration && signal && full);
+    CHECK(mc60.queueCommand("AT\r") == 0); ///< Queue is full
+    CHECK(mc60.isPending(at));
+
+    while (mc60.isPending(full))
+        mc60.poll();
+
+    for (uint8_t i = 0; i < COMMAND_QUEUE_SIZE; i++)
+        CHECK(done[i].calls == 1 && done[i].result == RESULT_OK);
+    CHECK(mc60.getResult(signal) == RESULT_OK);
+    CHECK(strcmp(creg, "0,1") == 0);
+    CHECK(strcmp(csq, "20,0") == 0);
+
+    // Blocking calls share the queue with queued commands
+    completion late = {};
+    (void)mc60.queueCommand("AT\r", NULL, onDone, &late);
+    CHECK(mc60.sendCommand("AT+CSQ\r") == RESULT_OK);
+    CHECK(late.calls == 1 && late.result == RESULT_OK);
+
+    // Final results other than OK
+    sim.failNext("AT+CPIN?", "+CME ERROR: 10");
+    CHECK(mc60.sendCommand("AT+CPIN?\r", "+CPIN: ") == RESULT_CME_ERROR);
+    CHECK(mc60.getLastErrorCode() == 10);
+    CHECK(mc60.sendCommand("AT\r", "+NEVER: ") == RESULT_UNEXPECTED);
+    CHECK(mc60.sendCommand("AT+UNKNOWN\r") == RESULT_ERROR);
+
+    // A dropped command times out, the next one is not confused by it
+    sim.setDropRate(100);
+    completion lost = {};
+    command_handle dropped = mc60.queueCommand("AT\r", NULL, onDone, &lost, 300);
+    while (mc60.isPending(dropped))
+        mc60.poll();
+    CHECK(lost.calls == 1 && lost.result == RESULT_TIMEOUT);
+    sim.setDropRate(0);
+    CHECK(mc60.sendAT());
+
+    // A failed identity refresh leaves no field of the previous one behind
+    CHECK(mc60.refreshIdentity());
+    const mc60_identity &identity = mc60.getIdentity();
+    sim.failNext("ATI", "Other_Ltd\r\nOther_Module\r\n\r\nERROR");
+    CHECK(!mc60.refreshIdentity());
+    CHECK(!(identity.valid & IDENTITY_ATI) && identity.manufacturer_ID[0] == '\0' && identity.version[0] == '\0');
+    CHECK(identity.valid & IDENTITY_IMSI);
+    sim.failNext("AT+CIMI", "+CME ERROR: 10");
+    CHECK(!mc60.refreshIdentity());
+    CHECK(!(identity.valid & IDENTITY_IMSI) && identity.IMSI[0] == '\0');
+    CHECK(identity.valid & IDENTITY_ATI);
+    CHECK(mc60.refreshIdentity());
+    CHECK(strcmp(identity.IMSI, "286010000000001") == 0);
+
+    // The matcher falls back through overlapping prefixes without missing a
+    // match, for patterns in RAM and in flash and past AT_RESPONSE_LENGTH
+    Response_Matcher matcher;
+    int8_t match;
+    CHECK(matcher.add("aab"));
+    CHECK(matcher.add(flashPattern, true));
+    CHECK(feedAll(matcher, "aaab", &match) == 4 && match == 0);
+    CHECK(feedAll(matcher, "xababab", &match) == 5 && match == 1);
+    CHECK(feedAll(matcher, "ab", &match) == 2 && match == 1); ///< "abab" again from the overlap
+    CHECK(!matcher.add(""));
+
+    char longPattern[AT_RESPONSE_LENGTH + 8];
+    memset(longPattern, 'a', sizeof(longPattern) - 2);
+    longPattern[sizeof(longPattern) - 2] = 'b';
+    longPattern[sizeof(longPattern) - 1] = '\0';
+    char longText[sizeof(longPattern) + 4];
+    memset(longText, 'a', sizeof(longText) - 2);
+    longText[sizeof(longText) - 2] = 'b';
+    longText[sizeof(longText) - 1] = '\0';
+    matcher.begin(NULL, 0);
+    CHECK(matcher.add(longPattern));
+    CHECK(feedAll(matcher, longText, &match) == (int)strlen(longText) && match == 0);
+    for (uint8_t i = 1; i < MAX_RESPONSE_PATTERNS; i++)
+        CHECK(matcher.add("OK"));
+    CHECK(!matcher.add("OK")); ///< At most MAX_RESPONSE_PATTERNS
+
+    CHECK_DONE();
+}
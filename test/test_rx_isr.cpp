@@ -0,0 +1,41 @@
+#include "MC60_Simulator.h"
+#include "Serial_Command_Handler.h"
+#include "check.h"
+
+// Built with USE_RX_ISR: receive() stands in for the interrupt handler
+
+int main()
+{
+    MC60_Simulator sim(115200);
+    Serial_Command_Handler handler(&sim);
+
+    // service() leaves the transport to the interrupt
+    sim.injectUnsolicited("RING");
+    handler.service();
+    CHECK(handler.available() == 0);
+    CHECK(sim.available() > 0);
+
+    // Bytes from the interrupt come out in order across many index wraps
+    uint32_t mismatches = 0;
+    uint8_t expected = 0;
+    for (uint32_t i = 0; i < 100000; i++)
+    {
+        handler.receive((uint8_t)i);
+        if (i % 3 == 2)
+            while (handler.available())
+                mismatches += (uint8_t)handler.read() != expected++;
+    }
+    CHECK(mismatches == 0);
+    CHECK(handler.getRxHighWater() == 3);
+
+    // A full buffer drops bytes and counts them
+    handler.flush();
+    for (uint16_t i = 0; i < RX_BUFFER_SIZE + 5; i++)
+        handler.receive('x');
+    CHECK(handler.available() == RX_BUFFER_SIZE);
+    CHECK(handler.getRxOverflowBytes() == 5);
+    handler.flush();
+    CHECK(handler.available() == 0);
+
+    CHECK_DONE();
+}
@@ -0,0 +1,112 @@
+#include "MC60.h"
+#include "MC60_Simulator.h"
+#include "check.h"
+
+static int listed = 0;
+
+static void onSMS(const sms_received &sms, void *context)
+{
+    (void)context;
+    if (sms.length > 0 && !sms.truncated)
+        listed++;
+}
+
+int main()
+{
+    Virtual_Time_Source time;
+    MC60_Simulator sim(115200);
+    sim.setTimeSource(&time);
+    sim.setLatency(20);
+    MC60 mc60(&sim);
+    mc60.setTimeSource(&time);
+
+    // Text mode
+    CHECK(mc60.sendSMS("+905551234567", "Hello from the host"));
+    CHECK(sim.getSentSMSCount() == 1);
+    CHECK(strcmp(sim.getLastSMSText(), "Hello from the host") == 0);
+
+    // Characters outside ASCII go through PDU mode
+    CHECK(mc60.sendSMS("+905551234567", "Gr\xc3\xbc\xc3\x9f" "e"));
+    CHECK(sim.getSentSMSCount() == 2);
+
+    // A batch keeps the link open and reports every reference
+    sms_message batch[3] = {{"+905550000001", "one", -1, RESULT_PENDING},
+                             {"+905550000002", "two", -1, RESULT_PENDING},
+                             {"+905550000003", "three", -1, RESULT_PENDING}};
+    CHECK(mc60.sendSMSBatch(batch, 3) == 3);
+    for (uint8_t i = 0; i < 3; i++)
+        CHECK(batch[i].result == RESULT_OK && batch[i].reference >= 0);
+    CHECK(batch[0].reference != batch[1].reference);
+
+    // A rejected submission is reported with its error code
+    sim.failNext("AT+CMGS", "+CMS ERROR: 500");
+    CHECK(!mc60.sendSMS("+905551234567", "rejected"));
+    CHECK(mc60.getLastResult() == RESULT_CMS_ERROR);
+    CHECK(mc60.getLastErrorCode() == 500);
+
+    // The network accepts the message only after the +CMGS wait timed out
+    sim.setSMSLinkSetup(SMS_SEND_TIMEOUT + 500);
+    CHECK(mc60.sendSMS("+905551234567", "slow network"));
+    CHECK(sim.getSentSMSCount() == 6);
+    sim.setSMSLinkSetup(0);
+    CHECK(mc60.sendAT());
+
+    // The prompt comes too late, ESC takes the modem out of text entry
+    sim.setLatency(500);
+    CHECK(!mc60.sendSMS("+905551234567", "too late"));
+    CHECK(mc60.getLastResult() == RESULT_TIMEOUT);
+    sim.setLatency(20);
+    CHECK(mc60.sendAT());
+    CHECK(mc60.sendSMS("+905551234567", "in time"));
+    CHECK(strcmp(sim.getLastSMSText(), "in time") == 0);
+    CHECK(sim.getSentSMSCount() == 7);
+
+    // A batch sends what text mode can not carry in PDU mode: a text longer
+    // than one SMS, characters outside GSM, and Ctrl-Z or ESC that would end
+    // text entry early
+    char longText[171];
+    memset(longText, 'x', sizeof(longText) - 1);
+    longText[sizeof(longText) - 1] = '\0';
+    sms_message mixed[5] = {{"+905550000001", "before", -1, RESULT_PENDING},
+                            {"+905550000002", longText, -1, RESULT_PENDING},
+                            {"+905550000003", "Gr\xc3\xbc\xc3\x9f" "e", -1, RESULT_PENDING},
+                            {"+905550000004", "ctrl-z \x1A here", -1, RESULT_PENDING},
+                            {"+905550000005", "esc \x1B here", -1, RESULT_PENDING}};
+    CHECK(mc60.sendSMSBatch(mixed, 5) == 5);
+    for (uint8_t i = 0; i < 5; i++)
+        CHECK(mixed[i].result == RESULT_OK && mixed[i].reference >= 0);
+    CHECK(sim.getSentSMSCount() == 13); ///< The long text in two parts
+    CHECK(mc60.sendSMS("+905550000006", "after"));
+    CHECK(strcmp(sim.getLastSMSText(), "after") == 0); ///< Back in text mode
+
+    // Incoming messages are announced by +CMTI, read, listed and deleted
+    CHECK(sim.receiveSMS("+905559999999", "first"));
+    CHECK(sim.receiveSMS("+905559999998", "second"));
+    time.delay(50);
+    mc60.poll();
+    CHECK(mc60.newSMSAvailable() == 2);
+
+    char text[40];
+    sms_received sms;
+    sms.text = text;
+    sms.size = sizeof(text);
+    int16_t index = mc60.getNewSMSIndex();
+    CHECK(index == 1);
+    CHECK(mc60.readSMS(index, sms));
+    CHECK(strcmp(sms.number, "+905559999999") == 0);
+    CHECK(strcmp(sms.text, "first") == 0);
+    CHECK(sms.status == SMS_REC_UNREAD);
+
+    CHECK(mc60.listSMS(sms, onSMS) == 2);
+    CHECK(listed == 2);
+    CHECK(mc60.newSMSAvailable() == 0);
+
+    CHECK(mc60.deleteSMS(1));
+    CHECK(sim.getStoredSMSCount() == 1);
+    CHECK(mc60.deleteSMS(0, SMS_DELETE_ALL));
+    CHECK(sim.getStoredSMSCount() == 0);
+    CHECK(mc60.listSMS(sms, onSMS) == 0);
+    CHECK(mc60.getLastResult() == RESULT_OK);
+
+    CHECK_DONE();
+}
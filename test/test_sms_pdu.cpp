@@ -0,0 +1,45 @@
+#include "SMS_PDU.h"
+#include "check.h"
+
+/// A string of count copies of c
+static const char *repeat(char *buffer, char c, uint16_t count)
+{
+    memset(buffer, c, count);
+    buffer[count] = '\0';
+    return buffer;
+}
+
+int main()
+{
+    char text[400];
+
+    // Text mode takes ASCII the GSM 7-bit default alphabet has
+    CHECK(!SMS_PDU_Encoder::needsPDU("Hello, world! @$_ 100%\r\n"));
+    CHECK(!SMS_PDU_Encoder::needsPDU(""));
+
+    // ASCII characters missing from it, and anything beyond ASCII, need PDU mode
+    CHECK(SMS_PDU_Encoder::needsPDU("`quoted`"));
+    CHECK(SMS_PDU_Encoder::needsPDU("tab\there"));
+    CHECK(SMS_PDU_Encoder::needsPDU("Gr\xc3\xbc\xc3\x9f" "e"));
+
+    // 160 septets fit one SMS
+    CHECK(!SMS_PDU_Encoder::needsPDU(repeat(text, 'a', SMS_GSM7_SINGLE)));
+    CHECK(SMS_PDU_Encoder::needsPDU(repeat(text, 'a', SMS_GSM7_SINGLE + 1)));
+
+    // Extension table characters take two septets each
+    CHECK(!SMS_PDU_Encoder::needsPDU(repeat(text, '{', SMS_GSM7_SINGLE / 2)));
+    CHECK(SMS_PDU_Encoder::needsPDU(repeat(text, '[', SMS_GSM7_SINGLE / 2 + 1)));
+    repeat(text, 'a', SMS_GSM7_SINGLE); ///< 161 septets with the '~'
+    text[0] = '~';
+    CHECK(SMS_PDU_Encoder::needsPDU(text));
+    text[SMS_GSM7_SINGLE - 1] = '\0'; ///< 160 septets
+    CHECK(!SMS_PDU_Encoder::needsPDU(text));
+
+    // PDU mode still encodes what text mode can not send
+    SMS_PDU_Encoder pdu;
+    CHECK(pdu.begin("+905551234567", "`quoted`", 1));
+    CHECK(pdu.nextSegment());
+    CHECK(pdu.getLength() > 0);
+
+    CHECK_DONE();
+}
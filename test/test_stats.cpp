@@ -0,0 +1,113 @@
+#include "MC60.h"
+#include "MC60_Simulator.h"
+#include "check.h"
+
+static const command_stats *findStats(MC60 &mc60, const char *name)
+{
+    for (uint8_t i = 0; i < mc60.getCommandStatsCount(); i++)
+    {
+        const command_stats *stats = mc60.getCommandStats(i);
+        if (strcmp(stats->name, name) == 0)
+            return stats;
+    }
+    return NULL;
+}
+
+int main()
+{
+    Virtual_Time_Source time;
+    MC60_Simulator sim(115200);
+    sim.setTimeSource(&time);
+    MC60 mc60(&sim);
+    mc60.setTimeSource(&time);
+
+    // Bytes arriving between commands belong to no class
+    CHECK(mc60.sendCommand("AT+CSQ\r", "OK") == RESULT_OK);
+    const command_stats *csq = findStats(mc60, "+CSQ");
+    CHECK(csq != NULL);
+    uint32_t bytesRx = csq ? csq->bytesRx : 0;
+    sim.injectUnsolicited("RING");
+    time.delay(10);
+    mc60.poll();
+    CHECK(csq && csq->count == 1);
+    CHECK(csq && csq->bytesRx == bytesRx);
+
+    // More classes than slots, the real ones keep their names and the rest
+    // is counted in the last slot
+    mc60.resetCommandStats();
+    char cmd[16];
+    for (uint8_t i = 0; i < COMMAND_STATS_CLASSES; i++)
+    {
+        sprintf(cmd, "AT+X%u\r", i);
+        mc60.sendCommand(cmd, "OK");
+    }
+    CHECK(mc60.getCommandStatsCount() == COMMAND_STATS_CLASSES);
+    for (uint8_t i = 0; i < COMMAND_STATS_CLASSES - 1; i++)
+    {
+        const command_stats *stats = mc60.getCommandStats(i);
+        sprintf(cmd, "+X%u", i);
+        CHECK(strcmp(stats->name, cmd) == 0);
+        CHECK(stats->count == 1);
+    }
+    const command_stats *other = mc60.getCommandStats(COMMAND_STATS_CLASSES - 1);
+    CHECK(strcmp(other->name, "*") == 0);
+    CHECK(other->count == 1);
+    mc60.sendCommand("AT+X0\r", "OK");
+    CHECK(mc60.getCommandStats(0)->count == 2);
+    CHECK(other->count == 1);
+
+    // A response read by the caller counts against its command until the
+    // final result, bytes and latency included, with no "WAIT" class
+    mc60.resetCommandStats();
+    sim.setLatency(100);
+    sim.setBaud(1200);
+    unsigned long start = time.millis();
+    CHECK(mc60.sendCommand("AT+CSQ\r", "+CSQ: ") == RESULT_OK);
+    unsigned long response = time.millis();
+    char line[16];
+    CHECK(mc60.readline(line, sizeof(line), 500) > 0 && strcmp(line, "20,0") == 0);
+    CHECK(mc60.waitForOK());
+    unsigned long end = time.millis();
+    csq = findStats(mc60, "+CSQ");
+    CHECK(csq && csq->count == 1);
+    CHECK(findStats(mc60, "WAIT") == NULL);
+    CHECK(csq && csq->bytesTx == strlen("AT+CSQ\r"));
+    CHECK(csq && csq->bytesRx == strlen("AT+CSQ\r\r\n+CSQ: 20,0\r\n\r\nOK\r")); ///< The last '\n' starts the next read
+    CHECK(csq && csq->totalLatency > response - start && csq->totalLatency <= end - start);
+    CHECK(csq && csq->maxLatency == csq->totalLatency);
+    CHECK(csq && csq->histogram[5] == 1); ///< 256 to 511 ms, the response alone came within 256 ms
+
+    // A dropped command is a timeout, in the bucket of its timeout
+    sim.setLatency(0);
+    sim.setBaud(0);
+    sim.setDropRate(100);
+    CHECK(mc60.sendCommand("AT+CSQ\r", NULL, 200) == RESULT_TIMEOUT);
+    sim.setDropRate(0);
+    CHECK(csq && csq->count == 2 && csq->timeouts == 1 && csq->errors == 0);
+    CHECK(csq && csq->histogram[4] == 1); ///< 128 to 255 ms
+    CHECK(csq && csq->maxLatency >= 200);
+
+    // Sending it again right after the failure is a retry
+    CHECK(mc60.sendCommand("AT+CSQ\r") == RESULT_OK);
+    CHECK(csq && csq->count == 3 && csq->retries == 1);
+
+    // Error results are counted, a +CME ERROR the same as ERROR
+    sim.failNext("AT+CSQ", "+CME ERROR: 30");
+    CHECK(mc60.sendCommand("AT+CSQ\r") == RESULT_CME_ERROR);
+    sim.failNext("AT+CSQ", "ERROR");
+    CHECK(mc60.sendCommand("AT+CSQ\r") == RESULT_ERROR);
+    CHECK(csq && csq->count == 5 && csq->errors == 2 && csq->timeouts == 1 && csq->retries == 2);
+
+    // A different command after a failure is not a retry
+    CHECK(mc60.sendCommand("AT\r") == RESULT_OK);
+    CHECK(mc60.sendCommand("AT+CSQ\r") == RESULT_OK);
+    CHECK(csq && csq->count == 6 && csq->retries == 2);
+    uint16_t histogram = 0;
+    for (uint8_t i = 0; csq && i < COMMAND_STATS_BUCKETS; i++)
+        histogram += csq->histogram[i];
+    CHECK(histogram == 6);
+    const command_stats *at = findStats(mc60, "AT");
+    CHECK(at && at->count == 1 && at->retries == 0);
+
+    CHECK_DONE();
+}
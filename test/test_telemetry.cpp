@@ -0,0 +1,80 @@
+#include "Telemetry.h"
+#include "check.h"
+#include "track.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACK_POINTS 600
+
+/// Base64 characters only, all in the GSM 7-bit default alphabet
+static bool isBase64(const char *text)
+{
+    for (; *text; text++)
+        if (!strchr("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/", *text))
+            return false;
+    return true;
+}
+
+/// A decoded point matches the original at the resolution that is sent
+static bool matches(const telemetry_point &sent, const telemetry_point &got)
+{
+    return got.time == sent.time && labs(got.latitude - sent.latitude) <= 50 &&
+           labs(got.longitude - sent.longitude) <= 50 && labs(got.altitude - sent.altitude) <= 5 &&
+           abs(got.hdop - sent.hdop) <= 5 && got.satellites == sent.satellites && got.fix_type == sent.fix_type;
+}
+
+int main()
+{
+    static telemetry_point track[TRACK_POINTS];
+    makeTrack(track, TRACK_POINTS, 10);
+
+    // Encode the track into as many messages as it takes, decode each one
+    Telemetry_Encoder encoder;
+    Telemetry_Decoder decoder;
+    char text[TELEMETRY_TEXT_SIZE];
+    uint16_t sent = 0, decoded = 0, messages = 0, mismatches = 0;
+
+    while (sent < TRACK_POINTS)
+    {
+        encoder.clear();
+        uint16_t first = sent;
+        while (sent < TRACK_POINTS && encoder.add(track[sent]))
+            sent++;
+        CHECK(sent > first);
+
+        CHECK(encoder.getText(text, sizeof(text)) > 0);
+        CHECK(strlen(text) <= 160);
+        CHECK(isBase64(text));
+        messages++;
+
+        telemetry_point point;
+        CHECK(decoder.begin(text));
+        for (uint16_t i = first; decoder.next(point); i++)
+        {
+            mismatches += i >= sent || !matches(track[i], point);
+            decoded++;
+        }
+        CHECK(!decoder.hasError());
+    }
+
+    CHECK(decoded == TRACK_POINTS);
+    CHECK(mismatches == 0);
+    CHECK(messages < TRACK_POINTS / 10); ///< Better than ten points per SMS
+
+    // Damaged messages are reported, not decoded into garbage
+    encoder.clear();
+    for (uint8_t i = 0; i < 5; i++)
+        (void)encoder.add(track[i]);
+    (void)encoder.getText(text, sizeof(text));
+    text[3] = '!';
+    telemetry_point point;
+    CHECK(decoder.begin(text));
+    while (decoder.next(point))
+        ;
+    CHECK(decoder.hasError());
+
+    CHECK(!decoder.begin("AAAA")); ///< Unknown version
+
+    CHECK_DONE();
+}
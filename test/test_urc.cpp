@@ -0,0 +1,124 @@
+#include "MC60.h"
+#include "MC60_Simulator.h"
+#include "check.h"
+
+static int ringCount = 0;
+static char listed[2][40];
+static uint8_t listedCount = 0;
+
+static void onRing(const char *line, void *context)
+{
+    (void)context;
+    if (strcmp(line, "RING") == 0)
+        ringCount++;
+}
+
+static void onSMS(const sms_received &sms, void *context)
+{
+    (void)context;
+    if (listedCount < 2)
+        strcpy(listed[listedCount], sms.text);
+    listedCount++;
+}
+
+int main()
+{
+    Virtual_Time_Source time;
+    MC60_Simulator sim(115200);
+    sim.setTimeSource(&time);
+    MC60 mc60(&sim);
+    mc60.setTimeSource(&time);
+
+    CHECK(mc60.onUnsolicited("RING", onRing));
+
+    // Lines arriving while idle are dispatched or queued by poll()
+    sim.injectUnsolicited("RING");
+    sim.injectUnsolicited("+QGNSS: 1");
+    time.delay(10);
+    mc60.poll();
+    CHECK(ringCount == 1);
+    CHECK(mc60.unsolicitedAvailable() == 1);
+
+    char line[URC_LINE_LENGTH];
+    CHECK(mc60.readUnsolicited(line, sizeof(line)));
+    CHECK(strcmp(line, "+QGNSS: 1") == 0);
+    CHECK(!mc60.readUnsolicited(line, sizeof(line)));
+
+    // A URC in the middle of a command is picked up, the command still succeeds
+    sim.injectUnsolicited("RING");
+    CHECK(mc60.getOperatorName() == "Simulated");
+    CHECK(ringCount == 2);
+
+    // +CREG URCs reach the MC60's own handler and drop the cached operator
+    sim.setOperatorName("Other");
+    CHECK(mc60.getOperatorName() == "Simulated"); ///< Cached
+    sim.injectUnsolicited("+CREG: 5");
+    time.delay(10);
+    mc60.poll();
+    CHECK(mc60.getOperatorName() == "Other");
+
+    // initialize() turns on the +CREG URC, a registration change reported by
+    // the modem itself drops the cached operator
+    CHECK(mc60.initialize(115200));
+    CHECK(mc60.getNetworkRegistration() == 1);
+    CHECK(mc60.getOperatorName() == "Other");
+    sim.setOperatorName("Roaming");
+    CHECK(mc60.getOperatorName() == "Other"); ///< Cached
+    sim.setRegistration(5);
+    time.delay(10);
+    mc60.poll();
+    CHECK(mc60.getOperatorName() == "Roaming");
+
+    // Unhandled lines beyond URC_QUEUE_SIZE are counted, not kept
+    for (uint8_t i = 0; i < URC_QUEUE_SIZE + 2; i++)
+        sim.injectUnsolicited("+QGNSS: 1");
+    time.delay(10);
+    mc60.poll();
+    CHECK(mc60.unsolicitedAvailable() == URC_QUEUE_SIZE);
+    CHECK(mc60.getUnsolicitedOverflows() == 2);
+    while (mc60.readUnsolicited(line, sizeof(line)))
+        ;
+
+    // URCs in the middle of a response the MC60 reads by hand reach their
+    // handler, and stay out of what it parses
+    int rings = ringCount;
+    sim.setBaud(2400); ///< Slow enough for the epoch to fit the RX buffer on the virtual clock
+    sim.interleaveUnsolicited("AT+QGNSSRD?", "RING");
+    CHECK(mc60.readGNSS());
+    CHECK(ringCount == rings + 1);
+    CHECK(mc60.getFix().second == 19 && mc60.getSatellites().count == 8);
+
+    sim.interleaveUnsolicited("AT+QGNSSRD?", "+CMTI: \"SM\",7");
+    CHECK(mc60.readGNSS());
+    CHECK(mc60.newSMSAvailable() == 1);
+    CHECK(mc60.getNewSMSIndex() == 7);
+    CHECK(mc60.unsolicitedAvailable() == 0);
+    CHECK(mc60.getRxOverflowBytes() == 0);
+    sim.setBaud(115200);
+
+    CHECK(sim.receiveSMS("+905559999999", "first"));
+    CHECK(sim.receiveSMS("+905559999998", "second"));
+    time.delay(10);
+    mc60.poll();
+    CHECK(mc60.newSMSAvailable() == 2);
+
+    char text[40];
+    sms_received sms;
+    sms.text = text;
+    sms.size = sizeof(text);
+    sim.interleaveUnsolicited("AT+CMGL", "RING");
+    CHECK(mc60.listSMS(sms, onSMS) == 2);
+    CHECK(ringCount == rings + 2);
+    CHECK(listedCount == 2 && strcmp(listed[0], "first") == 0 && strcmp(listed[1], "second") == 0);
+
+    // A URC long enough to be taken for message text is taken back out
+    listedCount = 0;
+    sim.interleaveUnsolicited("AT+CMGL", "+CMTI: \"SM\",3");
+    CHECK(mc60.listSMS(sms, onSMS, NULL, SMS_REC_READ) == 2);
+    CHECK(listedCount == 2 && strcmp(listed[0], "first") == 0 && strcmp(listed[1], "second") == 0);
+    CHECK(mc60.newSMSAvailable() == 1);
+    CHECK(mc60.getNewSMSIndex() == 3);
+    CHECK(mc60.getLastResult() == RESULT_OK);
+
+    CHECK_DONE();
+}
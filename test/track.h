@@ -0,0 +1,63 @@
+#ifndef __TRACK_H__
+#define __TRACK_H__
+
+#include "Telemetry.h"
+
+/**************************************************************************/
+/*!
+    @brief  Synthetic vehicle track for the telemetry tests and benchmarks: a
+   drive through town with stops, turns, speed changes, GPS noise, a missed
+   fix and a parked stretch, one point every interval seconds
+    @param points Filled with the track
+    @param count Number of points
+    @param interval Seconds between points
+*/
+/**************************************************************************/
+static void makeTrack(telemetry_point *points, uint16_t count, uint16_t interval)
+{
+    uint32_t seed = 12345;
+    uint32_t time = 845208000UL; ///< 2026-10-13 10:40:00 UTC
+    int32_t latitude = 410082000;  ///< 1e-7 degrees
+    int32_t longitude = 289784000;
+    int32_t altitude = 4200; ///< centimeters
+    int32_t north = 0, east = 0; ///< 1e-7 degrees per second
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        uint16_t phase = i % 120;
+        if (phase < 10 || i >= count - count / 8) ///< Standing at a light, or parked at the end
+            north = east = 0;
+        else if (phase % 30 == 10) ///< Pull away or turn, about 30-50 km/h
+        {
+            seed = seed * 1103515245UL + 12345UL;
+            north = (int32_t)((seed >> 16) % 2000) - 1000;
+            east = (int32_t)((seed >> 8) % 2000) - 1000;
+        }
+        else if (phase % 7 == 0) ///< Speed up or slow down a little
+        {
+            north += north / 8;
+            east -= east / 8;
+        }
+
+        time += interval;
+        if (i % 97 == 96) ///< A fix was missed
+            time += interval;
+
+        latitude += north * interval;
+        longitude += east * interval;
+        altitude += (north + east) / 200;
+
+        seed = seed * 1103515245UL + 12345UL;
+        int32_t noise = (int32_t)((seed >> 16) % 41) - 20; ///< About +-2 m
+
+        points[i].time = time;
+        points[i].latitude = latitude + noise * 10;
+        points[i].longitude = longitude - noise * 10;
+        points[i].altitude = altitude + noise * 5;
+        points[i].hdop = 90 + (uint16_t)((seed >> 8) % 3) * 10;
+        points[i].satellites = 7 + (uint8_t)((seed >> 4) % 3);
+        points[i].fix_type = 1;
+    }
+}
+
+#endif